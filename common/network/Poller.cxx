@@ -0,0 +1,189 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include <network/Poller.h>
+#include <network/Socket.h>
+
+using namespace network;
+
+// How many events we fetch from the kernel at a time
+static const int maxEvents = 64;
+
+Poller::Poller()
+{
+#ifdef __linux__
+  epollFd = epoll_create(maxEvents);
+  if (epollFd < 0)
+    throw SocketException("epoll_create", errno);
+  fcntl(epollFd, F_SETFD, FD_CLOEXEC);
+#endif
+}
+
+Poller::~Poller()
+{
+#ifdef __linux__
+  close(epollFd);
+#endif
+}
+
+void Poller::setFd(int fd, bool read, bool write)
+{
+  std::map<int, int>::iterator iter;
+  int events;
+
+  events = 0;
+  if (read)
+    events |= EventRead;
+  if (write)
+    events |= EventWrite;
+
+  iter = fds.find(fd);
+  if ((iter != fds.end()) && (iter->second == events))
+    return;
+
+#ifdef __linux__
+  struct epoll_event ev;
+
+  ev.events = 0;
+  if (read)
+    ev.events |= EPOLLIN;
+  if (write)
+    ev.events |= EPOLLOUT;
+  ev.data.u64 = 0;
+  ev.data.fd = fd;
+
+  if (epoll_ctl(epollFd, iter == fds.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+                fd, &ev) < 0)
+    throw SocketException("epoll_ctl", errno);
+#endif
+
+  fds[fd] = events;
+}
+
+void Poller::removeFd(int fd)
+{
+  if (fds.erase(fd) == 0)
+    return;
+
+#ifdef __linux__
+  // Older kernels insist on an event even though it is ignored
+  struct epoll_event ev;
+
+  if (epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &ev) < 0)
+    throw SocketException("epoll_ctl", errno);
+#endif
+}
+
+int Poller::wait(int timeoutms)
+{
+  int n;
+
+  ready.clear();
+
+#ifdef __linux__
+  struct epoll_event events[maxEvents];
+
+  n = epoll_wait(epollFd, events, maxEvents, timeoutms);
+  if (n < 0) {
+    if (errno == EINTR)
+      return 0;
+    throw SocketException("epoll_wait", errno);
+  }
+
+  for (int i = 0; i < n; i++) {
+    Event event;
+
+    event.fd = events[i].data.fd;
+    event.events = 0;
+    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+      event.events |= EventRead;
+    if (events[i].events & EPOLLOUT)
+      event.events |= EventWrite;
+
+    ready.push_back(event);
+  }
+#else
+  std::vector<struct pollfd> pollfds;
+  std::map<int, int>::const_iterator iter;
+
+  pollfds.reserve(fds.size());
+  for (iter = fds.begin(); iter != fds.end(); ++iter) {
+    struct pollfd pfd;
+
+    pfd.fd = iter->first;
+    pfd.events = 0;
+    if (iter->second & EventRead)
+      pfd.events |= POLLIN;
+    if (iter->second & EventWrite)
+      pfd.events |= POLLOUT;
+    pfd.revents = 0;
+
+    pollfds.push_back(pfd);
+  }
+
+  n = poll(pollfds.empty() ? NULL : &pollfds[0], pollfds.size(), timeoutms);
+  if (n < 0) {
+    if (errno == EINTR)
+      return 0;
+    throw SocketException("poll", errno);
+  }
+
+  for (size_t i = 0; i < pollfds.size(); i++) {
+    Event event;
+
+    if (pollfds[i].revents == 0)
+      continue;
+
+    event.fd = pollfds[i].fd;
+    event.events = 0;
+    if (pollfds[i].revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL))
+      event.events |= EventRead;
+    if (pollfds[i].revents & POLLOUT)
+      event.events |= EventWrite;
+
+    ready.push_back(event);
+  }
+#endif
+
+  return ready.size();
+}
+
+void Poller::getEvent(int index, int* fd, bool* read, bool* write) const
+{
+  assert(index >= 0);
+  assert((size_t)index < ready.size());
+
+  *fd = ready[index].fd;
+  *read = ready[index].events & EventRead;
+  *write = ready[index].events & EventWrite;
+}
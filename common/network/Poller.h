@@ -0,0 +1,74 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+// -=- Poller.h - waits for events on a set of file descriptors
+//
+// File descriptors are registered once rather than being passed in on
+// every wait, which with epoll means that the cost of waiting only
+// depends on how many of them are ready. Other systems use poll(), so
+// there is no limit on the file descriptor numbers either way.
+
+#ifndef __NETWORK_POLLER_H__
+#define __NETWORK_POLLER_H__
+
+#include <map>
+#include <vector>
+
+namespace network {
+
+  class Poller {
+  public:
+    Poller();
+    ~Poller();
+
+    // setFd() starts monitoring the file descriptor, or changes which
+    // events it is monitored for. Calling it again with the same
+    // arguments is cheap. removeFd() stops monitoring it, and must be
+    // called before the file descriptor is closed.
+    void setFd(int fd, bool read, bool write);
+    void removeFd(int fd);
+
+    // wait() waits for at most timeoutms milliseconds, or forever if
+    // it is -1, for any of the file descriptors to become ready. It
+    // returns the number of events, or 0 if interrupted by a signal.
+    // Errors and hang ups are reported as the descriptor being
+    // readable, as reading is how they are noticed.
+    int wait(int timeoutms);
+
+    // getEvent() fetches the result of the last wait()
+    void getEvent(int index, int* fd, bool* read, bool* write) const;
+
+  private:
+    enum { EventRead = 1, EventWrite = 2 };
+
+    struct Event {
+      int fd;
+      int events;
+    };
+
+    std::map<int, int> fds;
+    std::vector<Event> ready;
+
+#ifdef __linux__
+    int epollFd;
+#endif
+  };
+
+}
+
+#endif // __NETWORK_POLLER_H__
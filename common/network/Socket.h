@@ -48,6 +48,10 @@ namespace network {
 
     virtual bool cork(bool enable) = 0;
 
+    // canPassFds() tells if file descriptors can be sent along with
+    // the data, using FdOutStream::sendFd()
+    virtual bool canPassFds() { return false; }
+
     // information about the remote end of the socket
     virtual char* getPeerAddress() = 0; // a string e.g. "192.168.0.1"
     virtual char* getPeerEndpoint() = 0; // <address>::<port>
@@ -114,6 +114,11 @@ bool UnixSocket::cork(bool enable)
   return true;
 }
 
+bool UnixSocket::canPassFds()
+{
+  return true;
+}
+
 UnixListener::UnixListener(const char *path, int mode)
 {
   struct sockaddr_un addr;
@@ -42,6 +42,7 @@ namespace network {
     virtual char* getPeerEndpoint();
 
     virtual bool cork(bool enable);
+    virtual bool canPassFds();
   };
 
   class UnixListener : public SocketListener {
@@ -33,6 +33,9 @@
 #else
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
@@ -43,11 +46,6 @@
 #define vncmax(a,b)            (((a) > (b)) ? (a) : (b))
 #endif
 
-/* Old systems have select() in sys/time.h */
-#ifdef HAVE_SYS_SELECT_H
-#include <sys/select.h>
-#endif
-
 #include <rdr/FdInStream.h>
 #include <rdr/Exception.h>
 
@@ -56,12 +54,16 @@ using namespace rdr;
 enum { DEFAULT_BUF_SIZE = 8192,
        MIN_BULK_SIZE = 1024 };
 
+// How many file descriptors we can pick up with a single read
+enum { MAX_RECEIVED_FDS = 4 };
+
 FdInStream::FdInStream(int fd_, int timeoutms_, size_t bufSize_,
                        bool closeWhenDone_)
   : fd(fd_), closeWhenDone(closeWhenDone_),
     timeoutms(timeoutms_), blockCallback(0),
     timing(false), timeWaitedIn100us(5), timedKbits(0),
-    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0)
+    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0),
+    receiveFds(false)
 {
   ptr = end = start = new U8[bufSize];
 }
@@ -70,7 +72,8 @@ FdInStream::FdInStream(int fd_, FdInStreamBlockCallback* blockCallback_,
                        size_t bufSize_)
   : fd(fd_), timeoutms(0), blockCallback(blockCallback_),
     timing(false), timeWaitedIn100us(5), timedKbits(0),
-    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0)
+    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0),
+    receiveFds(false)
 {
   ptr = end = start = new U8[bufSize];
 }
@@ -79,6 +82,10 @@ FdInStream::~FdInStream()
 {
   delete [] start;
   if (closeWhenDone) close(fd);
+  while (!receivedFds.empty()) {
+    close(receivedFds.front());
+    receivedFds.pop_front();
+  }
 }
 
 
@@ -97,6 +104,24 @@ size_t FdInStream::pos()
   return offset + ptr - start;
 }
 
+void FdInStream::setReceiveFds(bool enable)
+{
+  receiveFds = enable;
+}
+
+int FdInStream::receiveFd()
+{
+  int received;
+
+  if (receivedFds.empty())
+    return -1;
+
+  received = receivedFds.front();
+  receivedFds.pop_front();
+
+  return received;
+}
+
 void FdInStream::readBytes(void* data, size_t length)
 {
   if (length < MIN_BULK_SIZE) {
@@ -160,6 +185,44 @@ size_t FdInStream::overrun(size_t itemSize, size_t nItems, bool wait)
   return nItems;
 }
 
+//
+// waitForRead() waits for at most timeoutms milliseconds, or forever if it
+// is -1, for the file descriptor to become readable. It returns a positive
+// value if it did, zero if it timed out and a negative value on errors.
+//
+
+static int waitForRead(int fd, int timeoutms)
+{
+  int n;
+
+  do {
+#ifdef _WIN32
+    fd_set fds;
+    struct timeval tv;
+    struct timeval* tvp = &tv;
+
+    if (timeoutms != -1) {
+      tv.tv_sec = timeoutms / 1000;
+      tv.tv_usec = (timeoutms % 1000) * 1000;
+    } else {
+      tvp = 0;
+    }
+
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    n = select(fd+1, &fds, 0, 0, tvp);
+#else
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    n = poll(&pfd, 1, timeoutms);
+#endif
+  } while (n < 0 && errno == EINTR);
+
+  return n;
+}
+
 //
 // readWithTimeoutOrCallback() reads up to the given length in bytes from the
 // file descriptor into a buffer.  If the wait argument is false, then zero is
@@ -167,10 +230,11 @@ size_t FdInStream::overrun(size_t itemSize, size_t nItems, bool wait)
 // blockCallback is set, it will be called (repeatedly) instead of blocking.
 // If alternatively there is a timeout set and that timeout expires, it throws
 // a TimedOut exception.  Otherwise it returns the number of bytes read.  It
-// never attempts to recv() unless select() indicates that the fd is readable -
-// this means it can be used on an fd which has been set non-blocking.  It also
-// has to cope with the annoying possibility of both select() and recv()
-// returning EINTR.
+// never blocks in recv(), so it can be used on an fd which has been set
+// non-blocking.  Where possible it tries to read straight away, as there
+// usually is data available, and only waits if there isn't.  It also has to
+// cope with the annoying possibility of both the wait and recv() returning
+// EINTR.
 //
 
 size_t FdInStream::readWithTimeoutOrCallback(void* buf, size_t len, bool wait)
@@ -181,36 +245,39 @@ size_t FdInStream::readWithTimeoutOrCallback(void* buf, size_t len, bool wait)
 
   int n;
   while (true) {
+#ifdef MSG_DONTWAIT
     do {
-      fd_set fds;
-      struct timeval tv;
-      struct timeval* tvp = &tv;
-
-      if (!wait) {
-        tv.tv_sec = tv.tv_usec = 0;
-      } else if (timeoutms != -1) {
-        tv.tv_sec = timeoutms / 1000;
-        tv.tv_usec = (timeoutms % 1000) * 1000;
-      } else {
-        tvp = 0;
-      }
-
-      FD_ZERO(&fds);
-      FD_SET(fd, &fds);
-      n = select(fd+1, &fds, 0, 0, tvp);
+      n = recvData(buf, len, MSG_DONTWAIT);
     } while (n < 0 && errno == EINTR);
 
-    if (n > 0) break;
-    if (n < 0) throw SystemException("select",errno);
+    if (n >= 0)
+      break;
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      throw SystemException("read",errno);
+    if (!wait) return 0;
+#endif
+
+    n = waitForRead(fd, wait ? timeoutms : 0);
+
+    if (n < 0) throw SystemException("poll",errno);
+    if (n > 0) {
+#ifdef MSG_DONTWAIT
+      continue;
+#else
+      break;
+#endif
+    }
     if (!wait) return 0;
     if (!blockCallback) throw TimedOut();
 
     blockCallback->blockCallback();
   }
 
+#ifndef MSG_DONTWAIT
   do {
-    n = ::recv(fd, (char*)buf, len, 0);
+    n = recvData(buf, len, 0);
   } while (n < 0 && errno == EINTR);
+#endif
 
   if (n < 0) throw SystemException("read",errno);
   if (n == 0) throw EndOfStream();
@@ -260,3 +327,69 @@ unsigned int FdInStream::kbitsPerSecond()
 
   return timedKbits * 10000 / timeWaitedIn100us;
 }
+
+//
+// recvData() is recv(), except that it also picks up any file
+// descriptors sent along with the data. Those are closed if we aren't
+// expecting any, so that the peer can't use up all of ours.
+//
+
+int FdInStream::recvData(void* buf, size_t len, int flags)
+{
+#ifdef _WIN32
+  return ::recv(fd, (char*)buf, len, flags);
+#else
+  struct iovec iov;
+  struct msghdr msg;
+  char control[CMSG_SPACE(sizeof(int) * MAX_RECEIVED_FDS)];
+  struct cmsghdr* cmsg;
+  int n;
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+#ifdef MSG_CMSG_CLOEXEC
+  flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+  n = ::recvmsg(fd, &msg, flags);
+  if (n < 0)
+    return n;
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    const int* fds;
+    size_t count;
+
+    if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+      continue;
+
+    fds = (const int*)CMSG_DATA(cmsg);
+    count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; i++) {
+      if (!receiveFds) {
+        close(fds[i]);
+        continue;
+      }
+#ifndef MSG_CMSG_CLOEXEC
+      // Not atomic, but better than leaking it to child processes
+      fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+#endif
+      receivedFds.push_back(fds[i]);
+    }
+  }
+
+  // The kernel discards whatever didn't fit, so we would be out of
+  // step with the peer
+  if (receiveFds && (msg.msg_flags & MSG_CTRUNC))
+    throw Exception("Too many file descriptors received");
+
+  return n;
+#endif
+}
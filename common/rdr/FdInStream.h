@@ -23,6 +23,8 @@
 #ifndef __RDR_FDINSTREAM_H__
 #define __RDR_FDINSTREAM_H__
 
+#include <list>
+
 #include <rdr/InStream.h>
 
 namespace rdr {
@@ -49,6 +51,14 @@ namespace rdr {
     size_t pos();
     void readBytes(void* data, size_t length);
 
+    // File descriptors passed along with the data are closed straight
+    // away unless setReceiveFds() has enabled picking them up. If so,
+    // receiveFd() returns the oldest one passed along with the data
+    // read so far, or -1 if there is none. The caller is responsible
+    // for closing it.
+    void setReceiveFds(bool enable);
+    int receiveFd();
+
     void startTiming();
     void stopTiming();
     unsigned int kbitsPerSecond();
@@ -59,6 +69,7 @@ namespace rdr {
 
   private:
     size_t readWithTimeoutOrCallback(void* buf, size_t len, bool wait=true);
+    int recvData(void* buf, size_t len, int flags);
 
     int fd;
     bool closeWhenDone;
@@ -72,6 +83,9 @@ namespace rdr {
     size_t bufSize;
     size_t offset;
     U8* start;
+
+    bool receiveFds;
+    std::list<int> receivedFds;
   };
 
 } // end of namespace rdr
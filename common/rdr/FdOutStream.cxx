@@ -35,11 +35,8 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/socket.h>
-#endif
-
-/* Old systems have select() in sys/time.h */
-#ifdef HAVE_SYS_SELECT_H
-#include <sys/select.h>
+#include <sys/uio.h>
+#include <poll.h>
 #endif
 
 #include <rdr/FdOutStream.h>
@@ -51,9 +48,13 @@ using namespace rdr;
 
 enum { DEFAULT_BUF_SIZE = 16384 };
 
+// How many buffers we try to send with a single call
+enum { MAX_IOV = 64 };
+
 FdOutStream::FdOutStream(int fd_, bool blocking_, int timeoutms_, size_t bufSize_)
   : fd(fd_), blocking(blocking_), timeoutms(timeoutms_),
-    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0)
+    bufSize(bufSize_ ? bufSize_ : DEFAULT_BUF_SIZE), offset(0),
+    queued(0), queueLimit(0), spare(NULL)
 {
   ptr = start = sentUpTo = new U8[bufSize];
   end = start + bufSize;
@@ -68,7 +69,16 @@ FdOutStream::~FdOutStream()
     flush();
   } catch (Exception&) {
   }
+  while (!queue.empty()) {
+    delete [] queue.front().start;
+    queue.pop_front();
+  }
+  delete [] spare;
   delete [] start;
+#ifndef _WIN32
+  for (size_t i = 0; i < pendingFds.size(); i++)
+    close(pendingFds[i]);
+#endif
 }
 
 void FdOutStream::setTimeout(int timeoutms_) {
@@ -79,14 +89,34 @@ void FdOutStream::setBlocking(bool blocking_) {
   blocking = blocking_;
 }
 
+void FdOutStream::setQueueLimit(size_t limit) {
+  queueLimit = limit;
+}
+
+void FdOutStream::sendFd(int fd_)
+{
+#ifdef _WIN32
+  throw Exception("Passing file descriptors is not supported");
+#else
+  int copy;
+
+  // The caller might close its copy before we get to send it
+  copy = dup(fd_);
+  if (copy < 0)
+    throw SystemException("dup", errno);
+
+  pendingFds.push_back(copy);
+#endif
+}
+
 size_t FdOutStream::length()
 {
-  return offset + ptr - sentUpTo;
+  return offset + queued + ptr - sentUpTo;
 }
 
 int FdOutStream::bufferUsage()
 {
-  return ptr - sentUpTo;
+  return queued + ptr - sentUpTo;
 }
 
 unsigned FdOutStream::getIdleTime()
@@ -96,10 +126,8 @@ unsigned FdOutStream::getIdleTime()
 
 void FdOutStream::flush()
 {
-  while (sentUpTo < ptr) {
-    size_t n = writeWithTimeout((const void*) sentUpTo,
-                                ptr - sentUpTo,
-                                blocking? timeoutms : 0);
+  while (!queue.empty() || (sentUpTo < ptr)) {
+    size_t n = writeWithTimeout(blocking? timeoutms : 0);
 
     // Timeout?
     if (n == 0) {
@@ -110,12 +138,11 @@ void FdOutStream::flush()
       throw TimedOut();
     }
 
-    sentUpTo += n;
-    offset += n;
+    consume(n);
   }
 
    // Managed to flush everything?
-  if (sentUpTo == ptr)
+  if (queue.empty() && (sentUpTo == ptr))
     ptr = sentUpTo = start;
 }
 
@@ -132,11 +159,16 @@ size_t FdOutStream::overrun(size_t itemSize, size_t nItems)
   if (itemSize > (size_t)(end - ptr)) {
     // Can we shuffle things around?
     // (don't do this if it gains us less than 25%)
-    if (((size_t)(sentUpTo - start) > bufSize / 4) &&
+    if (queue.empty() &&
+        ((size_t)(sentUpTo - start) > bufSize / 4) &&
         (itemSize < bufSize - (ptr - sentUpTo))) {
       memmove(start, sentUpTo, ptr - sentUpTo);
       ptr = start + (ptr - sentUpTo);
       sentUpTo = start;
+    } else if (!blocking &&
+               (queued + (ptr - sentUpTo) + bufSize <= queueLimit)) {
+      // Put this buffer aside until the socket is writable again
+      queueBuffer();
     } else {
       // Have to get rid of more data, so turn off non-blocking
       // for a bit...
@@ -157,21 +189,80 @@ size_t FdOutStream::overrun(size_t itemSize, size_t nItems)
   return nItems;
 }
 
+// consume() marks the given number of bytes as sent, releasing any
+// queued buffers that are now empty
+
+void FdOutStream::consume(size_t length)
+{
+  offset += length;
+
+  while (!queue.empty()) {
+    Chunk* chunk;
+    size_t n;
+
+    chunk = &queue.front();
+
+    n = chunk->end - chunk->sentUpTo;
+    if (n > length)
+      n = length;
+
+    chunk->sentUpTo += n;
+    queued -= n;
+    length -= n;
+
+    if (chunk->sentUpTo < chunk->end)
+      return;
+
+    // Keep one buffer around as these tend to come in bursts
+    if (spare == NULL)
+      spare = chunk->start;
+    else
+      delete [] chunk->start;
+
+    queue.pop_front();
+  }
+
+  sentUpTo += length;
+}
+
+// queueBuffer() moves the current buffer, as is, to the end of the
+// queue and starts a new one
+
+void FdOutStream::queueBuffer()
+{
+  Chunk chunk;
+
+  chunk.start = start;
+  chunk.sentUpTo = sentUpTo;
+  chunk.end = ptr;
+
+  queue.push_back(chunk);
+  queued += ptr - sentUpTo;
+
+  if (spare != NULL) {
+    start = spare;
+    spare = NULL;
+  } else {
+    start = new U8[bufSize];
+  }
+
+  ptr = sentUpTo = start;
+  end = start + bufSize;
+}
+
 //
-// writeWithTimeout() writes up to the given length in bytes from the given
-// buffer to the file descriptor.  If there is a timeout set and that timeout
-// expires, it throws a TimedOut exception.  Otherwise it returns the number of
-// bytes written.  It never attempts to send() unless select() indicates that
-// the fd is writable - this means it can be used on an fd which has been set
-// non-blocking.  It also has to cope with the annoying possibility of both
-// select() and send() returning EINTR.
+// waitForWrite() waits for at most timeoutms milliseconds, or forever if
+// it is -1, for the file descriptor to become writable. It returns a
+// positive value if it did, zero if it timed out and a negative value on
+// errors.
 //
 
-size_t FdOutStream::writeWithTimeout(const void* data, size_t length, int timeoutms)
+static int waitForWrite(int fd, int timeoutms)
 {
   int n;
 
   do {
+#ifdef _WIN32
     fd_set fds;
     struct timeval tv;
     struct timeval* tvp = &tv;
@@ -186,28 +277,142 @@ size_t FdOutStream::writeWithTimeout(const void* data, size_t length, int timeou
     FD_ZERO(&fds);
     FD_SET(fd, &fds);
     n = select(fd+1, 0, &fds, 0, tvp);
+#else
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    n = poll(&pfd, 1, timeoutms);
+#endif
   } while (n < 0 && errno == EINTR);
 
+  return n;
+}
+
+//
+// writeWithTimeout() writes as much as it can of the queued buffers and
+// then the current buffer to the file descriptor.  If there is a timeout
+// set and that timeout expires, it returns 0.  Otherwise it returns the
+// number of bytes written.  It never blocks in send(), so it can be used
+// on an fd which has been set non-blocking.  Where possible it tries to
+// send straight away, and only waits if the socket buffer is full.  It
+// also has to cope with the annoying possibility of both the wait and
+// send() returning EINTR.
+//
+
+size_t FdOutStream::writeWithTimeout(int timeoutms)
+{
+  int n;
+
+#ifdef _WIN32
+  const U8* data;
+  size_t length;
+
+  n = waitForWrite(fd, timeoutms);
   if (n < 0)
     throw SystemException("select", errno);
-
   if (n == 0)
     return 0;
 
+  if (!queue.empty()) {
+    data = queue.front().sentUpTo;
+    length = queue.front().end - data;
+  } else {
+    data = sentUpTo;
+    length = ptr - sentUpTo;
+  }
+
   do {
-    // select only guarantees that you can write SO_SNDLOWAT without
-    // blocking, which is normally 1. Use MSG_DONTWAIT to avoid
-    // blocking, when possible.
-#ifndef MSG_DONTWAIT
     n = ::send(fd, (const char*)data, length, 0);
+  } while (n < 0 && (errno == EINTR));
 #else
-    n = ::send(fd, (const char*)data, length, MSG_DONTWAIT);
+  struct iovec iov[MAX_IOV];
+  struct msghdr msg;
+  std::vector<char> control;
+  std::deque<Chunk>::const_iterator iter;
+  int count;
+
+  // Send as many of the buffers as we can in one go
+  count = 0;
+  for (iter = queue.begin(); iter != queue.end(); ++iter) {
+    if (count == MAX_IOV - 1)
+      break;
+    iov[count].iov_base = iter->sentUpTo;
+    iov[count].iov_len = iter->end - iter->sentUpTo;
+    count++;
+  }
+  if ((iter == queue.end()) && (sentUpTo < ptr)) {
+    iov[count].iov_base = sentUpTo;
+    iov[count].iov_len = ptr - sentUpTo;
+    count++;
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+
+  // Any file descriptors go along with the first byte we manage to
+  // send, which is never later than the data written after sendFd()
+  if (!pendingFds.empty()) {
+    struct cmsghdr* cmsg;
+    size_t length;
+
+    length = sizeof(int) * pendingFds.size();
+    control.resize(CMSG_SPACE(length));
+
+    msg.msg_control = &control[0];
+    msg.msg_controllen = control.size();
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(length);
+    memcpy(CMSG_DATA(cmsg), &pendingFds[0], length);
+  }
+
+  while (true) {
+#ifdef MSG_DONTWAIT
+    do {
+      n = ::sendmsg(fd, &msg, MSG_DONTWAIT);
+    } while (n < 0 && (errno == EINTR));
+
+    if (n >= 0)
+      break;
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      throw SystemException("write", errno);
+    if (timeoutms == 0)
+      return 0;
+#endif
+
+    n = waitForWrite(fd, timeoutms);
+    if (n < 0)
+      throw SystemException("poll", errno);
+    if (n == 0)
+      return 0;
+
+#ifndef MSG_DONTWAIT
+    // The wait only guarantees that we can write SO_SNDLOWAT without
+    // blocking, which is normally 1, so this might still block
+    do {
+      n = ::sendmsg(fd, &msg, 0);
+    } while (n < 0 && (errno == EINTR));
+    break;
+#endif
+  }
 #endif
-  } while (n < 0 && (errno == EINTR));
 
   if (n < 0)
     throw SystemException("write", errno);
 
+#ifndef _WIN32
+  if (n > 0) {
+    // The other end has its own copies now
+    for (size_t i = 0; i < pendingFds.size(); i++)
+      close(pendingFds[i]);
+    pendingFds.clear();
+  }
+#endif
+
   gettimeofday(&lastWrite, NULL);
 
   return n;
@@ -26,6 +26,9 @@
 
 #include <sys/time.h>
 
+#include <deque>
+#include <vector>
+
 #include <rdr/OutStream.h>
 
 namespace rdr {
@@ -41,6 +44,15 @@ namespace rdr {
     void setBlocking(bool blocking);
     int getFd() { return fd; }
 
+    // setQueueLimit() allows a non-blocking stream to keep up to the
+    // given number of bytes waiting to be sent, rather than blocking
+    // when the buffer is full. The default is 0, i.e. always block.
+    void setQueueLimit(size_t limit);
+
+    // sendFd() passes a copy of the file descriptor along with the
+    // data that is sent next. This only works on UNIX domain sockets.
+    void sendFd(int fd);
+
     void flush();
     size_t length();
 
@@ -50,7 +62,9 @@ namespace rdr {
 
   private:
     size_t overrun(size_t itemSize, size_t nItems);
-    size_t writeWithTimeout(const void* data, size_t length, int timeoutms);
+    size_t writeWithTimeout(int timeoutms);
+    void consume(size_t length);
+    void queueBuffer();
     int fd;
     bool blocking;
     int timeoutms;
@@ -59,6 +73,19 @@ namespace rdr {
     U8* start;
     U8* sentUpTo;
     struct timeval lastWrite;
+
+    // Full buffers waiting to be sent before the current one
+    struct Chunk {
+      U8* start;
+      U8* sentUpTo;
+      U8* end;
+    };
+    std::deque<Chunk> queue;
+    size_t queued;
+    size_t queueLimit;
+
+    std::vector<int> pendingFds;
+    U8* spare;
   };
 
 }
@@ -69,7 +69,8 @@ size_t FileInStream::overrun(size_t itemSize, size_t nItems, bool wait)
 
 
   while ((size_t)(end - b) < itemSize) {
-    size_t n = fread((U8 *)end, b + sizeof(b) - end, 1, file);
+    // Partial reads are fine, so we don't lose the end of the file
+    size_t n = fread((U8 *)end, 1, b + sizeof(b) - end, file);
     if (n == 0) {
       if (ferror(file))
         throw SystemException("fread", errno);
@@ -77,7 +78,7 @@ size_t FileInStream::overrun(size_t itemSize, size_t nItems, bool wait)
         throw EndOfStream();
       return 0;
     }
-    end += b + sizeof(b) - end;
+    end += n;
   }
 
   size_t nAvail;
@@ -98,6 +98,15 @@ void ZlibOutStream::flush()
   ptr = start;
 }
 
+void ZlibOutStream::reset()
+{
+  // Anything that hasn't been flushed is lost
+  ptr = start;
+
+  if (deflateReset(zs) != Z_OK)
+    throw Exception("ZlibOutStream: deflateReset failed");
+}
+
 size_t ZlibOutStream::overrun(size_t itemSize, size_t nItems)
 {
 #ifdef ZLIBOUT_DEBUG
@@ -41,6 +41,7 @@ namespace rdr {
     void setUnderlying(OutStream* os);
     void setCompressionLevel(int level=-1);
     void flush();
+    void reset();
     size_t length();
 
   private:
@@ -44,12 +44,13 @@ static LogWriter vlog("CConnection");
 CConnection::CConnection()
   : csecurity(0),
     supportsLocalCursor(false), supportsDesktopResize(false),
-    supportsLEDState(false),
+    supportsLEDState(false), supportsContentCache(false),
+    supportsSharedFramebuffer(false),
     is(0), os(0), reader_(0), writer_(0),
     shared(false),
     state_(RFBSTATE_UNINITIALISED),
     pendingPFChange(false), preferredEncoding(encodingTight),
-    compressLevel(2), qualityLevel(-1),
+    compressLevel(2), qualityLevel(-1), serverScale(1),
     formatChange(false), encodingChange(false),
     firstUpdate(true), pendingUpdate(false), continuousUpdates(false),
     forceNonincremental(true),
@@ -466,6 +467,78 @@ void CConnection::dataRect(const Rect& r, int encoding)
   decoder.decodeRect(r, encoding, framebuffer);
 }
 
+void CConnection::contentCacheStore(const Rect& r, rdr::U32 id)
+{
+  // The stored content must be what the preceding rects decoded to
+  decoder.flush();
+
+  contentCache.store(id, framebuffer, r);
+}
+
+void CConnection::contentCacheDraw(const Rect& r, rdr::U32 id)
+{
+  // Make sure we don't race with decoders still writing to this area
+  decoder.flush();
+
+  contentCache.draw(id, framebuffer, r);
+}
+
+void CConnection::contentCacheReset()
+{
+  contentCache.clear();
+}
+
+int CConnection::receiveFd()
+{
+  return -1;
+}
+
+void CConnection::sharedFramebufferAttach(int width, int height,
+                                          const PixelFormat& pf, int stride)
+{
+  int fd;
+
+  fd = receiveFd();
+  if (fd == -1)
+    throw Exception("Server did not pass the shared framebuffer");
+
+  sharedFramebuffer.attach(fd, pf, width, height, stride);
+
+  vlog.info("Using shared framebuffer");
+}
+
+void CConnection::sharedFramebufferUpdate(const Rect& r)
+{
+  const rdr::U8* data;
+  int stride;
+
+  if (!sharedFramebuffer.isValid())
+    throw Exception("Shared framebuffer update without a shared framebuffer");
+
+  // Make sure we don't race with decoders still writing to this area
+  decoder.flush();
+
+  data = sharedFramebuffer.getBuffer(r, &stride);
+  framebuffer->imageRect(sharedFramebuffer.getPF(), r, data, stride);
+}
+
+void CConnection::supportsServerScale()
+{
+  CMsgHandler::supportsServerScale();
+
+  if (serverScale != 1)
+    writer()->writeSetScale(serverScale);
+}
+
+void CConnection::supportsTightParallel()
+{
+  // The decoders check this when deciding what can run in parallel,
+  // so don't change it under their feet
+  decoder.flush();
+
+  CMsgHandler::supportsTightParallel();
+}
+
 void CConnection::serverCutText(const char* str)
 {
   hasLocalClipboard = false;
@@ -643,6 +716,21 @@ void CConnection::setQualityLevel(int level)
   encodingChange = true;
 }
 
+void CConnection::setServerScale(int scale)
+{
+  if (serverScale == scale)
+    return;
+
+  serverScale = scale;
+
+  if (server.supportsServerScale) {
+    if (state() == RFBSTATE_NORMAL)
+      writer()->writeSetScale(serverScale);
+  } else {
+    encodingChange = true;
+  }
+}
+
 void CConnection::setPF(const PixelFormat& pf)
 {
   if (server.pf().equal(pf) && !formatChange)
@@ -733,6 +821,16 @@ void CConnection::updateEncodings()
     encodings.push_back(pseudoEncodingLEDState);
     encodings.push_back(pseudoEncodingVMwareLEDState);
   }
+  if (supportsContentCache)
+    encodings.push_back(pseudoEncodingContentCache);
+  if (supportsSharedFramebuffer)
+    encodings.push_back(pseudoEncodingSharedFramebuffer);
+  if (serverScale != 1)
+    encodings.push_back(pseudoEncodingServerScale);
+  // Independent Tight rects compress worse, so only ask for them if
+  // we can make use of them
+  if (decoder.isThreaded())
+    encodings.push_back(pseudoEncodingTightParallel);
 
   encodings.push_back(pseudoEncodingDesktopName);
   encodings.push_back(pseudoEncodingLastRect);
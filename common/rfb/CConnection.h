@@ -25,6 +25,8 @@
 #define __RFB_CCONNECTION_H__
 
 #include <rfb/CMsgHandler.h>
+#include <rfb/ContentCache.h>
+#include <rfb/SharedFramebuffer.h>
 #include <rfb/DecodeManager.h>
 #include <rfb/SecurityClient.h>
 #include <rfb/util.h>
@@ -109,6 +111,17 @@ namespace rfb {
     virtual void framebufferUpdateEnd();
     virtual void dataRect(const Rect& r, int encoding);
 
+    virtual void contentCacheStore(const Rect& r, rdr::U32 id);
+    virtual void contentCacheDraw(const Rect& r, rdr::U32 id);
+    virtual void contentCacheReset();
+
+    virtual void sharedFramebufferAttach(int width, int height,
+                                         const PixelFormat& pf, int stride);
+    virtual void sharedFramebufferUpdate(const Rect& r);
+
+    virtual void supportsServerScale();
+    virtual void supportsTightParallel();
+
     virtual void serverCutText(const char* str);
 
     virtual void handleClipboardCaps(rdr::U32 flags,
@@ -188,6 +201,9 @@ namespace rfb {
     // sent to the server
     void setCompressLevel(int level);
     void setQualityLevel(int level);
+    // setServerScale() asks the server to scale down the framebuffer
+    // by the given factor before sending it, if it supports that
+    void setServerScale(int scale);
     // setPF() controls the pixel format requested from the server.
     // server.pf() will automatically be adjusted once the new format
     // is active.
@@ -234,6 +250,13 @@ namespace rfb {
     bool supportsLocalCursor;
     bool supportsDesktopResize;
     bool supportsLEDState;
+    bool supportsContentCache;
+    // Only for connections where receiveFd() works
+    bool supportsSharedFramebuffer;
+
+    // receiveFd() returns the next file descriptor the server has
+    // passed along with the data, or -1 if there is none
+    virtual int receiveFd();
 
   private:
     // This is a default implementation of fences that automatically
@@ -271,6 +294,7 @@ namespace rfb {
     int preferredEncoding;
     int compressLevel;
     int qualityLevel;
+    int serverScale;
 
     bool formatChange;
     rfb::PixelFormat nextPF;
@@ -284,6 +308,8 @@ namespace rfb {
 
     ModifiablePixelBuffer* framebuffer;
     DecodeManager decoder;
+    ClientContentCache contentCache;
+    SharedFramebuffer sharedFramebuffer;
 
     char* serverClipboard;
     bool hasLocalClipboard;
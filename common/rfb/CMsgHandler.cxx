@@ -77,6 +77,16 @@ void CMsgHandler::supportsQEMUKeyEvent()
   server.supportsQEMUKeyEvent = true;
 }
 
+void CMsgHandler::supportsServerScale()
+{
+  server.supportsServerScale = true;
+}
+
+void CMsgHandler::supportsTightParallel()
+{
+  server.supportsTightParallel = true;
+}
+
 void CMsgHandler::serverInit(int width, int height,
                              const PixelFormat& pf,
                              const char* name)
@@ -99,6 +109,27 @@ void CMsgHandler::setLEDState(unsigned int state)
   server.setLEDState(state);
 }
 
+void CMsgHandler::contentCacheStore(const Rect& r, rdr::U32 id)
+{
+}
+
+void CMsgHandler::contentCacheDraw(const Rect& r, rdr::U32 id)
+{
+}
+
+void CMsgHandler::sharedFramebufferAttach(int width, int height,
+                                          const PixelFormat& pf, int stride)
+{
+}
+
+void CMsgHandler::sharedFramebufferUpdate(const Rect& r)
+{
+}
+
+void CMsgHandler::contentCacheReset()
+{
+}
+
 void CMsgHandler::handleClipboardCaps(rdr::U32 flags, const rdr::U32* lengths)
 {
   server.setClipboardCaps(flags, lengths);
@@ -57,6 +57,8 @@ namespace rfb {
     virtual void fence(rdr::U32 flags, unsigned len, const char data[]);
     virtual void endOfContinuousUpdates();
     virtual void supportsQEMUKeyEvent();
+    virtual void supportsServerScale();
+    virtual void supportsTightParallel();
     virtual void serverInit(int width, int height,
                             const PixelFormat& pf,
                             const char* name) = 0;
@@ -75,6 +77,14 @@ namespace rfb {
 
     virtual void setLEDState(unsigned int state);
 
+    virtual void contentCacheStore(const Rect& r, rdr::U32 id);
+    virtual void contentCacheDraw(const Rect& r, rdr::U32 id);
+    virtual void contentCacheReset();
+
+    virtual void sharedFramebufferAttach(int width, int height,
+                                         const PixelFormat& pf, int stride);
+    virtual void sharedFramebufferUpdate(const Rect& r);
+
     virtual void handleClipboardCaps(rdr::U32 flags,
                                      const rdr::U32* lengths);
     virtual void handleClipboardRequest(rdr::U32 flags);
@@ -30,6 +30,8 @@
 #include <rfb/util.h>
 #include <rfb/CMsgHandler.h>
 #include <rfb/CMsgReader.h>
+#include <rfb/ContentCache.h>
+#include <rfb/SharedFramebuffer.h>
 
 static rfb::LogWriter vlog("CMsgReader");
 
@@ -126,6 +128,18 @@ void CMsgReader::readMsg()
     case pseudoEncodingQEMUKeyEvent:
       handler->supportsQEMUKeyEvent();
       break;
+    case pseudoEncodingServerScale:
+      handler->supportsServerScale();
+      break;
+    case pseudoEncodingTightParallel:
+      handler->supportsTightParallel();
+      break;
+    case pseudoEncodingContentCache:
+      readContentCache(Rect(x, y, x+w, y+h));
+      break;
+    case pseudoEncodingSharedFramebuffer:
+      readSharedFramebuffer(Rect(x, y, x+w, y+h));
+      break;
     default:
       readRect(Rect(x, y, x+w, y+h), encoding);
       break;
@@ -600,6 +614,73 @@ void CMsgReader::readLEDState()
   handler->setLEDState(state);
 }
 
+void CMsgReader::readContentCache(const Rect& r)
+{
+  rdr::U8 op;
+  rdr::U32 id;
+
+  op = is->readU8();
+  id = is->readU32();
+
+  if (op == contentCacheReset) {
+    handler->contentCacheReset();
+    return;
+  }
+
+  if ((r.br.x > handler->server.width()) ||
+      (r.br.y > handler->server.height())) {
+    vlog.error("Content cache rect too big: %dx%d at %d,%d exceeds %dx%d",
+	    r.width(), r.height(), r.tl.x, r.tl.y,
+            handler->server.width(), handler->server.height());
+    throw Exception("Content cache rect too big");
+  }
+
+  switch (op) {
+  case contentCacheStore:
+    handler->contentCacheStore(r, id);
+    break;
+  case contentCacheDraw:
+    handler->contentCacheDraw(r, id);
+    break;
+  default:
+    throw Exception("Unknown content cache operation %d", (int)op);
+  }
+}
+
+void CMsgReader::readSharedFramebuffer(const Rect& r)
+{
+  rdr::U8 op;
+
+  op = is->readU8();
+
+  switch (op) {
+  case sharedFramebufferAttach:
+    {
+      PixelFormat pf;
+      int stride;
+
+      pf.read(is);
+      stride = is->readU32();
+
+      handler->sharedFramebufferAttach(r.width(), r.height(), pf, stride);
+    }
+    break;
+  case sharedFramebufferUpdate:
+    if ((r.br.x > handler->server.width()) ||
+        (r.br.y > handler->server.height())) {
+      vlog.error("Shared framebuffer rect too big: %dx%d at %d,%d exceeds %dx%d",
+                 r.width(), r.height(), r.tl.x, r.tl.y,
+                 handler->server.width(), handler->server.height());
+      throw Exception("Shared framebuffer rect too big");
+    }
+
+    handler->sharedFramebufferUpdate(r);
+    break;
+  default:
+    throw Exception("Unknown shared framebuffer operation %d", (int)op);
+  }
+}
+
 void CMsgReader::readVMwareLEDState()
 {
   rdr::U32 state;
@@ -69,6 +69,8 @@ namespace rfb {
     void readExtendedDesktopSize(int x, int y, int w, int h);
     void readLEDState();
     void readVMwareLEDState();
+    void readContentCache(const Rect& r);
+    void readSharedFramebuffer(const Rect& r);
 
     CMsgHandler* handler;
     rdr::InStream* is;
@@ -96,6 +96,19 @@ void CMsgWriter::writeSetDesktopSize(int width, int height,
   endMsg();
 }
 
+void CMsgWriter::writeSetScale(int scale)
+{
+  if (!server->supportsServerScale)
+    throw Exception("Server does not support SetScale");
+  if ((scale < 1) || (scale > 255))
+    throw Exception("Invalid scale factor %d", scale);
+
+  startMsg(msgTypeSetScale);
+  os->writeU8(scale);
+  os->pad(2);
+  endMsg();
+}
+
 void CMsgWriter::writeFramebufferUpdateRequest(const Rect& r, bool incremental)
 {
   startMsg(msgTypeFramebufferUpdateRequest);
@@ -47,6 +47,7 @@ namespace rfb {
     void writeSetPixelFormat(const PixelFormat& pf);
     void writeSetEncodings(const std::list<rdr::U32> encodings);
     void writeSetDesktopSize(int width, int height, const ScreenSet& layout);
+    void writeSetScale(int scale);
 
     void writeFramebufferUpdateRequest(const Rect& r,bool incremental);
     void writeEnableContinuousUpdates(bool enable, int x, int y, int w, int h);
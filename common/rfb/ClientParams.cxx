@@ -195,6 +195,28 @@ bool ClientParams::supportsFence() const
   return false;
 }
 
+bool ClientParams::supportsContentCache() const
+{
+  // Draws and stores are only valid as part of an update with an
+  // unknown number of rects
+  if (!supportsEncoding(pseudoEncodingContentCache))
+    return false;
+  if (!supportsEncoding(pseudoEncodingLastRect))
+    return false;
+  return true;
+}
+
+bool ClientParams::supportsSharedFramebuffer() const
+{
+  // The number of rects depends on how the changed region is split
+  // up, which isn't known in advance
+  if (!supportsEncoding(pseudoEncodingSharedFramebuffer))
+    return false;
+  if (!supportsEncoding(pseudoEncodingLastRect))
+    return false;
+  return true;
+}
+
 bool ClientParams::supportsContinuousUpdates() const
 {
   if (supportsEncoding(pseudoEncodingContinuousUpdates))
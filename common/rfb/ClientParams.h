@@ -93,6 +93,8 @@ namespace rfb {
     bool supportsDesktopSize() const;
     bool supportsLEDState() const;
     bool supportsFence() const;
+    bool supportsContentCache() const;
+    bool supportsSharedFramebuffer() const;
     bool supportsContinuousUpdates() const;
 
     int compressLevel;
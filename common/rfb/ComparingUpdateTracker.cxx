@@ -17,21 +17,247 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <rdr/types.h>
 #include <rfb/Exception.h>
 #include <rfb/LogWriter.h>
 #include <rfb/ComparingUpdateTracker.h>
+#include <rfb/PixelFormatSIMD.h>
+#include <rfb/util.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define CUT_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+#define CUT_NEON
+#include <arm_neon.h>
+#endif
 
 using namespace rfb;
 
 static LogWriter vlog("ComparingUpdateTracker");
 
+//
+// Row comparison kernels
+//
+// These compare a row of pixels from the old and the new framebuffer.
+// If they differ then the offsets of the first and last differing
+// bytes are returned, and the differing parts of the new row are
+// copied over to the old one. All in a single pass over the data.
+//
+
+typedef bool (*CompareRowFn)(rdr::U8* oldRow, const rdr::U8* newRow,
+                             int length, int* first, int* last);
+
+static bool compareRowGeneric(rdr::U8* oldRow, const rdr::U8* newRow,
+                              int length, int* first, int* last)
+{
+  int start, end;
+
+  if (memcmp(oldRow, newRow, length) == 0)
+    return false;
+
+  start = 0;
+  while (oldRow[start] == newRow[start])
+    start++;
+
+  end = length - 1;
+  while (oldRow[end] == newRow[end])
+    end--;
+
+  memcpy(oldRow + start, newRow + start, end - start + 1);
+
+  *first = start;
+  *last = end;
+
+  return true;
+}
+
+// Handles whatever is left after the vectorised part of a row
+static inline void compareTail(rdr::U8* oldRow, const rdr::U8* newRow,
+                               int offset, int length, int* start, int* end)
+{
+  for (; offset < length; offset++) {
+    if (oldRow[offset] == newRow[offset])
+      continue;
+    if (*start == -1)
+      *start = offset;
+    *end = offset;
+    oldRow[offset] = newRow[offset];
+  }
+}
+
+#ifdef CUT_X86_SIMD
+
+__attribute__((target("sse2")))
+static bool compareRowSSE2(rdr::U8* oldRow, const rdr::U8* newRow,
+                           int length, int* first, int* last)
+{
+  int offset, start, end;
+
+  start = end = -1;
+
+  for (offset = 0; offset + 16 <= length; offset += 16) {
+    __m128i a, b;
+    unsigned mask;
+
+    a = _mm_loadu_si128((const __m128i*)(oldRow + offset));
+    b = _mm_loadu_si128((const __m128i*)(newRow + offset));
+
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff;
+    if (mask == 0)
+      continue;
+
+    if (start == -1)
+      start = offset + __builtin_ctz(mask);
+    end = offset + 31 - __builtin_clz(mask);
+
+    _mm_storeu_si128((__m128i*)(oldRow + offset), b);
+  }
+
+  compareTail(oldRow, newRow, offset, length, &start, &end);
+
+  if (start == -1)
+    return false;
+
+  *first = start;
+  *last = end;
+
+  return true;
+}
+
+__attribute__((target("avx2")))
+static bool compareRowAVX2(rdr::U8* oldRow, const rdr::U8* newRow,
+                           int length, int* first, int* last)
+{
+  int offset, start, end;
+
+  start = end = -1;
+
+  for (offset = 0; offset + 32 <= length; offset += 32) {
+    __m256i a, b;
+    unsigned mask;
+
+    a = _mm256_loadu_si256((const __m256i*)(oldRow + offset));
+    b = _mm256_loadu_si256((const __m256i*)(newRow + offset));
+
+    mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+    if (mask == 0)
+      continue;
+
+    if (start == -1)
+      start = offset + __builtin_ctz(mask);
+    end = offset + 31 - __builtin_clz(mask);
+
+    _mm256_storeu_si256((__m256i*)(oldRow + offset), b);
+  }
+
+  compareTail(oldRow, newRow, offset, length, &start, &end);
+
+  if (start == -1)
+    return false;
+
+  *first = start;
+  *last = end;
+
+  return true;
+}
+
+#endif // CUT_X86_SIMD
+
+#ifdef CUT_NEON
+
+static bool compareRowNEON(rdr::U8* oldRow, const rdr::U8* newRow,
+                           int length, int* first, int* last)
+{
+  int offset, start, end;
+
+  start = end = -1;
+
+  for (offset = 0; offset + 16 <= length; offset += 16) {
+    uint8x16_t a, b, diff;
+    uint64_t mask;
+
+    a = vld1q_u8(oldRow + offset);
+    b = vld1q_u8(newRow + offset);
+
+    diff = vmvnq_u8(vceqq_u8(a, b));
+
+    // Narrow to four bits per byte so the result fits in a scalar
+    mask = vget_lane_u64(vreinterpret_u64_u8(
+             vshrn_n_u16(vreinterpretq_u16_u8(diff), 4)), 0);
+    if (mask == 0)
+      continue;
+
+    if (start == -1)
+      start = offset + __builtin_ctzll(mask) / 4;
+    end = offset + (63 - __builtin_clzll(mask)) / 4;
+
+    vst1q_u8(oldRow + offset, b);
+  }
+
+  compareTail(oldRow, newRow, offset, length, &start, &end);
+
+  if (start == -1)
+    return false;
+
+  *first = start;
+  *last = end;
+
+  return true;
+}
+
+#endif // CUT_NEON
+
+static CompareRowFn compareRow = NULL;
+
+static void selectCompareRow()
+{
+  const char* name;
+
+  if (compareRow != NULL)
+    return;
+
+  compareRow = compareRowGeneric;
+  name = "generic";
+
+#ifdef CUT_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    compareRow = compareRowAVX2;
+    name = "AVX2";
+  } else if (__builtin_cpu_supports("sse2")) {
+    compareRow = compareRowSSE2;
+    name = "SSE2";
+  }
+#endif
+
+#ifdef CUT_NEON
+  // The NEON code hasn't been verified on real hardware yet, so like
+  // the pixel conversions it is only used if explicitly asked for with
+  // setSIMDLevel()
+  if (getSIMDLevel() == simdNEON) {
+    compareRow = compareRowNEON;
+    name = "NEON";
+  }
+#endif
+
+  vlog.debug("Using %s framebuffer comparison", name);
+}
+
 ComparingUpdateTracker::ComparingUpdateTracker(PixelBuffer* buffer)
   : fb(buffer), oldFb(fb->getPF(), 0, 0), firstCompare(true),
-    enabled(true), totalPixels(0), missedPixels(0)
+    enabled(true), hashing(false), blocksWide(0), blocksHigh(0),
+    scrollDetection(false), totalPixels(0), missedPixels(0), scrolls(0),
+    scrolledPixels(0)
 {
     changed.assign_union(fb->getRect());
+
+    selectCompareRow();
 }
 
 ComparingUpdateTracker::~ComparingUpdateTracker()
@@ -41,6 +267,17 @@ ComparingUpdateTracker::~ComparingUpdateTracker()
 
 #define BLOCK_SIZE 64
 
+// Only look for scrolling in changed rects at least this big in both
+// directions, and only report runs of at least this many lines
+#define SCROLL_MIN_SIZE 64
+#define SCROLL_MIN_LINES 32
+// Lines that need to agree on an offset before we bother checking it
+#define SCROLL_MIN_VOTES 4
+// Only every this many rows are used when looking for a scroll
+// offset, and when hashing columns
+#define SCROLL_ROW_SAMPLE 4
+#define SCROLL_COLUMN_SAMPLE 4
+
 bool ComparingUpdateTracker::compare()
 {
   std::vector<Rect> rects;
@@ -49,6 +286,23 @@ bool ComparingUpdateTracker::compare()
   if (!enabled)
     return false;
 
+  if (firstCompare && hashing) {
+    // Same as below, but we only need to remember the hashes
+    blocksWide = (fb->width() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blocksHigh = (fb->height() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    blockHashes.resize(blocksWide * blocksHigh);
+
+    for (int by = 0; by < blocksHigh; by++) {
+      for (int bx = 0; bx < blocksWide; bx++)
+        blockHashes[by * blocksWide + bx] = hashBlock(getBlockRect(bx, by));
+    }
+
+    firstCompare = false;
+
+    return false;
+  }
+
   if (firstCompare) {
     // NB: We leave the change region untouched on this iteration,
     // since in effect the entire framebuffer has changed.
@@ -66,15 +320,36 @@ bool ComparingUpdateTracker::compare()
     return false;
   }
 
-  copied.get_rects(&rects, copy_delta.x<=0, copy_delta.y<=0);
-  for (i = rects.begin(); i != rects.end(); i++)
-    oldFb.copyRect(*i, copy_delta);
+  Region newChanged, unchanged;
+  bool scrolled;
 
-  changed.get_rects(&rects);
+  scrolled = false;
 
-  Region newChanged;
-  for (i = rects.begin(); i != rects.end(); i++)
-    compareRect(*i, &newChanged);
+  if (hashing) {
+    // We can't move hashes around, so just make sure that any block
+    // touched by a copy gets sent if it is changed again
+    copied.get_rects(&rects);
+    for (i = rects.begin(); i != rects.end(); i++)
+      invalidateBlocks(*i);
+
+    compareHashes(&newChanged);
+  } else {
+    // We can only describe a single copy per update, so don't get in
+    // the way of a real one
+    if (scrollDetection && copied.is_empty())
+      scrolled = detectScroll(&unchanged);
+
+    copied.get_rects(&rects, copy_delta.x<=0, copy_delta.y<=0);
+    for (i = rects.begin(); i != rects.end(); i++)
+      oldFb.copyRect(*i, copy_delta);
+
+    // No need to look at anything the scroll detection already found
+    // to be unchanged
+    changed.subtract(unchanged).get_rects(&rects);
+
+    for (i = rects.begin(); i != rects.end(); i++)
+      compareRect(*i, &newChanged);
+  }
 
   changed.get_rects(&rects);
   for (i = rects.begin(); i != rects.end(); i++)
@@ -83,7 +358,7 @@ bool ComparingUpdateTracker::compare()
   for (i = rects.begin(); i != rects.end(); i++)
     missedPixels += i->area();
 
-  if (changed.equals(newChanged))
+  if (!scrolled && changed.equals(newChanged))
     return false;
 
   changed = newChanged;
@@ -104,6 +379,42 @@ void ComparingUpdateTracker::disable()
   firstCompare = true;
 }
 
+void ComparingUpdateTracker::setHashing(bool hashing_)
+{
+  if (hashing == hashing_)
+    return;
+
+  hashing = hashing_;
+
+  // The old state is of no use in the new mode
+  firstCompare = true;
+  blockHashes.clear();
+
+  // Not keeping a copy of the framebuffer is the point of hashing
+  if (hashing)
+    oldFb.setSize(0, 0);
+}
+
+void ComparingUpdateTracker::setScrollDetection(bool enable)
+{
+  scrollDetection = enable;
+}
+
+// The changed areas are often scattered, so merge them pairwise
+// rather than one by one in to an ever growing region
+static Region unionRects(const Rect* rects, size_t count)
+{
+  size_t half;
+
+  if (count == 1)
+    return Region(rects[0]);
+
+  half = count / 2;
+
+  return unionRects(rects, half).union_(unionRects(rects + half,
+                                                   count - half));
+}
+
 void ComparingUpdateTracker::compareRect(const Rect& r, Region* newChanged)
 {
   if (!r.enclosed_by(fb->getRect())) {
@@ -141,26 +452,35 @@ void ComparingUpdateTracker::compareRect(const Rect& r, Region* newChanged)
       int blockRight = __rfbmin(blockLeft+BLOCK_SIZE, r.br.x);
       int blockWidthInBytes = (blockRight-blockLeft) * bytesPerPixel;
 
+      // Bounding box of the changes within this block
+      int changedTop = -1, changedBottom = -1;
+      int changedFirst = blockWidthInBytes, changedLast = -1;
+
       for (int y = blockTop; y < blockBottom; y++)
       {
-        if (memcmp(oldPtr, newPtr, blockWidthInBytes) != 0)
+        int first, last;
+
+        if (compareRow(oldPtr, newPtr, blockWidthInBytes, &first, &last))
         {
-          // A block has changed - copy the remainder to the oldFb
-          changedBlocks.push_back(Rect(blockLeft, blockTop,
-                                       blockRight, blockBottom));
-          for (int y2 = y; y2 < blockBottom; y2++)
-          {
-            memcpy(oldPtr, newPtr, blockWidthInBytes);
-            newPtr += newStrideBytes;
-            oldPtr += oldStrideBytes;
-          }
-          break;
+          if (changedTop == -1)
+            changedTop = y;
+          changedBottom = y + 1;
+          if (first < changedFirst)
+            changedFirst = first;
+          if (last > changedLast)
+            changedLast = last;
         }
 
         newPtr += newStrideBytes;
         oldPtr += oldStrideBytes;
       }
 
+      if (changedTop != -1)
+        changedBlocks.push_back(Rect(blockLeft + changedFirst / bytesPerPixel,
+                                     changedTop,
+                                     blockLeft + changedLast / bytesPerPixel + 1,
+                                     changedBottom));
+
       oldBlockPtr += blockWidthInBytes;
       newBlockPtr += blockWidthInBytes;
     }
@@ -170,11 +490,405 @@ void ComparingUpdateTracker::compareRect(const Rect& r, Region* newChanged)
 
   oldFb.commitBufferRW(r);
 
-  if (!changedBlocks.empty()) {
-    Region temp;
-    temp.setOrderedRects(changedBlocks);
-    newChanged->assign_union(temp);
+  if (!changedBlocks.empty())
+    newChanged->assign_union(unionRects(&changedBlocks[0],
+                                        changedBlocks.size()));
+}
+
+Rect ComparingUpdateTracker::getBlockRect(int bx, int by)
+{
+  Rect r;
+
+  r.setXYWH(bx * BLOCK_SIZE, by * BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE);
+
+  return r.intersect(fb->getRect());
+}
+
+rdr::U64 ComparingUpdateTracker::hashBlock(const Rect& r)
+{
+  const rdr::U8* data;
+  int stride, bytesPerPixel;
+  rdr::U64 hash;
+
+  bytesPerPixel = fb->getPF().bpp/8;
+
+  data = fb->getBuffer(r, &stride);
+
+  hash = hashRect(data, r.width() * bytesPerPixel,
+                  stride * bytesPerPixel, r.height());
+
+  // Zero is reserved for blocks that need to be compared again
+  if (hash == 0)
+    hash = 1;
+
+  return hash;
+}
+
+void ComparingUpdateTracker::invalidateBlocks(const Rect& r)
+{
+  Rect safe;
+
+  safe = r.intersect(fb->getRect());
+  if (safe.is_empty())
+    return;
+
+  for (int by = safe.tl.y / BLOCK_SIZE; by <= (safe.br.y - 1) / BLOCK_SIZE; by++) {
+    for (int bx = safe.tl.x / BLOCK_SIZE; bx <= (safe.br.x - 1) / BLOCK_SIZE; bx++)
+      blockHashes[by * blocksWide + bx] = 0;
+  }
+}
+
+void ComparingUpdateTracker::compareHashes(Region* newChanged)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::iterator i;
+
+  std::vector<bool> checked;
+  std::vector<Rect> changedBlocks;
+
+  checked.resize(blockHashes.size(), false);
+
+  changed.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); i++) {
+    Rect safe;
+
+    safe = i->intersect(fb->getRect());
+    if (safe.is_empty())
+      continue;
+
+    for (int by = safe.tl.y / BLOCK_SIZE; by <= (safe.br.y - 1) / BLOCK_SIZE; by++) {
+      for (int bx = safe.tl.x / BLOCK_SIZE; bx <= (safe.br.x - 1) / BLOCK_SIZE; bx++) {
+        int index;
+        Rect block;
+        rdr::U64 hash;
+
+        index = by * blocksWide + bx;
+        if (checked[index])
+          continue;
+        checked[index] = true;
+
+        block = getBlockRect(bx, by);
+        hash = hashBlock(block);
+        if (hash == blockHashes[index])
+          continue;
+
+        // We only know that something in the block changed, so all
+        // of it needs to be sent
+        blockHashes[index] = hash;
+        changedBlocks.push_back(block);
+      }
+    }
+  }
+
+  if (!changedBlocks.empty())
+    newChanged->assign_union(unionRects(&changedBlocks[0],
+                                        changedBlocks.size()));
+}
+
+static bool compareArea(const Rect& a, const Rect& b)
+{
+  return a.area() > b.area();
+}
+
+bool ComparingUpdateTracker::detectScroll(Region* unchanged)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::iterator i;
+
+  changed.get_rects(&rects);
+
+  // Only one copy can be reported, so try the biggest areas first
+  std::sort(rects.begin(), rects.end(), compareArea);
+
+  for (i = rects.begin(); i != rects.end(); i++) {
+    Rect safe, dest;
+    Point delta;
+
+    safe = i->intersect(fb->getRect());
+    if ((safe.width() < SCROLL_MIN_SIZE) ||
+        (safe.height() < SCROLL_MIN_SIZE))
+      continue;
+
+    // The damage is often a lot bigger than what actually moved, and
+    // static parts would stop the lines from matching
+    dest = findChangedArea(safe);
+    if (dest.is_empty()) {
+      unchanged->assign_union(Region(safe));
+      continue;
+    }
+
+    safe = dest;
+    if ((safe.width() < SCROLL_MIN_SIZE) ||
+        (safe.height() < SCROLL_MIN_SIZE))
+      continue;
+
+    if (!findScroll(safe, false, &dest, &delta) &&
+        !findScroll(safe, true, &dest, &delta))
+      continue;
+
+    add_copied(Region(dest), delta);
+
+    scrolls++;
+    scrolledPixels += dest.area();
+
+    return true;
+  }
+
+  return false;
+}
+
+Rect ComparingUpdateTracker::findChangedArea(const Rect& r)
+{
+  const rdr::U8 *oldData, *newData;
+  int oldStrideBytes, newStrideBytes, bytesPerPixel, rowBytes;
+  int top, bottom, first, last;
+
+  bytesPerPixel = fb->getPF().bpp/8;
+  rowBytes = r.width() * bytesPerPixel;
+
+  oldData = oldFb.getBuffer(r, &oldStrideBytes);
+  newData = fb->getBuffer(r, &newStrideBytes);
+  oldStrideBytes *= bytesPerPixel;
+  newStrideBytes *= bytesPerPixel;
+
+  // Search from both ends so that we don't have to look at the rows
+  // in between more than needed
+  for (top = 0; top < r.height(); top++) {
+    if (memcmp(oldData + top * oldStrideBytes,
+               newData + top * newStrideBytes, rowBytes) != 0)
+      break;
+  }
+
+  if (top == r.height())
+    return Rect();
+
+  for (bottom = r.height(); bottom > top + 1; bottom--) {
+    if (memcmp(oldData + (bottom - 1) * oldStrideBytes,
+               newData + (bottom - 1) * newStrideBytes, rowBytes) != 0)
+      break;
+  }
+
+  // Then only check the parts of each row that are outside what we
+  // already know has changed
+  first = rowBytes;
+  last = -1;
+
+  for (int y = top; y < bottom; y++) {
+    const rdr::U8 *oldRow, *newRow;
+    int i;
+
+    oldRow = oldData + y * oldStrideBytes;
+    newRow = newData + y * newStrideBytes;
+
+    if ((first > 0) && (memcmp(oldRow, newRow, first) != 0)) {
+      for (i = 0; oldRow[i] == newRow[i]; i++)
+        ;
+      first = i;
+    }
+
+    if ((last < rowBytes - 1) &&
+        (memcmp(oldRow + last + 1, newRow + last + 1,
+                rowBytes - last - 1) != 0)) {
+      for (i = rowBytes - 1; oldRow[i] == newRow[i]; i--)
+        ;
+      last = i;
+    }
+  }
+
+  return Rect(r.tl.x + first / bytesPerPixel, r.tl.y + top,
+              r.tl.x + last / bytesPerPixel + 1, r.tl.y + bottom);
+}
+
+bool ComparingUpdateTracker::findScroll(const Rect& r, bool horizontal,
+                                        Rect* dest, Point* delta)
+{
+  std::vector<rdr::U64> oldHashes, newHashes;
+  std::map<rdr::U64, int> oldLines;
+  std::map<rdr::U64, int>::iterator iter;
+  std::map<int, int> votes;
+  std::map<int, int>::const_iterator vote;
+
+  const rdr::U8 *oldData, *newData;
+  int oldStrideBytes, newStrideBytes, bytesPerPixel;
+
+  int lines, step, offset, bestVotes;
+  int runStart, bestStart, bestEnd;
+
+  bytesPerPixel = fb->getPF().bpp/8;
+
+  oldData = oldFb.getBuffer(r, &oldStrideBytes);
+  newData = fb->getBuffer(r, &newStrideBytes);
+  oldStrideBytes *= bytesPerPixel;
+  newStrideBytes *= bytesPerPixel;
+
+  hashLines(&oldFb, r, horizontal, &oldHashes);
+
+  lines = oldHashes.size();
+
+  // Rows are checked directly later, so it is enough to look at some
+  // of them here
+  if (horizontal) {
+    hashLines(fb, r, horizontal, &newHashes);
+    step = 1;
+  } else {
+    newHashes.resize(lines);
+    for (int i = 0; i < lines; i += SCROLL_ROW_SAMPLE) {
+      newHashes[i] = hashRect(newData + i * newStrideBytes,
+                              r.width() * bytesPerPixel, 0, 1);
+    }
+    step = SCROLL_ROW_SAMPLE;
+  }
+
+  // Index the old lines, ignoring those that aren't unique (e.g.
+  // blank lines) as they can't tell us where anything moved
+  for (int i = 0; i < lines; i++) {
+    iter = oldLines.find(oldHashes[i]);
+    if (iter == oldLines.end())
+      oldLines[oldHashes[i]] = i;
+    else
+      iter->second = -1;
+  }
+
+  // Then let every changed line vote for where it came from
+  for (int i = 0; i < lines; i += step) {
+    if (newHashes[i] == oldHashes[i])
+      continue;
+
+    iter = oldLines.find(newHashes[i]);
+    if ((iter == oldLines.end()) || (iter->second == -1))
+      continue;
+
+    votes[i - iter->second]++;
+  }
+
+  offset = 0;
+  bestVotes = 0;
+  for (vote = votes.begin(); vote != votes.end(); ++vote) {
+    if (vote->second > bestVotes) {
+      offset = vote->first;
+      bestVotes = vote->second;
+    }
+  }
+
+  if (bestVotes * step < SCROLL_MIN_VOTES)
+    return false;
+
+  // Find the longest run of lines that are all shifted by that offset
+  runStart = -1;
+  bestStart = bestEnd = 0;
+  for (int i = 0; i <= lines; i++) {
+    bool match;
+
+    match = false;
+    if ((i < lines) && (i - offset >= 0) && (i - offset < lines)) {
+      if (horizontal)
+        match = newHashes[i] == oldHashes[i - offset];
+      else
+        match = memcmp(newData + i * newStrideBytes,
+                       oldData + (i - offset) * oldStrideBytes,
+                       r.width() * bytesPerPixel) == 0;
+    }
+
+    if (match) {
+      if (runStart == -1)
+        runStart = i;
+      continue;
+    }
+
+    if ((runStart != -1) && (i - runStart > bestEnd - bestStart)) {
+      bestStart = runStart;
+      bestEnd = i;
+    }
+
+    runStart = -1;
   }
+
+  if (bestEnd - bestStart < SCROLL_MIN_LINES)
+    return false;
+
+  if (!horizontal) {
+    *dest = Rect(r.tl.x, r.tl.y + bestStart, r.br.x, r.tl.y + bestEnd);
+    *delta = Point(0, offset);
+    return true;
+  }
+
+  *dest = Rect(r.tl.x + bestStart, r.tl.y, r.tl.x + bestEnd, r.br.y);
+  *delta = Point(offset, 0);
+
+  // The column hashes are only a hint, so make sure before we lie to
+  // the client
+  return verifyCopy(*dest, *delta);
+}
+
+void ComparingUpdateTracker::hashLines(const PixelBuffer* pb, const Rect& r,
+                                       bool columns,
+                                       std::vector<rdr::U64>* hashes)
+{
+  const rdr::U8* data;
+  int stride, bytesPerPixel;
+
+  bytesPerPixel = pb->getPF().bpp/8;
+
+  data = pb->getBuffer(r, &stride);
+
+  if (!columns) {
+    hashes->resize(r.height());
+    for (int y = 0; y < r.height(); y++) {
+      (*hashes)[y] = hashRect(data, r.width() * bytesPerPixel,
+                              stride * bytesPerPixel, 1);
+      data += stride * bytesPerPixel;
+    }
+    return;
+  }
+
+  // Going down each column would be very cache unfriendly, so build
+  // all the column hashes at once, one row at a time. Only some rows
+  // are included as this is just to find candidates, and any match is
+  // verified properly later.
+  hashes->assign(r.width(), 0);
+  for (int y = 0; y < r.height(); y += SCROLL_COLUMN_SAMPLE) {
+    if (bytesPerPixel == 4) {
+      const rdr::U32* p;
+
+      p = (const rdr::U32*)data;
+      for (int x = 0; x < r.width(); x++)
+        (*hashes)[x] = ((*hashes)[x] ^ p[x]) * 0x100000001b3ULL;
+    } else {
+      const rdr::U8* p;
+
+      p = data;
+      for (int x = 0; x < r.width(); x++) {
+        rdr::U64 hash;
+
+        hash = (*hashes)[x];
+        for (int i = 0; i < bytesPerPixel; i++)
+          hash = (hash ^ *p++) * 0x100000001b3ULL;
+        (*hashes)[x] = hash;
+      }
+    }
+
+    data += stride * bytesPerPixel * SCROLL_COLUMN_SAMPLE;
+  }
+}
+
+bool ComparingUpdateTracker::verifyCopy(const Rect& dest, const Point& delta)
+{
+  const rdr::U8 *oldData, *newData;
+  int oldStride, newStride, bytesPerPixel;
+
+  bytesPerPixel = fb->getPF().bpp/8;
+
+  oldData = oldFb.getBuffer(dest.translate(delta.negate()), &oldStride);
+  newData = fb->getBuffer(dest, &newStride);
+
+  for (int y = 0; y < dest.height(); y++) {
+    if (memcmp(oldData, newData, dest.width() * bytesPerPixel) != 0)
+      return false;
+    oldData += oldStride * bytesPerPixel;
+    newData += newStride * bytesPerPixel;
+  }
+
+  return true;
 }
 
 void ComparingUpdateTracker::logStats()
@@ -190,5 +904,13 @@ void ComparingUpdateTracker::logStats()
   vlog.info("%s in / %s out", a, b);
   vlog.info("(1:%g ratio)", ratio);
 
+  if (scrolls != 0) {
+    siPrefix(scrolls, "scrolls", a, sizeof(a));
+    siPrefix(scrolledPixels, "pixels", b, sizeof(b));
+    vlog.info("%s detected, %s copied", a, b);
+  }
+
   totalPixels = missedPixels = 0;
+  scrolls = 0;
+  scrolledPixels = 0;
 }
@@ -19,6 +19,9 @@
 #ifndef __RFB_COMPARINGUPDATETRACKER_H__
 #define __RFB_COMPARINGUPDATETRACKER_H__
 
+#include <vector>
+
+#include <rdr/types.h>
 #include <rfb/UpdateTracker.h>
 
 namespace rfb {
@@ -41,16 +44,51 @@ namespace rfb {
     virtual void enable();
     virtual void disable();
 
+    // setHashing() makes the tracker remember a hash of each block
+    // instead of keeping a full copy of the framebuffer. This uses far
+    // less memory, at the cost of a tiny risk of missing a change and
+    // of having to send entire blocks when something changes.
+
+    void setHashing(bool hashing);
+
+    // setScrollDetection() makes the tracker look for areas that have
+    // been scrolled by redrawing them rather than by copying, and
+    // report them as copies instead. Has no effect when hashing.
+
+    void setScrollDetection(bool enable);
+
     void logStats();
 
   private:
     void compareRect(const Rect& r, Region* newchanged);
+
+    Rect getBlockRect(int bx, int by);
+    rdr::U64 hashBlock(const Rect& r);
+    void invalidateBlocks(const Rect& r);
+    void compareHashes(Region* newChanged);
+
+    bool detectScroll(Region* unchanged);
+    Rect findChangedArea(const Rect& r);
+    bool findScroll(const Rect& r, bool horizontal,
+                    Rect* dest, Point* delta);
+    void hashLines(const PixelBuffer* pb, const Rect& r, bool columns,
+                   std::vector<rdr::U64>* hashes);
+    bool verifyCopy(const Rect& dest, const Point& delta);
+
     PixelBuffer* fb;
     ManagedPixelBuffer oldFb;
     bool firstCompare;
     bool enabled;
 
+    bool hashing;
+    int blocksWide, blocksHigh;
+    std::vector<rdr::U64> blockHashes;
+
+    bool scrollDetection;
+
     unsigned long long totalPixels, missedPixels;
+    unsigned scrolls;
+    unsigned long long scrolledPixels;
   };
 
 }
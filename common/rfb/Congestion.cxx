@@ -76,7 +76,7 @@ static inline bool isAfter(unsigned a, unsigned b) {
 static LogWriter vlog("Congestion");
 
 Congestion::Congestion() :
-    lastPosition(0), extraBuffer(0),
+    lastPosition(0), lastRTT(0), extraBuffer(0),
     baseRTT(-1), congWindow(INITIAL_WINDOW), inSlowStart(true),
     safeBaseRTT(-1), measurements(0), minRTT(-1), minCongestedRTT(-1)
 {
@@ -173,6 +173,8 @@ void Congestion::gotPong()
   if (rtt < 1)
     rtt = 1;
 
+  lastRTT = rtt;
+
   // Try to estimate wire latency by tracking lowest seen latency
   if (rtt < baseRTT)
     safeBaseRTT = baseRTT = rtt;
@@ -307,6 +309,11 @@ size_t Congestion::getBandwidth()
   return bandwidth;
 }
 
+unsigned Congestion::getRTT()
+{
+  return lastRTT;
+}
+
 void Congestion::debugTrace(const char* filename, int fd)
 {
 #ifdef CONGESTION_TRACE
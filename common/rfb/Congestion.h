@@ -51,6 +51,10 @@ namespace rfb {
     // per second.
     size_t getBandwidth();
 
+    // getRTT() returns the most recently measured round trip time in
+    // milliseconds, or 0 if nothing has been measured yet.
+    unsigned getRTT();
+
     // debugTrace() writes the current congestion window, as well as the
     // congestion window of the underlying TCP layer, to the specified
     // file
@@ -64,6 +68,7 @@ namespace rfb {
 
   private:
     unsigned lastPosition;
+    unsigned lastRTT;
     unsigned extraBuffer;
     struct timeval lastUpdate;
     struct timeval lastSent;
@@ -0,0 +1,240 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <rfb/ContentCache.h>
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+
+using namespace rfb;
+
+ContentCache::ContentCache()
+  : totalPixels(0)
+{
+}
+
+ContentCache::~ContentCache()
+{
+}
+
+bool ContentCache::has(rdr::U32 id) const
+{
+  return entries.find(id) != entries.end();
+}
+
+void ContentCache::insert(rdr::U32 id, int width, int height)
+{
+  Entry entry;
+
+  remove(id);
+
+  entry.pixels = (size_t)width * height;
+
+  // Something this big would just flush everything else
+  if (entry.pixels > contentCacheMaxPixels)
+    return;
+
+  while (totalPixels + entry.pixels > contentCacheMaxPixels) {
+    rdr::U32 oldest;
+
+    oldest = lruList.front();
+    remove(oldest);
+    evicted(oldest);
+  }
+
+  entry.lru = lruList.insert(lruList.end(), id);
+  entries[id] = entry;
+
+  totalPixels += entry.pixels;
+}
+
+bool ContentCache::touch(rdr::U32 id)
+{
+  EntryMap::iterator iter;
+
+  iter = entries.find(id);
+  if (iter == entries.end())
+    return false;
+
+  lruList.splice(lruList.end(), lruList, iter->second.lru);
+
+  return true;
+}
+
+void ContentCache::clear()
+{
+  entries.clear();
+  lruList.clear();
+  totalPixels = 0;
+}
+
+void ContentCache::remove(rdr::U32 id)
+{
+  EntryMap::iterator iter;
+
+  iter = entries.find(id);
+  if (iter == entries.end())
+    return;
+
+  totalPixels -= iter->second.pixels;
+  lruList.erase(iter->second.lru);
+  entries.erase(iter);
+}
+
+bool ServerContentCache::Key::operator<(const Key& other) const
+{
+  if (hash != other.hash)
+    return hash < other.hash;
+  if (width != other.width)
+    return width < other.width;
+  return height < other.height;
+}
+
+ServerContentCache::ServerContentCache()
+  : nextId(0)
+{
+}
+
+ServerContentCache::~ServerContentCache()
+{
+}
+
+bool ServerContentCache::lookup(rdr::U64 hash, int width, int height,
+                                rdr::U32* id, bool* lossy)
+{
+  Key key;
+  IndexMap::const_iterator iter;
+
+  key.hash = hash;
+  key.width = width;
+  key.height = height;
+
+  iter = index.find(key);
+  if (iter == index.end())
+    return false;
+
+  *id = iter->second.id;
+  *lossy = iter->second.lossy;
+
+  return true;
+}
+
+rdr::U32 ServerContentCache::add(rdr::U64 hash, int width, int height,
+                                 bool lossy)
+{
+  Key key;
+  IndexEntry entry;
+
+  key.hash = hash;
+  key.width = width;
+  key.height = height;
+
+  entry.id = nextId++;
+  entry.lossy = lossy;
+
+  // Any older entry with the same content is left to age out, as the
+  // client doesn't know that it has been replaced
+  index[key] = entry;
+  keys[entry.id] = key;
+
+  insert(entry.id, width, height);
+
+  return entry.id;
+}
+
+void ServerContentCache::clear()
+{
+  ContentCache::clear();
+  index.clear();
+  keys.clear();
+}
+
+void ServerContentCache::evicted(rdr::U32 id)
+{
+  KeyMap::iterator iter;
+  IndexMap::iterator iter2;
+
+  iter = keys.find(id);
+  if (iter == keys.end())
+    return;
+
+  iter2 = index.find(iter->second);
+  if ((iter2 != index.end()) && (iter2->second.id == id))
+    index.erase(iter2);
+
+  keys.erase(iter);
+}
+
+ClientContentCache::ClientContentCache()
+{
+}
+
+ClientContentCache::~ClientContentCache()
+{
+}
+
+void ClientContentCache::store(rdr::U32 id, const PixelBuffer* pb,
+                               const Rect& rect)
+{
+  Data* entry;
+
+  insert(id, rect.width(), rect.height());
+  if (!has(id)) {
+    data.erase(id);
+    return;
+  }
+
+  entry = &data[id];
+  entry->pf = pb->getPF();
+  entry->width = rect.width();
+  entry->height = rect.height();
+  entry->pixels.resize(rect.area() * (entry->pf.bpp/8));
+
+  if (!entry->pixels.empty())
+    pb->getImage(&entry->pixels[0], rect);
+}
+
+void ClientContentCache::draw(rdr::U32 id, ModifiablePixelBuffer* pb,
+                              const Rect& rect)
+{
+  DataMap::const_iterator iter;
+
+  iter = data.find(id);
+  if ((iter == data.end()) || !touch(id))
+    throw Exception("Unknown content cache entry %u", (unsigned)id);
+
+  if ((iter->second.width != rect.width()) ||
+      (iter->second.height != rect.height()))
+    throw Exception("Content cache entry %u has the wrong size",
+                    (unsigned)id);
+
+  if (iter->second.pixels.empty())
+    return;
+
+  pb->imageRect(iter->second.pf, rect, &iter->second.pixels[0]);
+}
+
+void ClientContentCache::clear()
+{
+  ContentCache::clear();
+  data.clear();
+}
+
+void ClientContentCache::evicted(rdr::U32 id)
+{
+  data.erase(id);
+}
@@ -0,0 +1,163 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ContentCache - Rects of framebuffer content that the client has
+// been asked to remember, so that the server can have it redraw them
+// later rather than sending the pixels again.
+//
+// The server picks the ids and tells the client when to store and
+// draw entries. Both sides run the same LRU with the same limit, so
+// they always agree on which entries have been evicted without any
+// further communication.
+//
+
+#ifndef __RFB_CONTENTCACHE_H__
+#define __RFB_CONTENTCACHE_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <rdr/types.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/Rect.h>
+
+namespace rfb {
+
+  class PixelBuffer;
+  class ModifiablePixelBuffer;
+
+  // Operations in a pseudoEncodingContentCache rect
+  const int contentCacheStore = 0;
+  const int contentCacheDraw = 1;
+  const int contentCacheReset = 2;
+
+  // Total number of pixels both sides keep around
+  const size_t contentCacheMaxPixels = 4 * 1024 * 1024;
+
+  class ContentCache {
+  public:
+    ContentCache();
+    virtual ~ContentCache();
+
+    bool has(rdr::U32 id) const;
+
+    // insert() adds a new most recently used entry, evicting old
+    // entries as needed to make room for it
+    void insert(rdr::U32 id, int width, int height);
+    // touch() marks an existing entry as the most recently used one
+    bool touch(rdr::U32 id);
+
+    virtual void clear();
+
+    size_t pixels() const { return totalPixels; }
+
+  protected:
+    virtual void evicted(rdr::U32 id) {}
+
+  private:
+    void remove(rdr::U32 id);
+
+    struct Entry {
+      std::list<rdr::U32>::iterator lru;
+      size_t pixels;
+    };
+
+    typedef std::map<rdr::U32, Entry> EntryMap;
+
+    EntryMap entries;
+    std::list<rdr::U32> lruList;
+    size_t totalPixels;
+  };
+
+  class ServerContentCache : public ContentCache {
+  public:
+    ServerContentCache();
+    virtual ~ServerContentCache();
+
+    // lookup() returns true and the id of the entry if identical
+    // content has been stored before. The lossy flag says whether
+    // the client's copy of that content is a lossy approximation.
+    bool lookup(rdr::U64 hash, int width, int height,
+                rdr::U32* id, bool* lossy);
+
+    // add() allocates a new id for the given content and inserts it
+    rdr::U32 add(rdr::U64 hash, int width, int height, bool lossy);
+
+    virtual void clear();
+
+  protected:
+    virtual void evicted(rdr::U32 id);
+
+  private:
+    struct Key {
+      rdr::U64 hash;
+      int width, height;
+
+      bool operator<(const Key& other) const;
+    };
+
+    struct IndexEntry {
+      rdr::U32 id;
+      bool lossy;
+    };
+
+    typedef std::map<Key, IndexEntry> IndexMap;
+    typedef std::map<rdr::U32, Key> KeyMap;
+
+    IndexMap index;
+    KeyMap keys;
+    rdr::U32 nextId;
+  };
+
+  class ClientContentCache : public ContentCache {
+  public:
+    ClientContentCache();
+    virtual ~ClientContentCache();
+
+    // store() copies the given rect of the framebuffer in to a new
+    // entry
+    void store(rdr::U32 id, const PixelBuffer* pb, const Rect& rect);
+    // draw() copies an existing entry back to the framebuffer,
+    // throwing an exception if there is no such entry or if the size
+    // doesn't match
+    void draw(rdr::U32 id, ModifiablePixelBuffer* pb, const Rect& rect);
+
+    virtual void clear();
+
+  protected:
+    virtual void evicted(rdr::U32 id);
+
+  private:
+    struct Data {
+      PixelFormat pf;
+      int width, height;
+      std::vector<rdr::U8> pixels;
+    };
+
+    typedef std::map<rdr::U32, Data> DataMap;
+
+    DataMap data;
+  };
+
+}
+
+#endif
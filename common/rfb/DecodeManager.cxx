@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include <rfb/CConnection.h>
+#include <rfb/Configuration.h>
 #include <rfb/DecodeManager.h>
 #include <rfb/Decoder.h>
 #include <rfb/Region.h>
@@ -35,6 +36,12 @@ using namespace rfb;
 
 static LogWriter vlog("DecodeManager");
 
+static IntParameter decodeThreads("DecodeThreads",
+                                  "The number of threads used to decode "
+                                  "updates (0: automatic, 1: no extra "
+                                  "threads)",
+                                  0, 0, INT_MAX, ConfViewer);
+
 DecodeManager::DecodeManager(CConnection *conn) :
   conn(conn), threadException(NULL)
 {
@@ -46,24 +53,24 @@ DecodeManager::DecodeManager(CConnection *conn) :
   producerCond = new os::Condition(queueMutex);
   consumerCond = new os::Condition(queueMutex);
 
-  cpuCount = os::Thread::getSystemCPUCount();
-  if (cpuCount == 0) {
-    vlog.error("Unable to determine the number of CPU cores on this system");
-    cpuCount = 1;
-  } else {
-    vlog.info("Detected %d CPU core(s)", (int)cpuCount);
-    // No point creating more threads than this, they'll just end up
-    // wasting CPU fighting for locks
-    if (cpuCount > 4)
-      cpuCount = 4;
-    // The overhead of threading is small, but not small enough to
-    // ignore on single CPU systems
-    if (cpuCount == 1)
-      vlog.info("Decoding data on main thread");
-    else
-      vlog.info("Creating %d decoder thread(s)", (int)cpuCount);
+  if (decodeThreads > 0)
+    cpuCount = decodeThreads;
+  else {
+    cpuCount = os::Thread::getSystemCPUCount();
+    if (cpuCount == 0) {
+      vlog.error("Unable to determine the number of CPU cores on this system");
+      cpuCount = 1;
+    } else
+      vlog.info("Detected %d CPU core(s)", (int)cpuCount);
   }
 
+  // The overhead of threading is small, but not small enough to
+  // ignore on single CPU systems
+  if (cpuCount == 1)
+    vlog.info("Decoding data on main thread");
+  else
+    vlog.info("Creating %d decoder thread(s)", (int)cpuCount);
+
   if (cpuCount == 1) {
     // Threads are not used on single CPU machines
     freeBuffers.push_back(new rdr::MemOutStream());
@@ -171,6 +178,8 @@ void DecodeManager::decodeRect(const Rect& r, int encoding,
   decoder->getAffectedRegion(r, bufferStream->data(),
                              bufferStream->length(), conn->server,
                              &entry->affectedRegion);
+  entry->affectedRect = entry->affectedRegion.get_bounding_rect();
+  entry->affectedIsRect = entry->affectedRegion.numRects() <= 1;
 
   queueMutex->lock();
 
@@ -270,6 +279,12 @@ void DecodeManager::DecodeThread::worker()
     // This is ours now
     entry->active = true;
 
+    // Rather than waking every thread whenever something might have
+    // changed, each thread that finds work wakes one more if there
+    // is work left for it
+    if (findEntry() != NULL)
+      manager->consumerCond->signal();
+
     manager->queueMutex->unlock();
 
     // Do the actual decoding
@@ -292,19 +307,31 @@ void DecodeManager::DecodeThread::worker()
 
     // Wake the main thread in case it is waiting for a memory buffer
     manager->producerCond->signal();
-    // This rect might have been blocking multiple other rects, so
-    // wake up every worker thread
-    if (manager->workQueue.size() > 1)
-      manager->consumerCond->broadcast();
   }
 
   manager->queueMutex->unlock();
 }
 
+// conflicts() checks if two entries touch the same pixels. Most
+// affected regions are a single rect, so avoid the cost of a Region
+// intersection when possible.
+
+bool DecodeManager::QueueEntry::conflicts(const QueueEntry* other) const
+{
+  if (!affectedRect.overlaps(other->affectedRect))
+    return false;
+
+  if (affectedIsRect && other->affectedIsRect)
+    return true;
+
+  return !affectedRegion.intersect(other->affectedRegion).is_empty();
+}
+
 DecodeManager::QueueEntry* DecodeManager::DecodeThread::findEntry()
 {
   std::list<DecodeManager::QueueEntry*>::iterator iter;
-  Region lockedRegion;
+  Rect lockedRect;
+  bool seenEncoding[encodingMax+1];
 
   if (manager->workQueue.empty())
     return NULL;
@@ -312,6 +339,8 @@ DecodeManager::QueueEntry* DecodeManager::DecodeThread::findEntry()
   if (!manager->workQueue.front()->active)
     return manager->workQueue.front();
 
+  memset(seenEncoding, 0, sizeof(seenEncoding));
+
   for (iter = manager->workQueue.begin();
        iter != manager->workQueue.end();
        ++iter) {
@@ -328,15 +357,14 @@ DecodeManager::QueueEntry* DecodeManager::DecodeThread::findEntry()
     // If this is an ordered decoder then make sure this is the first
     // rectangle in the queue for that decoder
     if (entry->decoder->flags & DecoderOrdered) {
-      for (iter2 = manager->workQueue.begin(); iter2 != iter; ++iter2) {
-        if (entry->encoding == (*iter2)->encoding)
-          goto next;
-      }
+      if (seenEncoding[entry->encoding])
+        goto next;
     }
 
     // For a partially ordered decoder we must ask the decoder for each
     // pair of rectangles.
-    if (entry->decoder->flags & DecoderPartiallyOrdered) {
+    if ((entry->decoder->flags & DecoderPartiallyOrdered) &&
+        seenEncoding[entry->encoding]) {
       for (iter2 = manager->workQueue.begin(); iter2 != iter; ++iter2) {
         if (entry->encoding != (*iter2)->encoding)
           continue;
@@ -351,14 +379,20 @@ DecodeManager::QueueEntry* DecodeManager::DecodeThread::findEntry()
       }
     }
 
-    // Check overlap with earlier rectangles
-    if (!lockedRegion.intersect(entry->affectedRegion).is_empty())
-      goto next;
+    // Check overlap with earlier rectangles, first against all of them
+    // at once and only then one by one
+    if (entry->affectedRect.overlaps(lockedRect)) {
+      for (iter2 = manager->workQueue.begin(); iter2 != iter; ++iter2) {
+        if (entry->conflicts(*iter2))
+          goto next;
+      }
+    }
 
     return entry;
 
 next:
-    lockedRegion.assign_union(entry->affectedRegion);
+    lockedRect = lockedRect.union_boundary(entry->affectedRect);
+    seenEncoding[entry->encoding] = true;
   }
 
   return NULL;
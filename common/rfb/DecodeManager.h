@@ -52,6 +52,9 @@ namespace rfb {
 
     void flush();
 
+    // isThreaded() returns true if rects can be decoded in parallel
+    bool isThreaded() const { return !threads.empty(); }
+
   private:
     void setThreadException(const rdr::Exception& e);
     void throwThreadException();
@@ -69,6 +72,10 @@ namespace rfb {
       ModifiablePixelBuffer* pb;
       rdr::MemOutStream* bufferStream;
       Region affectedRegion;
+      Rect affectedRect;
+      bool affectedIsRect;
+
+      bool conflicts(const QueueEntry* other) const;
     };
 
     std::list<rdr::MemOutStream*> freeBuffers;
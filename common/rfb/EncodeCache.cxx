@@ -0,0 +1,90 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <rfb/EncodeCache.h>
+
+using namespace rfb;
+
+bool EncodeCache::Key::operator<(const Key& other) const
+{
+  if (rect.tl.y != other.rect.tl.y)
+    return rect.tl.y < other.rect.tl.y;
+  if (rect.tl.x != other.rect.tl.x)
+    return rect.tl.x < other.rect.tl.x;
+  if (rect.br.y != other.rect.br.y)
+    return rect.br.y < other.rect.br.y;
+  if (rect.br.x != other.rect.br.x)
+    return rect.br.x < other.rect.br.x;
+  return config < other.config;
+}
+
+EncodeCache::EncodeCache(size_t maxSize_)
+  : maxSize(maxSize_), totalSize(0)
+{
+}
+
+EncodeCache::~EncodeCache()
+{
+}
+
+bool EncodeCache::lookup(const std::string& config, const Rect& rect,
+                         int* type, const std::vector<rdr::U8>** data)
+{
+  Key key;
+  EntryMap::const_iterator iter;
+
+  key.config = config;
+  key.rect = rect;
+
+  iter = entries.find(key);
+  if (iter == entries.end())
+    return false;
+
+  *type = iter->second.type;
+  *data = &iter->second.data;
+
+  return true;
+}
+
+void EncodeCache::insert(const std::string& config, const Rect& rect,
+                         int type, const rdr::U8* data, size_t length)
+{
+  Key key;
+  Entry* entry;
+
+  if (totalSize + length > maxSize)
+    return;
+
+  key.config = config;
+  key.rect = rect;
+
+  if (entries.count(key) != 0)
+    return;
+
+  entry = &entries[key];
+  entry->type = type;
+  entry->data.assign(data, data + length);
+
+  totalSize += length;
+}
+
+void EncodeCache::clear()
+{
+  entries.clear();
+  totalSize = 0;
+}
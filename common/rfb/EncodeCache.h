@@ -0,0 +1,83 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// EncodeCache - Storage of already encoded rects, so that clients
+// with identical encoding settings can share the work of encoding
+// the same frame. The cache is only valid as long as the framebuffer
+// is unchanged, so the owner must clear it between frames.
+//
+
+#ifndef __RFB_ENCODECACHE_H__
+#define __RFB_ENCODECACHE_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <rdr/types.h>
+#include <rfb/Rect.h>
+
+namespace rfb {
+
+  class EncodeCache {
+  public:
+    EncodeCache(size_t maxSize);
+    ~EncodeCache();
+
+    // The config string must describe everything that can influence
+    // the encoded data apart from the pixels themselves, i.e. the
+    // pixel format, the encoders in use and their settings
+
+    // lookup() returns true and fills in type and data if the rect has
+    // already been encoded using the given configuration
+    bool lookup(const std::string& config, const Rect& rect,
+                int* type, const std::vector<rdr::U8>** data);
+
+    // insert() stores the encoded data for a rect, unless that would
+    // make the cache exceed its maximum size
+    void insert(const std::string& config, const Rect& rect,
+                int type, const rdr::U8* data, size_t length);
+
+    void clear();
+
+    size_t size() const { return totalSize; }
+
+  protected:
+    struct Key {
+      std::string config;
+      Rect rect;
+
+      bool operator<(const Key& other) const;
+    };
+
+    struct Entry {
+      int type;
+      std::vector<rdr::U8> data;
+    };
+
+    typedef std::map<Key, Entry> EntryMap;
+
+    EntryMap entries;
+    size_t maxSize;
+    size_t totalSize;
+  };
+
+}
+
+#endif
@@ -19,16 +19,25 @@
  * USA.
  */
 
+#include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
+#include <rfb/EncodeCache.h>
 #include <rfb/EncodeManager.h>
 #include <rfb/Encoder.h>
 #include <rfb/Palette.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/LogWriter.h>
+#include <rfb/util.h>
 #include <rfb/Exception.h>
+#include <rfb/ServerCore.h>
+
+#include <os/Mutex.h>
 
 #include <rfb/RawEncoder.h>
 #include <rfb/RREEncoder.h>
@@ -52,6 +61,11 @@ static const int SolidSearchBlock = 16;
 // Don't bother with blocks smaller than this
 static const int SolidBlockMinArea = 2048;
 
+// The size in pixels of either side of the tiles that are looked up
+// in, and stored in, the client's content cache. Tiles are aligned to
+// a grid of this size.
+static const int ContentCacheTile = 64;
+
 // How long we consider a region recently changed (in ms)
 static const int RecentChangeTimeout = 50;
 
@@ -80,11 +94,29 @@ enum EncoderType {
 struct RectInfo {
   int rleRuns;
   Palette palette;
+  // Time spent in analyseRect(), if rectTiming is set
+  double analysisTime;
+};
+
+struct EncodeManager::EncodeJob {
+  bool active;
+  bool done;
+  bool cached;
+  Rect rect;
+  const PixelBuffer* pb;
+  int type;
+  // Set if the data was encoded by a worker, otherwise the rect needs
+  // to be encoded in order on the main thread using the info below
+  bool encoded;
+  struct RectInfo info;
+  rdr::MemOutStream* bufferStream;
+  // Time spent on the job so far, in seconds
+  double time;
 };
 
 };
 
-static const char *encoderClassName(EncoderClass klass)
+const char *EncodeManager::encoderClassName(int klass)
 {
   switch (klass) {
   case encoderRaw:
@@ -106,7 +138,7 @@ static const char *encoderClassName(EncoderClass klass)
   return "Unknown Encoder Class";
 }
 
-static const char *encoderTypeName(EncoderType type)
+const char *EncodeManager::encoderTypeName(int type)
 {
   switch (type) {
   case encoderSolid:
@@ -128,10 +160,37 @@ static const char *encoderTypeName(EncoderType type)
   return "Unknown Encoder Type";
 }
 
-EncodeManager::EncodeManager(SConnection* conn_)
-  : conn(conn_), recentChangeTimer(this)
+int EncodeManager::encoderClassCount()
+{
+  return encoderClassMax;
+}
+
+int EncodeManager::encoderTypeCount()
+{
+  return encoderTypeMax;
+}
+
+const EncodeManager::EncoderStats& EncodeManager::getStats(int klass,
+                                                           int type) const
+{
+  assert((klass >= 0) && (klass < encoderClassMax));
+  assert((type >= 0) && (type < encoderTypeMax));
+  return stats[klass][type];
+}
+
+EncodeManager::EncodeManager(SConnection* conn_, UpdateHandler* handler)
+  : conn(conn_), recentChangeTimer(this),
+    qualityOverride(-1), compressOverride(-1), rectTiming(false),
+    analysisTime(0),
+    contentCacheValid(false), sharedFramebufferActive(false),
+    sharedFramebufferFailed(false), sharedFramebufferAttach(false),
+    threadException(NULL),
+    updateHandler(handler), updateThread(NULL),
+    updatePending(false), updateQueued(false), updateDone(false),
+    updateException(NULL), updateWriter(NULL)
 {
   StatsVector::iterator iter;
+  size_t threadCount;
 
   encoders.resize(encoderClassMax, NULL);
   activeEncoders.resize(encoderTypeMax, encoderRaw);
@@ -145,6 +204,9 @@ EncodeManager::EncodeManager(SConnection* conn_)
 
   updates = 0;
   memset(&copyStats, 0, sizeof(copyStats));
+  memset(&sharedStats, 0, sizeof(sharedStats));
+  memset(&cacheDrawStats, 0, sizeof(cacheDrawStats));
+  memset(&cacheStoreStats, 0, sizeof(cacheStoreStats));
   stats.resize(encoderClassMax);
   for (iter = stats.begin();iter != stats.end();++iter) {
     StatsVector::value_type::iterator iter2;
@@ -152,14 +214,87 @@ EncodeManager::EncodeManager(SConnection* conn_)
     for (iter2 = iter->begin();iter2 != iter->end();++iter2)
       memset(&*iter2, 0, sizeof(EncoderStats));
   }
+
+  rectTimes.resize(encoderClassMax);
+  for (size_t i = 0;i < rectTimes.size();i++)
+    rectTimes[i].resize(encoderTypeMax);
+
+  queueMutex = new os::Mutex();
+  producerCond = new os::Condition(queueMutex);
+  consumerCond = new os::Condition(queueMutex);
+
+  if (rfb::Server::encodeThreads > 0)
+    threadCount = rfb::Server::encodeThreads;
+  else {
+    threadCount = os::Thread::getSystemCPUCount();
+    if (threadCount == 0)
+      threadCount = 1;
+    // No point creating more threads than this, they'll just end up
+    // wasting CPU fighting for locks
+    if (threadCount > 4)
+      threadCount = 4;
+  }
+
+  // The main thread also does its share of the work
+  if (threadCount > 1) {
+    vlog.debug("Creating %d encoder thread(s)", (int)threadCount - 1);
+    while (--threadCount)
+      threads.push_back(new EncodeThread(this));
+  }
+
+  updateMutex = new os::Mutex();
+  updateCond = new os::Condition(updateMutex);
+
+  if (updateHandler != NULL) {
+    std::vector<Encoder*>::iterator iter;
+
+    vlog.debug("Creating update thread");
+
+    // Everything the update thread writes goes to a separate stream
+    // so it doesn't get mixed up with what the main thread writes
+    updateWriter = new SMsgWriter(&conn->client, &updateStream);
+
+    updateThread = new UpdateThread(this);
+
+    for (iter = encoders.begin(); iter != encoders.end(); ++iter)
+      resetOutStream(*iter);
+  }
 }
 
 EncodeManager::~EncodeManager()
 {
   std::vector<Encoder*>::iterator iter;
 
+  delete updateThread;
+  delete updateWriter;
+  delete updateException;
+
+  delete updateCond;
+  delete updateMutex;
+
   logStats();
 
+  while (!threads.empty()) {
+    delete threads.back();
+    threads.pop_back();
+  }
+
+  while (!workQueue.empty()) {
+    delete workQueue.front();
+    workQueue.pop_front();
+  }
+
+  delete threadException;
+
+  while (!freeBuffers.empty()) {
+    delete freeBuffers.back();
+    freeBuffers.pop_back();
+  }
+
+  delete consumerCond;
+  delete producerCond;
+  delete queueMutex;
+
   for (iter = encoders.begin();iter != encoders.end();iter++)
     delete *iter;
 }
@@ -199,6 +334,55 @@ void EncodeManager::logStats()
               a, ratio);
   }
 
+  if (sharedStats.rects != 0) {
+    vlog.info("  %s:", "Shared framebuffer");
+
+    rects += sharedStats.rects;
+    pixels += sharedStats.pixels;
+    bytes += sharedStats.bytes;
+    equivalent += sharedStats.equivalent;
+
+    ratio = (double)sharedStats.equivalent / sharedStats.bytes;
+
+    siPrefix(sharedStats.rects, "rects", a, sizeof(a));
+    siPrefix(sharedStats.pixels, "pixels", b, sizeof(b));
+    vlog.info("    %s: %s, %s", "Updates", a, b);
+    iecPrefix(sharedStats.bytes, "B", a, sizeof(a));
+    vlog.info("    %*s  %s (1:%g ratio)",
+              (int)strlen("Updates"), "",
+              a, ratio);
+  }
+
+  if ((cacheDrawStats.rects != 0) || (cacheStoreStats.rects != 0)) {
+    vlog.info("  %s:", "Content cache");
+
+    rects += cacheDrawStats.rects;
+    pixels += cacheDrawStats.pixels;
+    bytes += cacheDrawStats.bytes;
+    equivalent += cacheDrawStats.equivalent;
+
+    ratio = (double)cacheDrawStats.equivalent / cacheDrawStats.bytes;
+
+    siPrefix(cacheDrawStats.rects, "rects", a, sizeof(a));
+    siPrefix(cacheDrawStats.pixels, "pixels", b, sizeof(b));
+    vlog.info("    %s: %s, %s", "Draws", a, b);
+    iecPrefix(cacheDrawStats.bytes, "B", a, sizeof(a));
+    vlog.info("    %*s  %s (1:%g ratio)",
+              (int)strlen("Draws"), "",
+              a, ratio);
+
+    // Stores don't send any pixels, so they are just overhead
+    bytes += cacheStoreStats.bytes;
+
+    siPrefix(cacheStoreStats.rects, "rects", a, sizeof(a));
+    siPrefix(cacheStoreStats.pixels, "pixels", b, sizeof(b));
+    vlog.info("    %s: %s, %s", "Stores", a, b);
+    iecPrefix(cacheStoreStats.bytes, "B", a, sizeof(a));
+    vlog.info("    %*s  %s",
+              (int)strlen("Stores"), "",
+              a);
+  }
+
   for (i = 0;i < stats.size();i++) {
     // Did this class do anything at all?
     for (j = 0;j < stats[i].size();j++) {
@@ -278,9 +462,21 @@ void EncodeManager::pruneLosslessRefresh(const Region& limits)
 }
 
 void EncodeManager::writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
-                                const RenderedCursor* renderedCursor)
+                                const RenderedCursor* renderedCursor,
+                                EncodeCache* cache)
 {
-  doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb, renderedCursor);
+  // Copying to the shared framebuffer is cheap enough that it isn't
+  // worth handing over to the update thread. The cache is shared
+  // between connections, so it can't be used from there either.
+  if (prepareSharedFramebuffer(pb))
+    doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb,
+             renderedCursor, NULL);
+  else if (updateThread != NULL)
+    startUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb,
+                renderedCursor);
+  else
+    doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb,
+             renderedCursor, cache);
 
   recentlyChangedRegion.assign_union(ui.changed);
   recentlyChangedRegion.assign_union(ui.copied);
@@ -292,16 +488,82 @@ void EncodeManager::writeLosslessRefresh(const Region& req, const PixelBuffer* p
                                          const RenderedCursor* renderedCursor,
                                          size_t maxUpdateSize)
 {
-  doUpdate(false, getLosslessRefresh(req, maxUpdateSize),
-           Region(), Point(), pb, renderedCursor);
+  if (prepareSharedFramebuffer(pb))
+    doUpdate(false, getLosslessRefresh(req, maxUpdateSize),
+             Region(), Point(), pb, renderedCursor, NULL);
+  else if (updateThread != NULL)
+    startUpdate(false, getLosslessRefresh(req, maxUpdateSize),
+                Region(), Point(), pb, renderedCursor);
+  else
+    doUpdate(false, getLosslessRefresh(req, maxUpdateSize),
+             Region(), Point(), pb, renderedCursor, NULL);
+}
+
+bool EncodeManager::isUpdateReady()
+{
+  os::AutoMutex a(updateMutex);
+
+  return updatePending && updateDone;
+}
+
+void EncodeManager::finishUpdate()
+{
+  assert(updatePending);
+
+  updateMutex->lock();
+  while (!updateDone)
+    updateCond->wait();
+  updateMutex->unlock();
+
+  updatePending = false;
+  updateDone = false;
+
+  if (updateException != NULL) {
+    rdr::Exception e(*updateException);
+
+    delete updateException;
+    updateException = NULL;
+
+    throw e;
+  }
+
+  conn->writer()->writeFramebufferUpdateStart(updateRects);
+  conn->writer()->writeEncodedRects(updateRects, updateStream.data(),
+                                    updateStream.length());
+  conn->writer()->writeFramebufferUpdateEnd();
+}
+
+void EncodeManager::cancelUpdate()
+{
+  if (!updatePending)
+    return;
+
+  updateMutex->lock();
+  while (!updateDone)
+    updateCond->wait();
+  updateMutex->unlock();
+
+  updatePending = false;
+  updateDone = false;
+
+  delete updateException;
+  updateException = NULL;
 }
 
 bool EncodeManager::handleTimeout(Timer* t)
 {
   if (t == &recentChangeTimer) {
+    // The update thread might be busy with the lossy tracking, so try
+    // again later
+    if (updatePending)
+      return true;
+
     // Any lossy region that wasn't recently updated can
     // now be scheduled for a refresh
-    pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion));
+    // Video will most likely change again soon, so don't waste any
+    // bandwidth on it
+    pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion)
+                                                 .subtract(videoRegion));
     recentlyChangedRegion.clear();
 
     // Will there be more to do? (i.e. do we need another round)
@@ -315,27 +577,55 @@ bool EncodeManager::handleTimeout(Timer* t)
 void EncodeManager::doUpdate(bool allowLossy, const Region& changed_,
                              const Region& copied, const Point& copyDelta,
                              const PixelBuffer* pb,
-                             const RenderedCursor* renderedCursor)
+                             const RenderedCursor* renderedCursor,
+                             EncodeCache* cache)
 {
     int nRects;
     Region changed, cursorRegion;
 
+    nRects = prepareUpdate(allowLossy, changed_, copied, pb,
+                           renderedCursor, cache, &changed, &cursorRegion);
+
+    conn->writer()->writeFramebufferUpdateStart(nRects);
+
+    writeUpdateRects(allowLossy, changed, cursorRegion, copied, copyDelta,
+                     pb, renderedCursor, cache);
+
+    conn->writer()->writeFramebufferUpdateEnd();
+}
+
+int EncodeManager::prepareUpdate(bool allowLossy, const Region& changed_,
+                                 const Region& copied,
+                                 const PixelBuffer* pb,
+                                 const RenderedCursor* renderedCursor,
+                                 EncodeCache* cache,
+                                 Region* changed, Region* cursorRegion)
+{
+    int nRects;
+
     updates++;
 
     prepareEncoders(allowLossy);
 
-    changed = changed_;
+    if (cache != NULL)
+      prepareCacheConfig(pb);
 
-    if (!conn->client.supportsEncoding(encodingCopyRect))
-      changed.assign_union(copied);
+    *changed = changed_;
+
+    // Copies are done on the client's framebuffer, which might have
+    // newer content than we think if it comes from the shared one
+    if (!conn->client.supportsEncoding(encodingCopyRect) ||
+        sharedFramebufferActive)
+      changed->assign_union(copied);
 
     /*
      * We need to render the cursor seperately as it has its own
      * magical pixel buffer, so split it out from the changed region.
      */
+    cursorRegion->clear();
     if (renderedCursor != NULL) {
-      cursorRegion = changed.intersect(renderedCursor->getEffectiveRect());
-      changed.assign_subtract(renderedCursor->getEffectiveRect());
+      *cursorRegion = changed->intersect(renderedCursor->getEffectiveRect());
+      changed->assign_subtract(renderedCursor->getEffectiveRect());
     }
 
     if (conn->client.supportsEncoding(pseudoEncodingLastRect))
@@ -344,11 +634,50 @@ void EncodeManager::doUpdate(bool allowLossy, const Region& changed_,
       nRects = 0;
       if (conn->client.supportsEncoding(encodingCopyRect))
         nRects += copied.numRects();
-      nRects += computeNumRects(changed);
-      nRects += computeNumRects(cursorRegion);
+      nRects += computeNumRects(*changed);
+      nRects += computeNumRects(*cursorRegion);
     }
 
-    conn->writer()->writeFramebufferUpdateStart(nRects);
+    return nRects;
+}
+
+void EncodeManager::writeUpdateRects(bool allowLossy, const Region& changed_,
+                                     const Region& cursorRegion,
+                                     const Region& copied,
+                                     const Point& copyDelta,
+                                     const PixelBuffer* pb,
+                                     const RenderedCursor* renderedCursor,
+                                     EncodeCache* cache)
+{
+    Region changed;
+    bool useContentCache;
+
+    changed = changed_;
+
+    // This never runs on the update thread, so it writes straight to
+    // the connection
+    if (sharedFramebufferActive) {
+      if (sharedFramebufferAttach) {
+        const SharedFramebuffer* shared = &sharedFramebuffer;
+        conn->writer()->writeSharedFramebufferAttach(shared->width(),
+                                                     shared->height(),
+                                                     shared->getPF(),
+                                                     shared->getStride());
+        sharedFramebufferAttach = false;
+      }
+
+      writeSharedRects(changed, pb);
+      writeSharedRects(cursorRegion, renderedCursor);
+      return;
+    }
+
+    // The client's copies of the cached content are in the pixel
+    // format it had when they were stored, so start over if that
+    // changes
+    useContentCache = conn->client.supportsContentCache();
+    if (useContentCache &&
+        (!contentCacheValid || !contentCachePF.equal(conn->client.pf())))
+      writeContentCacheReset();
 
     if (conn->client.supportsEncoding(encodingCopyRect))
       writeCopyRects(copied, copyDelta);
@@ -360,10 +689,120 @@ void EncodeManager::doUpdate(bool allowLossy, const Region& changed_,
     if (conn->client.supportsEncoding(pseudoEncodingLastRect))
       writeSolidRects(&changed, pb);
 
-    writeRects(changed, pb);
-    writeRects(cursorRegion, renderedCursor);
+    /*
+     * Then anything the client already has a copy of, leaving the
+     * remaining tiles to be stored once they've been sent.
+     */
+    if (useContentCache)
+      writeContentCacheDraws(&changed, pb, allowLossy);
+
+    // The rendered cursor is specific to each connection, so only
+    // the framebuffer is shared with other connections
+    if (allowLossy && !videoRegion.is_empty()) {
+      writeRects(changed.subtract(videoRegion), pb, cache);
+      writeVideoRects(changed.intersect(videoRegion), pb, cache);
+    } else {
+      writeRects(changed, pb, cache);
+    }
+    writeRects(cursorRegion, renderedCursor, NULL);
 
-    conn->writer()->writeFramebufferUpdateEnd();
+    if (useContentCache)
+      writeContentCacheStores();
+}
+
+void EncodeManager::startUpdate(bool allowLossy, const Region& changed,
+                                const Region& copied, const Point& copyDelta,
+                                const PixelBuffer* pb,
+                                const RenderedCursor* renderedCursor)
+{
+  Region needed, cursorRegion;
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+
+  assert(!updatePending);
+
+  // Take a copy of everything the update thread needs, so the
+  // framebuffer can keep changing whilst it works
+  if ((updateBuffer.width() != pb->width()) ||
+      (updateBuffer.height() != pb->height()) ||
+      !updateBuffer.getPF().equal(pb->getPF())) {
+    updateBuffer.setPF(pb->getPF());
+    updateBuffer.setSize(pb->width(), pb->height());
+  }
+
+  needed = changed;
+  if (!conn->client.supportsEncoding(encodingCopyRect))
+    needed.assign_union(copied);
+
+  needed.get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    const rdr::U8* data;
+    int stride;
+
+    data = pb->getBuffer(*rect, &stride);
+    updateBuffer.imageRect(*rect, data, stride);
+  }
+
+  // The cursor can be drawn straight in to our copy
+  if (renderedCursor != NULL) {
+    cursorRegion = needed.intersect(renderedCursor->getEffectiveRect());
+
+    rects.clear();
+    cursorRegion.get_rects(&rects);
+    for (rect = rects.begin(); rect != rects.end(); ++rect) {
+      const rdr::U8* data;
+      int stride;
+
+      data = renderedCursor->getBuffer(*rect, &stride);
+      updateBuffer.imageRect(*rect, data, stride);
+    }
+  }
+
+  updateRects = prepareUpdate(allowLossy, changed, copied, &updateBuffer,
+                              NULL, NULL, &updateChanged, &cursorRegion);
+
+  updateAllowLossy = allowLossy;
+  updateCopied = copied;
+  updateCopyDelta = copyDelta;
+
+  updatePending = true;
+
+  os::AutoMutex a(updateMutex);
+  updateQueued = true;
+  updateCond->broadcast();
+}
+
+void EncodeManager::encodeUpdate()
+{
+  updateStream.clear();
+
+  writeUpdateRects(updateAllowLossy, updateChanged, Region(),
+                   updateCopied, updateCopyDelta, &updateBuffer,
+                   NULL, NULL);
+}
+
+SMsgWriter* EncodeManager::writer()
+{
+  if (updateWriter != NULL)
+    return updateWriter;
+
+  return conn->writer();
+}
+
+rdr::OutStream* EncodeManager::getOutStream()
+{
+  if (updateThread != NULL)
+    return &updateStream;
+
+  return conn->getOutStream();
+}
+
+void EncodeManager::resetOutStream(Encoder* encoder)
+{
+  if (updateThread != NULL)
+    encoder->setOutStream(&updateStream);
+  else
+    encoder->setOutStream(NULL);
 }
 
 void EncodeManager::prepareEncoders(bool allowLossy)
@@ -454,7 +893,7 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   }
 
   // JPEG is the only encoder that can reduce things to grayscale
-  if ((conn->client.subsampling == subsampleGray) &&
+  if ((getSubsampling() == subsampleGray) &&
       encoders[encoderTightJPEG]->isSupported() && allowLossy) {
     solid = bitmap = bitmapRLE = encoderTightJPEG;
     indexed = indexedRLE = fullColour = encoderTightJPEG;
@@ -468,25 +907,121 @@ void EncodeManager::prepareEncoders(bool allowLossy)
   activeEncoders[encoderFullColour] = fullColour;
 
   for (iter = activeEncoders.begin(); iter != activeEncoders.end(); ++iter) {
-    Encoder *encoder;
-
-    encoder = encoders[*iter];
+    std::list<EncodeThread*>::iterator thread;
 
-    encoder->setCompressLevel(conn->client.compressLevel);
+    configureEncoder(encoders[*iter], allowLossy);
 
-    if (allowLossy) {
-      encoder->setQualityLevel(conn->client.qualityLevel);
-      encoder->setFineQualityLevel(conn->client.fineQualityLevel,
-                                   conn->client.subsampling);
-    } else {
-      int level = __rfbmax(conn->client.qualityLevel,
-                           encoder->losslessQuality);
-      encoder->setQualityLevel(level);
-      encoder->setFineQualityLevel(-1, subsampleUndefined);
+    // The worker threads are idle between updates, so it is safe to
+    // touch their encoders here
+    for (thread = threads.begin(); thread != threads.end(); ++thread) {
+      if ((*thread)->encoders[*iter] != NULL)
+        configureEncoder((*thread)->encoders[*iter], allowLossy);
     }
   }
 }
 
+void EncodeManager::configureEncoder(Encoder* encoder, bool allowLossy)
+{
+  encoder->setCompressLevel(getCompressLevel());
+
+  if (allowLossy) {
+    encoder->setQualityLevel(getQualityLevel());
+    encoder->setFineQualityLevel(getFineQualityLevel(), getSubsampling());
+  } else {
+    int level = __rfbmax(getQualityLevel(),
+                         encoder->losslessQuality);
+    encoder->setQualityLevel(level);
+    encoder->setFineQualityLevel(-1, subsampleUndefined);
+  }
+}
+
+void EncodeManager::prepareCacheConfig(const PixelBuffer* pb)
+{
+  char buffer[256];
+  std::vector<int>::const_iterator iter;
+
+  // Everything that can affect the choice of encoder and the encoded
+  // data, apart from the pixels themselves
+  conn->client.pf().print(buffer, sizeof(buffer));
+  cacheConfig = buffer;
+  pb->getPF().print(buffer, sizeof(buffer));
+  cacheConfig += buffer;
+
+  snprintf(buffer, sizeof(buffer), "|%d|%d|%d|%d",
+           getCompressLevel(), getQualityLevel(),
+           getFineQualityLevel(), getSubsampling());
+  cacheConfig += buffer;
+
+  for (iter = activeEncoders.begin(); iter != activeEncoders.end(); ++iter) {
+    snprintf(buffer, sizeof(buffer), "|%d", *iter);
+    cacheConfig += buffer;
+  }
+}
+
+bool EncodeManager::prepareSharedFramebuffer(const PixelBuffer* pb)
+{
+  if (!conn->client.supportsSharedFramebuffer() || sharedFramebufferFailed) {
+    sharedFramebuffer.release();
+    sharedFramebufferActive = false;
+    return false;
+  }
+
+  // A new one is needed whenever what the client expects changes
+  if (sharedFramebuffer.isValid() &&
+      (sharedFramebuffer.width() == pb->width()) &&
+      (sharedFramebuffer.height() == pb->height()) &&
+      sharedFramebuffer.getPF().equal(conn->client.pf()))
+    return true;
+
+  try {
+    sharedFramebuffer.create(conn->client.pf(), pb->width(), pb->height());
+    if (!conn->sendFd(sharedFramebuffer.getFd()))
+      throw Exception("Connection cannot pass file descriptors");
+  } catch (rdr::Exception& e) {
+    vlog.error("Unable to share framebuffer with client: %s", e.str());
+    sharedFramebuffer.release();
+    sharedFramebufferActive = false;
+    sharedFramebufferFailed = true;
+    return false;
+  }
+
+  if (!sharedFramebufferActive)
+    vlog.info("Using shared framebuffer");
+
+  sharedFramebufferActive = true;
+  sharedFramebufferAttach = true;
+
+  return true;
+}
+
+int EncodeManager::getQualityLevel() const
+{
+  if (qualityOverride != -1)
+    return qualityOverride;
+  return conn->client.qualityLevel;
+}
+
+int EncodeManager::getFineQualityLevel() const
+{
+  if (qualityOverride != -1)
+    return -1;
+  return conn->client.fineQualityLevel;
+}
+
+int EncodeManager::getSubsampling() const
+{
+  if (qualityOverride != -1)
+    return subsampleUndefined;
+  return conn->client.subsampling;
+}
+
+int EncodeManager::getCompressLevel() const
+{
+  if (compressOverride != -1)
+    return compressOverride;
+  return conn->client.compressLevel;
+}
+
 Region EncodeManager::getLosslessRefresh(const Region& req,
                                          size_t maxUpdateSize)
 {
@@ -578,7 +1113,7 @@ Encoder *EncodeManager::startRect(const Rect& rect, int type)
   activeType = type;
   klass = activeEncoders[activeType];
 
-  beforeLength = conn->getOutStream()->length();
+  beforeLength = getOutStream()->length();
 
   stats[klass][activeType].rects++;
   stats[klass][activeType].pixels += rect.area();
@@ -586,7 +1121,7 @@ Encoder *EncodeManager::startRect(const Rect& rect, int type)
   stats[klass][activeType].equivalent += equiv;
 
   encoder = encoders[klass];
-  conn->writer()->startRect(rect, encoder->encoding);
+  writer()->startRect(rect, encoder->encoding);
 
   if ((encoder->flags & EncoderLossy) &&
       ((encoder->losslessQuality == -1) ||
@@ -606,13 +1141,29 @@ void EncodeManager::endRect()
 {
   int klass;
   int length;
+  double elapsed;
 
-  conn->writer()->endRect();
+  writer()->endRect();
 
-  length = conn->getOutStream()->length() - beforeLength;
+  length = getOutStream()->length() - beforeLength;
 
   klass = activeEncoders[activeType];
   stats[klass][activeType].bytes += length;
+
+  elapsed = getTime() - rectStart;
+  stats[klass][activeType].time += elapsed;
+
+  if (rectTiming)
+    rectTimes[klass][activeType].push_back(elapsed);
+}
+
+double EncodeManager::getTime()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
 }
 
 void EncodeManager::writeCopyRects(const Region& copied, const Point& delta)
@@ -622,7 +1173,7 @@ void EncodeManager::writeCopyRects(const Region& copied, const Point& delta)
 
   Region lossyCopy;
 
-  beforeLength = conn->getOutStream()->length();
+  beforeLength = getOutStream()->length();
 
   copied.get_rects(&rects, delta.x <= 0, delta.y <= 0);
   for (rect = rects.begin(); rect != rects.end(); ++rect) {
@@ -633,11 +1184,11 @@ void EncodeManager::writeCopyRects(const Region& copied, const Point& delta)
     equiv = 12 + rect->area() * (conn->client.pf().bpp/8);
     copyStats.equivalent += equiv;
 
-    conn->writer()->writeCopyRect(*rect, rect->tl.x - delta.x,
+    writer()->writeCopyRect(*rect, rect->tl.x - delta.x,
                                    rect->tl.y - delta.y);
   }
 
-  copyStats.bytes += conn->getOutStream()->length() - beforeLength;
+  copyStats.bytes += getOutStream()->length() - beforeLength;
 
   lossyCopy = lossyRegion;
   lossyCopy.translate(delta);
@@ -649,6 +1200,154 @@ void EncodeManager::writeCopyRects(const Region& copied, const Point& delta)
   pendingRefreshRegion.assign_subtract(copied);
 }
 
+void EncodeManager::writeContentCacheReset()
+{
+  contentCache.clear();
+  contentCachePF = conn->client.pf();
+  contentCacheValid = true;
+
+  writer()->writeContentCacheRect(Rect(), contentCacheReset, 0);
+}
+
+void EncodeManager::writeContentCacheDraws(Region *changed,
+                                           const PixelBuffer* pb,
+                                           bool allowLossy)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+
+  Region drawn;
+
+  int bpp;
+
+  pendingStores.clear();
+
+  bpp = pb->getPF().bpp/8;
+
+  beforeLength = getOutStream()->length();
+
+  changed->get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    Rect tile;
+
+    // Only tiles that are entirely within the changed area
+    tile.tl.y = (rect->tl.y + ContentCacheTile - 1) /
+                ContentCacheTile * ContentCacheTile;
+    for (; tile.tl.y + ContentCacheTile <= rect->br.y;
+         tile.tl.y += ContentCacheTile) {
+      tile.br.y = tile.tl.y + ContentCacheTile;
+
+      tile.tl.x = (rect->tl.x + ContentCacheTile - 1) /
+                  ContentCacheTile * ContentCacheTile;
+      for (; tile.tl.x + ContentCacheTile <= rect->br.x;
+           tile.tl.x += ContentCacheTile) {
+        const rdr::U8* buffer;
+        int stride;
+        PendingStore pending;
+        rdr::U32 id;
+        bool lossy;
+        int equiv;
+
+        tile.br.x = tile.tl.x + ContentCacheTile;
+
+        buffer = pb->getBuffer(tile, &stride);
+
+        pending.rect = tile;
+        pending.hash = hashRect(buffer, tile.width() * bpp,
+                                stride * bpp, tile.height());
+
+        if (!contentCache.lookup(pending.hash, tile.width(), tile.height(),
+                                 &id, &lossy) ||
+            (lossy && !allowLossy)) {
+          pendingStores.push_back(pending);
+          continue;
+        }
+
+        contentCache.touch(id);
+
+        cacheDrawStats.rects++;
+        cacheDrawStats.pixels += tile.area();
+        equiv = 12 + tile.area() * (conn->client.pf().bpp/8);
+        cacheDrawStats.equivalent += equiv;
+
+        writer()->writeContentCacheRect(tile, contentCacheDraw, id);
+
+        if (lossy)
+          lossyRegion.assign_union(Region(tile));
+        else
+          lossyRegion.assign_subtract(Region(tile));
+
+        pendingRefreshRegion.assign_subtract(Region(tile));
+
+        drawn.assign_union(Region(tile));
+      }
+    }
+  }
+
+  cacheDrawStats.bytes += getOutStream()->length() - beforeLength;
+
+  changed->assign_subtract(drawn);
+}
+
+void EncodeManager::writeContentCacheStores()
+{
+  std::vector<PendingStore>::const_iterator tile;
+
+  beforeLength = getOutStream()->length();
+
+  for (tile = pendingStores.begin(); tile != pendingStores.end(); ++tile) {
+    bool lossy;
+    rdr::U32 id;
+
+    // The client will get whatever it ended up with after decoding,
+    // so remember if that isn't an exact copy
+    lossy = !lossyRegion.intersect(Region(tile->rect)).is_empty();
+
+    id = contentCache.add(tile->hash, tile->rect.width(),
+                          tile->rect.height(), lossy);
+
+    cacheStoreStats.rects++;
+    cacheStoreStats.pixels += tile->rect.area();
+
+    writer()->writeContentCacheRect(tile->rect, contentCacheStore, id);
+  }
+
+  cacheStoreStats.bytes += getOutStream()->length() - beforeLength;
+
+  pendingStores.clear();
+}
+
+void EncodeManager::writeSharedRects(const Region& changed,
+                                     const PixelBuffer* pb)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+
+  beforeLength = conn->getOutStream()->length();
+
+  changed.get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    rdr::U8* buffer;
+    int stride;
+
+    buffer = sharedFramebuffer.getBufferRW(*rect, &stride);
+    pb->getImage(sharedFramebuffer.getPF(), buffer, *rect, stride);
+
+    conn->writer()->writeSharedFramebufferRect(*rect);
+
+    sharedStats.rects++;
+    sharedStats.pixels += rect->area();
+    sharedStats.equivalent += 12 + rect->area() *
+                              (conn->client.pf().bpp/8);
+  }
+
+  sharedStats.bytes += conn->getOutStream()->length() - beforeLength;
+
+  // Everything is sent losslessly
+  lossyRegion.assign_subtract(changed);
+  pendingRefreshRegion.assign_subtract(changed);
+}
+
 void EncodeManager::writeSolidRects(Region *changed, const PixelBuffer* pb)
 {
   std::vector<Rect> rects;
@@ -709,6 +1408,7 @@ void EncodeManager::findSolidRect(const Rect& rect, Region *changed,
         }
 
         // Send solid-color rectangle.
+        rectStart = getTime();
         encoder = startRect(erp, encoderSolid);
         if (encoder->flags & EncoderUseNativePF) {
           encoder->writeSolidRect(erp.width(), erp.height(),
@@ -756,7 +1456,94 @@ void EncodeManager::findSolidRect(const Rect& rect, Region *changed,
   }
 }
 
-void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb)
+void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb,
+                               EncodeCache* cache)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+
+  splitRects(changed, &rects);
+
+  if (!threads.empty() && (rects.size() > 1)) {
+    writeRectsThreaded(rects, pb, cache);
+    return;
+  }
+
+  for (rect = rects.begin(); rect != rects.end(); ++rect)
+    writeSubRect(*rect, pb, cache);
+}
+
+void EncodeManager::writeVideoRects(const Region& changed,
+                                    const PixelBuffer* pb,
+                                    EncodeCache* cache)
+{
+  std::string savedConfig;
+  int quality;
+
+  if (changed.is_empty())
+    return;
+
+  // Only JPEG has a quality that can be lowered
+  if (activeEncoders[encoderFullColour] != encoderTightJPEG) {
+    writeRects(changed, pb, cache);
+    return;
+  }
+
+  // Nothing to do if the client already asked for something lower
+  quality = TightJPEGEncoder::getJPEGQuality(getQualityLevel(),
+                                             getFineQualityLevel());
+  if ((quality != -1) &&
+      (quality <= TightJPEGEncoder::getJPEGQuality(rfb::Server::videoQuality,
+                                                   -1))) {
+    writeRects(changed, pb, cache);
+    return;
+  }
+
+  // Other connections must not get these rects unless they are also
+  // sending the area as video
+  savedConfig = cacheConfig;
+  cacheConfig += "|video";
+
+  configureVideoEncoder(true);
+  try {
+    writeRects(changed, pb, cache);
+  } catch (...) {
+    configureVideoEncoder(false);
+    cacheConfig = savedConfig;
+    throw;
+  }
+  configureVideoEncoder(false);
+
+  cacheConfig = savedConfig;
+}
+
+void EncodeManager::configureVideoEncoder(bool video)
+{
+  std::vector<Encoder*> jpegEncoders;
+  std::vector<Encoder*>::iterator iter;
+  std::list<EncodeThread*>::iterator thread;
+
+  jpegEncoders.push_back(encoders[encoderTightJPEG]);
+
+  // The worker threads are idle between calls to writeRects(), so it
+  // is safe to touch their encoders here
+  for (thread = threads.begin(); thread != threads.end(); ++thread) {
+    if ((*thread)->encoders[encoderTightJPEG] != NULL)
+      jpegEncoders.push_back((*thread)->encoders[encoderTightJPEG]);
+  }
+
+  for (iter = jpegEncoders.begin(); iter != jpegEncoders.end(); ++iter) {
+    if (video) {
+      (*iter)->setQualityLevel(rfb::Server::videoQuality);
+      (*iter)->setFineQualityLevel(-1, getSubsampling());
+    } else {
+      configureEncoder(*iter, true);
+    }
+  }
+}
+
+void EncodeManager::splitRects(const Region& changed,
+                               std::vector<Rect>* subRects)
 {
   std::vector<Rect> rects;
   std::vector<Rect>::const_iterator rect;
@@ -771,7 +1558,7 @@ void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb)
 
     // No split necessary?
     if (((w*h) < SubRectMaxArea) && (w < SubRectMaxWidth)) {
-      writeSubRect(*rect, pb);
+      subRects->push_back(*rect);
       continue;
     }
 
@@ -792,33 +1579,331 @@ void EncodeManager::writeRects(const Region& changed, const PixelBuffer* pb)
         if (sr.br.x > rect->br.x)
           sr.br.x = rect->br.x;
 
-        writeSubRect(sr, pb);
+        subRects->push_back(sr);
       }
     }
   }
 }
 
-void EncodeManager::writeSubRect(const Rect& rect, const PixelBuffer *pb)
+void EncodeManager::writeRectsThreaded(const std::vector<Rect>& rects,
+                                       const PixelBuffer* pb,
+                                       EncodeCache* cache)
+{
+  std::vector<Rect>::const_iterator rect;
+
+  // Queue everything up front so the worker threads can start
+  // encoding whilst we are busy writing out earlier rects
+
+  queueMutex->lock();
+
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    EncodeJob* job;
+    const std::vector<rdr::U8>* data;
+
+    job = new EncodeJob;
+
+    job->active = false;
+    job->done = false;
+    job->cached = false;
+    job->rect = *rect;
+    job->pb = pb;
+    job->encoded = false;
+    job->time = 0.0;
+
+    if (freeBuffers.empty())
+      freeBuffers.push_back(new rdr::MemOutStream());
+    job->bufferStream = freeBuffers.front();
+    freeBuffers.pop_front();
+
+    // Nothing to do if another connection already encoded this
+    if ((cache != NULL) &&
+        cache->lookup(cacheConfig, job->rect, &job->type, &data)) {
+      job->active = true;
+      job->done = true;
+      job->cached = true;
+    }
+
+    workQueue.push_back(job);
+  }
+
+  consumerCond->broadcast();
+
+  // Then write them out in order, helping out with the encoding if
+  // we get ahead of the worker threads
+
+  while (!workQueue.empty()) {
+    EncodeJob* job;
+    bool failed;
+
+    job = workQueue.front();
+
+    if (!job->active) {
+      job->active = true;
+      queueMutex->unlock();
+
+      try {
+        encodeJob(job, encoders, &offsetPixelBuffer, &convertedPixelBuffer);
+      } catch (rdr::Exception& e) {
+        setThreadException(e);
+      }
+
+      queueMutex->lock();
+      job->done = true;
+    }
+
+    while (!job->done)
+      producerCond->wait();
+
+    workQueue.pop_front();
+
+    failed = threadException != NULL;
+
+    queueMutex->unlock();
+
+    try {
+      if (!failed)
+        writeJob(job, cache);
+    } catch (...) {
+      freeBuffers.push_back(job->bufferStream);
+      delete job;
+      abortJobs();
+      throw;
+    }
+
+    freeBuffers.push_back(job->bufferStream);
+    delete job;
+
+    queueMutex->lock();
+  }
+
+  queueMutex->unlock();
+
+  throwThreadException();
+}
+
+void EncodeManager::encodeJob(EncodeJob* job,
+                              const std::vector<Encoder*>& jobEncoders,
+                              OffsetPixelBuffer* offsetBuffer,
+                              ManagedPixelBuffer* convertedBuffer)
+{
+  PixelBuffer *ppb;
+  Encoder *encoder;
+  double start;
+
+  start = getTime();
+
+  ppb = preparePixelBuffer(job->rect, job->pb, true,
+                           offsetBuffer, convertedBuffer);
+
+  job->type = chooseType(job->rect, ppb, &job->info);
+
+  // Stateful encoders have to be run in order by the main thread
+  encoder = jobEncoders[activeEncoders[job->type]];
+  if ((encoder == NULL) || !(encoder->flags & EncoderStateless)) {
+    job->time = getTime() - start;
+    return;
+  }
+
+  if (encoder->flags & EncoderUseNativePF)
+    ppb = preparePixelBuffer(job->rect, job->pb, false,
+                             offsetBuffer, convertedBuffer);
+
+  job->bufferStream->clear();
+
+  encoder->setOutStream(job->bufferStream);
+  try {
+    encoder->writeRect(ppb, job->info.palette);
+  } catch (...) {
+    resetOutStream(encoder);
+    throw;
+  }
+  resetOutStream(encoder);
+
+  job->encoded = true;
+
+  job->time = getTime() - start;
+}
+
+void EncodeManager::writeJob(EncodeJob* job, EncodeCache* cache)
+{
+  PixelBuffer *ppb;
+  Encoder *encoder;
+
+  if (job->cached) {
+    if (!writeCachedRect(job->rect, cache))
+      throw rfb::Exception("Encoded rect missing from cache");
+    return;
+  }
+
+  // Count the time spent on the worker as if it was spent here
+  rectStart = getTime() - job->time;
+  analysisTime += job->info.analysisTime;
+
+  encoder = startRect(job->rect, job->type);
+
+  if (job->encoded) {
+    if (cache != NULL)
+      cache->insert(cacheConfig, job->rect, job->type,
+                    (const rdr::U8*)job->bufferStream->data(),
+                    job->bufferStream->length());
+    getOutStream()->writeBytes(job->bufferStream->data(),
+                                     job->bufferStream->length());
+  } else {
+    if (encoder->flags & EncoderUseNativePF)
+      ppb = preparePixelBuffer(job->rect, job->pb, false);
+    else
+      ppb = preparePixelBuffer(job->rect, job->pb, true);
+
+    encoder->writeRect(ppb, job->info.palette);
+  }
+
+  endRect();
+}
+
+void EncodeManager::abortJobs()
+{
+  std::list<EncodeJob*>::iterator iter;
+
+  // Make sure no worker is still looking at any of the jobs before
+  // getting rid of them
+  queueMutex->lock();
+
+  for (iter = workQueue.begin(); iter != workQueue.end(); ++iter) {
+    if (!(*iter)->active) {
+      (*iter)->active = true;
+      (*iter)->done = true;
+    }
+  }
+
+  for (iter = workQueue.begin(); iter != workQueue.end(); ++iter) {
+    while (!(*iter)->done)
+      producerCond->wait();
+  }
+
+  queueMutex->unlock();
+
+  while (!workQueue.empty()) {
+    freeBuffers.push_back(workQueue.front()->bufferStream);
+    delete workQueue.front();
+    workQueue.pop_front();
+  }
+}
+
+void EncodeManager::setThreadException(const rdr::Exception& e)
+{
+  os::AutoMutex a(queueMutex);
+
+  if (threadException != NULL)
+    return;
+
+  threadException = new rdr::Exception("Exception on worker thread: %s", e.str());
+}
+
+void EncodeManager::throwThreadException()
+{
+  os::AutoMutex a(queueMutex);
+
+  if (threadException == NULL)
+    return;
+
+  rdr::Exception e(*threadException);
+
+  delete threadException;
+  threadException = NULL;
+
+  throw e;
+}
+
+void EncodeManager::writeSubRect(const Rect& rect, const PixelBuffer *pb,
+                                 EncodeCache* cache)
 {
   PixelBuffer *ppb;
 
   Encoder *encoder;
 
   struct RectInfo info;
+  int type;
+
+  // Another connection might already have done all the hard work
+  if ((cache != NULL) && writeCachedRect(rect, cache))
+    return;
+
+  rectStart = getTime();
+
+  ppb = preparePixelBuffer(rect, pb, true);
+
+  type = chooseType(rect, ppb, &info);
+  analysisTime += info.analysisTime;
+
+  encoder = startRect(rect, type);
+
+  if (encoder->flags & EncoderUseNativePF)
+    ppb = preparePixelBuffer(rect, pb, false);
+
+  // Only encoders that don't carry state between rects can produce
+  // data that is usable on another connection
+  if ((cache == NULL) || !(encoder->flags & EncoderStateless)) {
+    encoder->writeRect(ppb, info.palette);
+    endRect();
+    return;
+  }
+
+  cacheBuffer.clear();
+
+  encoder->setOutStream(&cacheBuffer);
+  try {
+    encoder->writeRect(ppb, info.palette);
+  } catch (...) {
+    resetOutStream(encoder);
+    throw;
+  }
+  resetOutStream(encoder);
+
+  cache->insert(cacheConfig, rect, type,
+                (const rdr::U8*)cacheBuffer.data(), cacheBuffer.length());
+  getOutStream()->writeBytes(cacheBuffer.data(), cacheBuffer.length());
+
+  endRect();
+}
+
+bool EncodeManager::writeCachedRect(const Rect& rect, EncodeCache* cache)
+{
+  int type;
+  const std::vector<rdr::U8>* data;
+
+  rectStart = getTime();
+
+  if (!cache->lookup(cacheConfig, rect, &type, &data))
+    return false;
+
+  startRect(rect, type);
+  if (!data->empty())
+    getOutStream()->writeBytes(&(*data)[0], data->size());
+  endRect();
+
+  return true;
+}
+
+int EncodeManager::chooseType(const Rect& rect, const PixelBuffer *ppb,
+                              struct RectInfo *info)
+{
+  Encoder *encoder;
+
   unsigned int divisor, maxColours;
 
   bool useRLE;
-  EncoderType type;
+
+  double start;
 
   // FIXME: This is roughly the algorithm previously used by the Tight
   //        encoder. It seems a bit backwards though, that higher
   //        compression setting means spending less effort in building
   //        a palette. It might be that they figured the increase in
   //        zlib setting compensated for the loss.
-  if (conn->client.compressLevel == -1)
+  if (getCompressLevel() == -1)
     divisor = 2 * 8;
   else
-    divisor = conn->client.compressLevel * 8;
+    divisor = getCompressLevel() * 8;
   if (divisor < 4)
     divisor = 4;
 
@@ -826,7 +1911,7 @@ void EncodeManager::writeSubRect(const Rect& rect, const PixelBuffer *pb)
 
   // Special exception inherited from the Tight encoder
   if (activeEncoders[encoderFullColour] == encoderTightJPEG) {
-    if ((conn->client.compressLevel != -1) && (conn->client.compressLevel < 2))
+    if ((getCompressLevel() != -1) && (getCompressLevel() < 2))
       maxColours = 24;
     else
       maxColours = 96;
@@ -842,44 +1927,34 @@ void EncodeManager::writeSubRect(const Rect& rect, const PixelBuffer *pb)
   if (maxColours > encoder->maxPaletteSize)
     maxColours = encoder->maxPaletteSize;
 
-  ppb = preparePixelBuffer(rect, pb, true);
+  start = rectTiming ? getTime() : 0;
 
-  if (!analyseRect(ppb, &info, maxColours))
-    info.palette.clear();
+  if (!analyseRect(ppb, info, maxColours))
+    info->palette.clear();
+
+  info->analysisTime = rectTiming ? getTime() - start : 0;
 
   // Different encoders might have different RLE overhead, but
   // here we do a guess at RLE being the better choice if reduces
   // the pixel count by 50%.
-  useRLE = info.rleRuns <= (rect.area() * 2);
+  useRLE = info->rleRuns <= (rect.area() * 2);
 
-  switch (info.palette.size()) {
+  switch (info->palette.size()) {
   case 0:
-    type = encoderFullColour;
-    break;
+    return encoderFullColour;
   case 1:
-    type = encoderSolid;
-    break;
+    return encoderSolid;
   case 2:
     if (useRLE)
-      type = encoderBitmapRLE;
+      return encoderBitmapRLE;
     else
-      type = encoderBitmap;
-    break;
+      return encoderBitmap;
   default:
     if (useRLE)
-      type = encoderIndexedRLE;
+      return encoderIndexedRLE;
     else
-      type = encoderIndexed;
+      return encoderIndexed;
   }
-
-  encoder = startRect(rect, type);
-
-  if (encoder->flags & EncoderUseNativePF)
-    ppb = preparePixelBuffer(rect, pb, false);
-
-  encoder->writeRect(ppb, info.palette);
-
-  endRect();
 }
 
 bool EncodeManager::checkSolidTile(const Rect& r, const rdr::U8* colourValue,
@@ -994,21 +2069,31 @@ void EncodeManager::extendSolidAreaByPixel(const Rect& r, const Rect& sr,
 PixelBuffer* EncodeManager::preparePixelBuffer(const Rect& rect,
                                                const PixelBuffer *pb,
                                                bool convert)
+{
+  return preparePixelBuffer(rect, pb, convert,
+                            &offsetPixelBuffer, &convertedPixelBuffer);
+}
+
+PixelBuffer* EncodeManager::preparePixelBuffer(const Rect& rect,
+                                               const PixelBuffer *pb,
+                                               bool convert,
+                                               OffsetPixelBuffer* offsetBuffer,
+                                               ManagedPixelBuffer* convertedBuffer)
 {
   const rdr::U8* buffer;
   int stride;
 
   // Do wo need to convert the data?
   if (convert && !conn->client.pf().equal(pb->getPF())) {
-    convertedPixelBuffer.setPF(conn->client.pf());
-    convertedPixelBuffer.setSize(rect.width(), rect.height());
+    convertedBuffer->setPF(conn->client.pf());
+    convertedBuffer->setSize(rect.width(), rect.height());
 
     buffer = pb->getBuffer(rect, &stride);
-    convertedPixelBuffer.imageRect(pb->getPF(),
-                                   convertedPixelBuffer.getRect(),
-                                   buffer, stride);
+    convertedBuffer->imageRect(pb->getPF(),
+                               convertedBuffer->getRect(),
+                               buffer, stride);
 
-    return &convertedPixelBuffer;
+    return convertedBuffer;
   }
 
   // Otherwise we still need to shift the coordinates. We have our own
@@ -1016,10 +2101,10 @@ PixelBuffer* EncodeManager::preparePixelBuffer(const Rect& rect,
 
   buffer = pb->getBuffer(rect, &stride);
 
-  offsetPixelBuffer.update(pb->getPF(), rect.width(), rect.height(),
-                           buffer, stride);
+  offsetBuffer->update(pb->getPF(), rect.width(), rect.height(),
+                       buffer, stride);
 
-  return &offsetPixelBuffer;
+  return offsetBuffer;
 }
 
 bool EncodeManager::analyseRect(const PixelBuffer *pb,
@@ -1061,6 +2146,156 @@ rdr::U8* EncodeManager::OffsetPixelBuffer::getBufferRW(const Rect& r, int* strid
   throw rfb::Exception("Invalid write attempt to OffsetPixelBuffer");
 }
 
+EncodeManager::EncodeThread::EncodeThread(EncodeManager* manager)
+{
+  this->manager = manager;
+
+  stopRequested = false;
+
+  encoders.resize(encoderClassMax, NULL);
+
+  encoders[encoderRaw] = new RawEncoder(manager->conn);
+  encoders[encoderRRE] = new RREEncoder(manager->conn);
+  encoders[encoderHextile] = new HextileEncoder(manager->conn);
+  encoders[encoderTightJPEG] = new TightJPEGEncoder(manager->conn);
+
+  start();
+}
+
+EncodeManager::EncodeThread::~EncodeThread()
+{
+  std::vector<Encoder*>::iterator iter;
+
+  stop();
+  wait();
+
+  for (iter = encoders.begin();iter != encoders.end();iter++)
+    delete *iter;
+}
+
+void EncodeManager::EncodeThread::stop()
+{
+  os::AutoMutex a(manager->queueMutex);
+
+  if (!isRunning())
+    return;
+
+  stopRequested = true;
+
+  // We can't wake just this thread, so wake everyone
+  manager->consumerCond->broadcast();
+}
+
+void EncodeManager::EncodeThread::worker()
+{
+  manager->queueMutex->lock();
+
+  while (!stopRequested) {
+    EncodeManager::EncodeJob *job;
+    std::list<EncodeManager::EncodeJob*>::iterator iter;
+
+    // Look for the first job that nobody has started on
+    job = NULL;
+    for (iter = manager->workQueue.begin();
+         iter != manager->workQueue.end(); ++iter) {
+      if (!(*iter)->active) {
+        job = *iter;
+        break;
+      }
+    }
+
+    if (job == NULL) {
+      // Wait and try again
+      manager->consumerCond->wait();
+      continue;
+    }
+
+    // This is ours now
+    job->active = true;
+
+    manager->queueMutex->unlock();
+
+    try {
+      manager->encodeJob(job, encoders,
+                         &offsetPixelBuffer, &convertedPixelBuffer);
+    } catch (rdr::Exception& e) {
+      manager->setThreadException(e);
+    } catch(...) {
+      assert(false);
+    }
+
+    manager->queueMutex->lock();
+
+    job->done = true;
+
+    // Wake the main thread in case it is waiting for this job
+    manager->producerCond->signal();
+  }
+
+  manager->queueMutex->unlock();
+}
+
+EncodeManager::UpdateThread::UpdateThread(EncodeManager* manager)
+{
+  this->manager = manager;
+
+  stopRequested = false;
+
+  start();
+}
+
+EncodeManager::UpdateThread::~UpdateThread()
+{
+  stop();
+  wait();
+}
+
+void EncodeManager::UpdateThread::stop()
+{
+  os::AutoMutex a(manager->updateMutex);
+
+  if (!isRunning())
+    return;
+
+  stopRequested = true;
+
+  manager->updateCond->broadcast();
+}
+
+void EncodeManager::UpdateThread::worker()
+{
+  manager->updateMutex->lock();
+
+  while (!stopRequested) {
+    if (!manager->updateQueued) {
+      manager->updateCond->wait();
+      continue;
+    }
+
+    manager->updateQueued = false;
+
+    manager->updateMutex->unlock();
+
+    try {
+      manager->encodeUpdate();
+    } catch (rdr::Exception& e) {
+      manager->updateException = new rdr::Exception(e);
+    } catch(...) {
+      assert(false);
+    }
+
+    manager->updateMutex->lock();
+
+    manager->updateDone = true;
+    manager->updateCond->broadcast();
+
+    // Still holding the lock, so the handler can't go away under us
+    manager->updateHandler->updateReady();
+  }
+
+  manager->updateMutex->unlock();
+}
+
 // Preprocessor generated, optimised methods
 
 #define BPP 8
@@ -20,15 +20,33 @@
 #ifndef __RFB_ENCODEMANAGER_H__
 #define __RFB_ENCODEMANAGER_H__
 
+#include <list>
+#include <string>
 #include <vector>
 
+#include <os/Thread.h>
+
+#include <rdr/MemOutStream.h>
 #include <rdr/types.h>
+#include <rfb/ContentCache.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/Region.h>
+#include <rfb/SharedFramebuffer.h>
 #include <rfb/Timer.h>
 
+namespace os {
+  class Condition;
+  class Mutex;
+}
+
+namespace rdr {
+  struct Exception;
+}
+
 namespace rfb {
   class SConnection;
+  class SMsgWriter;
+  class EncodeCache;
   class Encoder;
   class UpdateInfo;
   class PixelBuffer;
@@ -39,7 +57,19 @@ namespace rfb {
 
   class EncodeManager : public Timer::Callback {
   public:
-    EncodeManager(SConnection* conn);
+    // An UpdateHandler is told when an update that is being encoded on
+    // the update thread is ready. It is called on that thread.
+    class UpdateHandler {
+    public:
+      virtual ~UpdateHandler() {}
+      virtual void updateReady() = 0;
+    };
+
+    // If given an UpdateHandler then updates will be encoded on a
+    // separate thread. writeUpdate() and writeLosslessRefresh() then
+    // only take a copy of the pixels needed, and the update has to be
+    // sent with finishUpdate() before another one can be started.
+    EncodeManager(SConnection* conn, UpdateHandler* handler=NULL);
     ~EncodeManager();
 
     void logStats();
@@ -47,26 +77,108 @@ namespace rfb {
     // Hack to let ConnParams calculate the client's preferred encoding
     static bool supported(int encoding);
 
+    static const char* encoderClassName(int klass);
+    static const char* encoderTypeName(int type);
+
+    struct EncoderStats {
+      unsigned rects;
+      unsigned long long bytes;
+      unsigned long long pixels;
+      unsigned long long equivalent;
+      // Seconds spent producing the rects
+      double time;
+    };
+
+    // The statistics gathered so far, for each of the encoder classes
+    // and types named by encoderClassName() and encoderTypeName()
+    static int encoderClassCount();
+    static int encoderTypeCount();
+    const EncoderStats& getStats(int klass, int type) const;
+    const EncoderStats& getCopyStats() const { return copyStats; }
+    unsigned getUpdateCount() const { return updates; }
+
+    // setQualityOverride() and setCompressOverride() replace the levels
+    // requested by the client with the given ones, or go back to the
+    // client's levels if given -1. A quality override also replaces
+    // the client's fine quality and subsampling settings.
+    void setQualityOverride(int level) { qualityOverride = level; }
+    void setCompressOverride(int level) { compressOverride = level; }
+
+    // The levels in use, taking any overrides into account
+    int getQualityLevel() const;
+    int getCompressLevel() const;
+
     bool needsLosslessRefresh(const Region& req);
     int getNextLosslessRefresh(const Region& req);
 
     void pruneLosslessRefresh(const Region& limits);
 
+    // setVideoRegion() gives the areas that are currently showing video
+    // (in the client's coordinates). They are sent with a lower JPEG
+    // quality and are not refreshed losslessly until they settle down.
+    void setVideoRegion(const Region& region) { videoRegion = region; }
+
+    // writeUpdate() will look up and store framebuffer rects in the
+    // given cache, if any, so that work can be shared between
+    // connections with identical settings
     void writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
-                     const RenderedCursor* renderedCursor);
+                     const RenderedCursor* renderedCursor,
+                     EncodeCache* cache=NULL);
 
     void writeLosslessRefresh(const Region& req, const PixelBuffer* pb,
                               const RenderedCursor* renderedCursor,
                               size_t maxUpdateSize);
 
+    // isThreaded() returns true if updates are encoded on the update
+    // thread. isUpdatePending() returns true if an update has been
+    // started on that thread but not yet sent. isUpdateReady() returns true
+    // if it has also finished encoding.
+    bool isThreaded() const { return updateThread != NULL; }
+    bool isUpdatePending() const { return updatePending; }
+    bool isUpdateReady();
+
+    // finishUpdate() waits for the pending update to be encoded and
+    // writes it to the connection. cancelUpdate() waits for it and then
+    // throws it away.
+    void finishUpdate();
+    void cancelUpdate();
+
   protected:
     virtual bool handleTimeout(Timer* t);
 
+    int prepareUpdate(bool allowLossy, const Region& changed,
+                      const Region& copied, const PixelBuffer* pb,
+                      const RenderedCursor* renderedCursor,
+                      EncodeCache* cache,
+                      Region* changedOut, Region* cursorRegionOut);
+    void writeUpdateRects(bool allowLossy, const Region& changed,
+                          const Region& cursorRegion,
+                          const Region& copied, const Point& copyDelta,
+                          const PixelBuffer* pb,
+                          const RenderedCursor* renderedCursor,
+                          EncodeCache* cache);
+    void startUpdate(bool allowLossy, const Region& changed,
+                     const Region& copied, const Point& copyDelta,
+                     const PixelBuffer* pb,
+                     const RenderedCursor* renderedCursor);
+    void encodeUpdate();
+
+    SMsgWriter* writer();
+    rdr::OutStream* getOutStream();
+    void resetOutStream(Encoder* encoder);
+
     void doUpdate(bool allowLossy, const Region& changed,
                   const Region& copied, const Point& copy_delta,
                   const PixelBuffer* pb,
-                  const RenderedCursor* renderedCursor);
+                  const RenderedCursor* renderedCursor,
+                  EncodeCache* cache);
     void prepareEncoders(bool allowLossy);
+    void configureEncoder(Encoder* encoder, bool allowLossy);
+    void prepareCacheConfig(const PixelBuffer* pb);
+    bool prepareSharedFramebuffer(const PixelBuffer* pb);
+
+    int getFineQualityLevel() const;
+    int getSubsampling() const;
 
     Region getLosslessRefresh(const Region& req, size_t maxUpdateSize);
 
@@ -75,12 +187,26 @@ namespace rfb {
     Encoder *startRect(const Rect& rect, int type);
     void endRect();
 
+    static double getTime();
+
     void writeCopyRects(const Region& copied, const Point& delta);
+    void writeContentCacheReset();
+    void writeContentCacheDraws(Region *changed, const PixelBuffer* pb,
+                                bool allowLossy);
+    void writeContentCacheStores();
+    void writeSharedRects(const Region& changed, const PixelBuffer* pb);
     void writeSolidRects(Region *changed, const PixelBuffer* pb);
     void findSolidRect(const Rect& rect, Region *changed, const PixelBuffer* pb);
-    void writeRects(const Region& changed, const PixelBuffer* pb);
+    void writeRects(const Region& changed, const PixelBuffer* pb,
+                    EncodeCache* cache);
+    void writeVideoRects(const Region& changed, const PixelBuffer* pb,
+                         EncodeCache* cache);
+    void configureVideoEncoder(bool video);
+    void splitRects(const Region& changed, std::vector<Rect>* rects);
 
-    void writeSubRect(const Rect& rect, const PixelBuffer *pb);
+    void writeSubRect(const Rect& rect, const PixelBuffer *pb,
+                      EncodeCache* cache);
+    bool writeCachedRect(const Rect& rect, EncodeCache* cache);
 
     bool checkSolidTile(const Rect& r, const rdr::U8* colourValue,
                         const PixelBuffer *pb);
@@ -96,6 +222,9 @@ namespace rfb {
     bool analyseRect(const PixelBuffer *pb,
                      struct RectInfo *info, int maxColours);
 
+    int chooseType(const Rect& rect, const PixelBuffer *ppb,
+                   struct RectInfo *info);
+
   protected:
     // Preprocessor generated, optimised methods
     inline bool checkSolidTile(const Rect& r, rdr::U8 colourValue,
@@ -115,6 +244,26 @@ namespace rfb {
                             const rdr::U32* buffer, int stride,
                             struct RectInfo *info, int maxColours);
 
+  protected:
+    class OffsetPixelBuffer;
+    struct EncodeJob;
+
+    PixelBuffer* preparePixelBuffer(const Rect& rect,
+                                    const PixelBuffer *pb, bool convert,
+                                    OffsetPixelBuffer* offsetBuffer,
+                                    ManagedPixelBuffer* convertedBuffer);
+
+    void writeRectsThreaded(const std::vector<Rect>& rects,
+                            const PixelBuffer* pb, EncodeCache* cache);
+    void encodeJob(EncodeJob* job, const std::vector<Encoder*>& jobEncoders,
+                   OffsetPixelBuffer* offsetBuffer,
+                   ManagedPixelBuffer* convertedBuffer);
+    void writeJob(EncodeJob* job, EncodeCache* cache);
+    void abortJobs();
+
+    void setThreadException(const rdr::Exception& e);
+    void throwThreadException();
+
   protected:
     SConnection *conn;
 
@@ -124,23 +273,33 @@ namespace rfb {
     Region lossyRegion;
     Region recentlyChangedRegion;
     Region pendingRefreshRegion;
+    Region videoRegion;
 
     Timer recentChangeTimer;
 
-    struct EncoderStats {
-      unsigned rects;
-      unsigned long long bytes;
-      unsigned long long pixels;
-      unsigned long long equivalent;
-    };
+    int qualityOverride;
+    int compressOverride;
+
     typedef std::vector< std::vector<struct EncoderStats> > StatsVector;
 
     unsigned updates;
     EncoderStats copyStats;
+    EncoderStats cacheDrawStats;
+    EncoderStats cacheStoreStats;
+    EncoderStats sharedStats;
     StatsVector stats;
     int activeType;
     int beforeLength;
 
+    // Subclasses can set rectTiming to have the time it took to
+    // produce each rect recorded in rectTimes, in seconds. The part of
+    // that spent counting colours is also added up in analysisTime.
+    bool rectTiming;
+    typedef std::vector< std::vector< std::vector<double> > > TimesVector;
+    TimesVector rectTimes;
+    double analysisTime;
+    double rectStart;
+
     class OffsetPixelBuffer : public FullFramePixelBuffer {
     public:
       OffsetPixelBuffer() {}
@@ -155,6 +314,99 @@ namespace rfb {
 
     OffsetPixelBuffer offsetPixelBuffer;
     ManagedPixelBuffer convertedPixelBuffer;
+
+    std::string cacheConfig;
+    rdr::MemOutStream cacheBuffer;
+
+    ServerContentCache contentCache;
+    PixelFormat contentCachePF;
+    bool contentCacheValid;
+
+    struct PendingStore {
+      Rect rect;
+      rdr::U64 hash;
+    };
+    std::vector<PendingStore> pendingStores;
+
+    // Set whilst every update goes through the shared framebuffer
+    // rather than the encoders
+    SharedFramebuffer sharedFramebuffer;
+    bool sharedFramebufferActive;
+    bool sharedFramebufferFailed;
+    bool sharedFramebufferAttach;
+
+    std::list<EncodeJob*> workQueue;
+    std::list<rdr::MemOutStream*> freeBuffers;
+
+    os::Mutex* queueMutex;
+    os::Condition* producerCond;
+    os::Condition* consumerCond;
+
+    class EncodeThread : public os::Thread {
+    public:
+      EncodeThread(EncodeManager* manager);
+      ~EncodeThread();
+
+      void stop();
+
+      // Private copies of the encoders that can be used on other
+      // threads, i.e. the ones that don't keep state between rects
+      std::vector<Encoder*> encoders;
+
+    protected:
+      void worker();
+
+    private:
+      EncodeManager* manager;
+
+      bool stopRequested;
+
+      OffsetPixelBuffer offsetPixelBuffer;
+      ManagedPixelBuffer convertedPixelBuffer;
+    };
+
+    std::list<EncodeThread*> threads;
+    rdr::Exception *threadException;
+
+    // Used when each update is encoded on a separate thread, where the
+    // whole update is written to updateStream. updateBuffer has a copy
+    // of the pixels that the update needs.
+    class UpdateThread : public os::Thread {
+    public:
+      UpdateThread(EncodeManager* manager);
+      ~UpdateThread();
+
+      void stop();
+
+    protected:
+      void worker();
+
+    private:
+      EncodeManager* manager;
+
+      bool stopRequested;
+    };
+
+    UpdateHandler* updateHandler;
+    UpdateThread* updateThread;
+
+    os::Mutex* updateMutex;
+    os::Condition* updateCond;
+
+    bool updatePending;
+    bool updateQueued;
+    bool updateDone;
+    rdr::Exception *updateException;
+
+    bool updateAllowLossy;
+    Region updateChanged;
+    Region updateCopied;
+    Point updateCopyDelta;
+    int updateRects;
+
+    ManagedPixelBuffer updateBuffer;
+    rdr::MemOutStream updateStream;
+    SMsgWriter* updateWriter;
   };
 }
 
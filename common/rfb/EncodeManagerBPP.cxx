@@ -64,12 +64,15 @@ inline bool EncodeManager::analyseRect(int width, int height,
 
   pad = stride - width;
 
-  // For efficiency, we only update the palette on changes in colour
+  // For efficiency, we only update the palette on changes in colour,
+  // and skip over runs of the same colour as quickly as we can
   colour = buffer[0];
   count = 0;
   while (height--) {
-    int w_ = width;
-    while (w_--) {
+    const rdr::UBPP* end;
+
+    end = buffer + width;
+    while (buffer < end) {
       if (*buffer != colour) {
         if (!info->palette.insert(colour, count))
           return false;
@@ -81,7 +84,20 @@ inline bool EncodeManager::analyseRect(int width, int height,
 
         colour = *buffer;
         count = 0;
+      } else if ((count >= 8) && (end - buffer >= 16)) {
+        int run;
+
+        // Photographic content rarely has long runs, so only bring
+        // out the vectorised compares once this looks like one
+        run = simdRunLength((const rdr::U8*)buffer, BPP,
+                            end - buffer, colour);
+        if (run > 0) {
+          buffer += run;
+          count += run;
+          continue;
+        }
       }
+
       buffer++;
       count++;
     }
@@ -20,6 +20,7 @@
 #include <rfb/Encoder.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/Palette.h>
+#include <rfb/SConnection.h>
 
 using namespace rfb;
 
@@ -28,7 +29,7 @@ Encoder::Encoder(SConnection *conn_, int encoding_,
                  unsigned int maxPaletteSize_, int losslessQuality_) :
   encoding(encoding_), flags(flags_),
   maxPaletteSize(maxPaletteSize_), losslessQuality(losslessQuality_),
-  conn(conn_)
+  conn(conn_), redirectStream(NULL)
 {
 }
 
@@ -36,6 +37,11 @@ Encoder::~Encoder()
 {
 }
 
+void Encoder::setOutStream(rdr::OutStream* os)
+{
+  redirectStream = os;
+}
+
 void Encoder::writeSolidRect(int width, int height,
                              const PixelFormat& pf, const rdr::U8* colour)
 {
@@ -81,3 +87,11 @@ void Encoder::writeSolidRect(const PixelBuffer* pb, const Palette& palette)
 
   writeSolidRect(pb->width(), pb->height(), pb->getPF(), buffer);
 }
+
+rdr::OutStream* Encoder::getOutStream()
+{
+  if (redirectStream != NULL)
+    return redirectStream;
+
+  return conn->getOutStream();
+}
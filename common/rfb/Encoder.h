@@ -23,6 +23,8 @@
 #include <rdr/types.h>
 #include <rfb/Rect.h>
 
+namespace rdr { class OutStream; }
+
 namespace rfb {
   class SConnection;
   class PixelBuffer;
@@ -37,6 +39,9 @@ namespace rfb {
     EncoderUseNativePF = 1 << 0,
     // Encoder does not encode pixels perfectly accurate
     EncoderLossy = 1 << 1,
+    // The encoded data only depends on the rect given, i.e. no state
+    // is carried over from one rect to the next
+    EncoderStateless = 1 << 2,
   };
 
   class Encoder {
@@ -84,11 +89,20 @@ namespace rfb {
                                 const PixelFormat& pf,
                                 const rdr::U8* colour)=0;
 
+    // setOutStream() makes the encoder write its data to the given
+    // stream instead of the connection's. Setting it to NULL restores
+    // the normal behaviour.
+    void setOutStream(rdr::OutStream* os);
+
   protected:
     // Helper method for redirecting a single colour palette to the
     // short cut method.
     void writeSolidRect(const PixelBuffer* pb, const Palette& palette);
 
+    // getOutStream() returns the stream encoded data should be
+    // written to.
+    rdr::OutStream* getOutStream();
+
   public:
     const int encoding;
     const enum EncoderFlags flags;
@@ -102,6 +116,9 @@ namespace rfb {
 
   protected:
     SConnection* conn;
+
+  private:
+    rdr::OutStream* redirectStream;
   };
 }
 
@@ -22,82 +22,207 @@
 #include <string.h>
 
 #include <os/Mutex.h>
+#include <os/Thread.h>
+
+#include <rdr/Exception.h>
 
 #include <rfb/util.h>
+#include <rfb/LogWriter.h>
 #include <rfb/Logger_file.h>
 
 using namespace rfb;
 
+// How much unwritten log data we keep before dropping messages
+static const size_t ringSize = 256 * 1024;
+
+struct EntryHeader {
+  time_t time;
+  size_t lognameLength;
+  size_t messageLength;
+};
+
+class Logger_File::WriterThread : public os::Thread {
+public:
+  WriterThread(Logger_File* logger_) : logger(logger_) {}
+protected:
+  virtual void worker() { logger->writerLoop(); }
+private:
+  Logger_File* logger;
+};
+
 Logger_File::Logger_File(const char* loggerName)
-  : Logger(loggerName), indent(13), width(79), m_filename(0), m_file(0),
-    m_lastLogTime(0)
+  : Logger(loggerName), indent(13), width(79),
+    maxSize(10 * 1024 * 1024), maxFiles(1),
+    m_filename(0), m_file(0), m_lastLogTime(0),
+    thread(0), threadFailed(false), stopping(false),
+    ring(0), ringStart(0), ringUsed(0),
+    queuedCount(0), writtenCount(0), dropped(0), totalDropped(0)
 {
+  fileMutex = new os::Mutex();
   mutex = new os::Mutex();
+  queuedCond = new os::Condition(mutex);
+  writtenCond = new os::Condition(mutex);
 }
 
 Logger_File::~Logger_File()
 {
+  if (thread) {
+    mutex->lock();
+    stopping = true;
+    queuedCond->signal();
+    mutex->unlock();
+
+    thread->wait();
+
+    mutex->lock();
+    delete thread;
+    thread = NULL;
+    // Anyone who logged whilst the thread was stopping can now write
+    // things out themselves
+    writtenCond->broadcast();
+    mutex->unlock();
+  }
+
   closeFile();
+
+  delete [] ring;
+  delete writtenCond;
+  delete queuedCond;
   delete mutex;
+  delete fileMutex;
 }
 
 void Logger_File::write(int level, const char *logname, const char *message)
 {
-  os::AutoMutex a(mutex);
+  {
+    os::AutoMutex a(mutex);
+
+    if (!thread && !threadFailed && !stopping) {
+      try {
+        ring = new char[ringSize];
+        thread = new WriterThread(this);
+        thread->start();
+      } catch (rdr::Exception&) {
+        delete thread;
+        thread = NULL;
+        threadFailed = true;
+      }
+    }
 
-  if (!m_file) {
-    if (!m_filename) return;
-    CharArray bakFilename(strlen(m_filename) + 1 + 4);
-    sprintf(bakFilename.buf, "%s.bak", m_filename);
-    remove(bakFilename.buf);
-    rename(m_filename, bakFilename.buf);
-    m_file = fopen(m_filename, "w+");
-    if (!m_file) return;
+    // The thread might still be formatting entries, so we can't do
+    // anything ourselves until it is completely gone
+    while (thread && stopping)
+      writtenCond->wait();
+
+    if (thread) {
+      queueEntry(level, logname, message);
+      return;
+    }
   }
 
-  time_t current = time(0);
-  if (current != m_lastLogTime) {
-    m_lastLogTime = current;
-    fprintf(m_file, "\n%s", ctime(&m_lastLogTime));
+  // No thread to hand things over to, so do it ourselves
+  writeEntry(logname, message);
+}
+
+void Logger_File::queueEntry(int level, const char *logname,
+                             const char *message)
+{
+  EntryHeader header;
+  size_t needed;
+  unsigned long long entry;
+
+  header.time = time(0);
+  header.lognameLength = strlen(logname) + 1;
+  header.messageLength = strlen(message) + 1;
+
+  // Very long messages get cut short rather than dropped
+  if (header.messageLength > ringSize / 4)
+    header.messageLength = ringSize / 4;
+
+  needed = sizeof(header) + header.lognameLength + header.messageLength;
+
+  // Errors are too important to lose, so wait for space for those
+  if (level <= LogWriter::LEVEL_ERROR) {
+    while (ringSize - ringUsed < needed)
+      writtenCond->wait();
   }
 
-  fprintf(m_file," %s:", logname);
-  int column = strlen(logname) + 2;
-  if (column < indent) {
-    fprintf(m_file,"%*s",indent-column,"");
-    column = indent;
+  if (ringSize - ringUsed < needed) {
+    dropped++;
+    totalDropped++;
+    return;
   }
-  while (true) {
-    const char* s = strchr(message, ' ');
-    int wordLen;
-    if (s) wordLen = s-message;
-    else wordLen = strlen(message);
 
-    if (column + wordLen + 1 > width) {
-      fprintf(m_file,"\n%*s",indent,"");
-      column = indent;
-    }
-    fprintf(m_file," %.*s",wordLen,message);
-    column += wordLen + 1;
-    message += wordLen + 1;
-    if (!s) break;
+  queue(&header, sizeof(header));
+  queue(logname, header.lognameLength);
+  queue(message, header.messageLength - 1);
+  queue("", 1);
+
+  entry = ++queuedCount;
+  queuedCond->signal();
+
+  // Make sure errors make it to disk, in case we are about to crash
+  if (level <= LogWriter::LEVEL_ERROR) {
+    while (writtenCount < entry)
+      writtenCond->wait();
   }
-  fprintf(m_file,"\n");
+}
+
+void Logger_File::writeEntry(const char *logname, const char *message)
+{
+  std::vector<char> out;
+
+  // There is no writer thread at this point, so fileMutex also keeps
+  // other callers from formatting entries at the same time
+  os::AutoMutex a(fileMutex);
+
+  formatEntry(&out, time(0), logname, message);
+
+  if (!m_file && !openFile())
+    return;
+
+  fwrite(&out[0], 1, out.size(), m_file);
   fflush(m_file);
 }
 
 void Logger_File::setFilename(const char* filename)
 {
+  flush();
+
+  os::AutoMutex a(fileMutex);
   closeFile();
   m_filename = strDup(filename);
 }
 
 void Logger_File::setFile(FILE* file)
 {
+  flush();
+
+  os::AutoMutex a(fileMutex);
   closeFile();
   m_file = file;
 }
 
+void Logger_File::flush()
+{
+  unsigned long long entry;
+
+  os::AutoMutex a(mutex);
+
+  if (!thread)
+    return;
+
+  entry = queuedCount;
+  while (writtenCount < entry)
+    writtenCond->wait();
+}
+
+unsigned Logger_File::getDropped()
+{
+  os::AutoMutex a(mutex);
+  return totalDropped;
+}
+
 void Logger_File::closeFile()
 {
   if (m_filename) {
@@ -110,6 +235,198 @@ void Logger_File::closeFile()
   }
 }
 
+bool Logger_File::openFile()
+{
+  if (!m_filename)
+    return false;
+
+  rotateFiles();
+
+  m_file = fopen(m_filename, "w+");
+  if (!m_file)
+    return false;
+
+  m_lastLogTime = 0;
+
+  return true;
+}
+
+void Logger_File::rotateFiles()
+{
+  size_t len;
+
+  if (maxFiles <= 0)
+    return;
+
+  len = strlen(m_filename) + 1 + 10 + 1;
+  CharArray from(len), to(len);
+
+  for (int i = maxFiles;i > 1;i--) {
+    snprintf(from.buf, len, "%s.%d", m_filename, i - 1);
+    snprintf(to.buf, len, "%s.%d", m_filename, i);
+    remove(to.buf);
+    rename(from.buf, to.buf);
+  }
+
+  snprintf(to.buf, len, "%s.1", m_filename);
+  remove(to.buf);
+  rename(m_filename, to.buf);
+}
+
+void Logger_File::queue(const void* data, size_t length)
+{
+  size_t pos, first;
+
+  pos = (ringStart + ringUsed) % ringSize;
+  first = __rfbmin(length, ringSize - pos);
+
+  memcpy(ring + pos, data, first);
+  memcpy(ring, (const char*)data + first, length - first);
+
+  ringUsed += length;
+}
+
+void Logger_File::writerLoop()
+{
+  std::vector<char> batch, out;
+  unsigned long long entry;
+  unsigned lost;
+
+  mutex->lock();
+
+  while (true) {
+    size_t first, pos;
+
+    while ((ringUsed == 0) && (dropped == 0) && !stopping)
+      queuedCond->wait();
+
+    if ((ringUsed == 0) && (dropped == 0))
+      break;
+
+    // Grab everything that has queued up, so we can write it all
+    // in one go without keeping anyone else waiting
+    batch.resize(ringUsed);
+    first = __rfbmin(ringUsed, ringSize - ringStart);
+    if (ringUsed != 0) {
+      memcpy(&batch[0], ring + ringStart, first);
+      memcpy(&batch[first], ring, ringUsed - first);
+    }
+    ringStart = (ringStart + ringUsed) % ringSize;
+    ringUsed = 0;
+
+    lost = dropped;
+    dropped = 0;
+
+    entry = queuedCount;
+
+    // There is room again, so let any waiting errors through
+    writtenCond->broadcast();
+
+    mutex->unlock();
+
+    out.clear();
+
+    pos = 0;
+    while (pos < batch.size()) {
+      EntryHeader header;
+      const char* logname;
+      const char* message;
+
+      memcpy(&header, &batch[pos], sizeof(header));
+      pos += sizeof(header);
+      logname = &batch[pos];
+      pos += header.lognameLength;
+      message = &batch[pos];
+      pos += header.messageLength;
+
+      formatEntry(&out, header.time, logname, message);
+    }
+
+    if (lost != 0) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "%u log messages dropped", lost);
+      formatEntry(&out, time(0), "Logger", buf);
+    }
+
+    fileMutex->lock();
+
+    if (m_file || openFile()) {
+      fwrite(&out[0], 1, out.size(), m_file);
+      fflush(m_file);
+
+      // Start a new file once this one has grown too large
+      if (m_filename && (maxSize > 0) && (ftell(m_file) > maxSize)) {
+        fclose(m_file);
+        m_file = 0;
+      }
+    }
+
+    fileMutex->unlock();
+
+    mutex->lock();
+
+    writtenCount = entry;
+    writtenCond->broadcast();
+  }
+
+  mutex->unlock();
+}
+
+static void appendf(std::vector<char>* out, const char* format, ...)
+  __printf_attr(2, 3);
+
+static void appendf(std::vector<char>* out, const char* format, ...)
+{
+  va_list ap;
+  char buf[256];
+  int len;
+
+  va_start(ap, format);
+  len = vsnprintf(buf, sizeof(buf), format, ap);
+  va_end(ap);
+
+  if (len < 0)
+    return;
+  if ((size_t)len >= sizeof(buf))
+    len = sizeof(buf) - 1;
+
+  out->insert(out->end(), buf, buf + len);
+}
+
+void Logger_File::formatEntry(std::vector<char>* out, time_t time,
+                              const char* logname, const char* message)
+{
+  if (time != m_lastLogTime) {
+    m_lastLogTime = time;
+    appendf(out, "\n%s", ctime(&m_lastLogTime));
+  }
+
+  appendf(out, " %s:", logname);
+  int column = strlen(logname) + 2;
+  if (column < indent) {
+    out->insert(out->end(), indent-column, ' ');
+    column = indent;
+  }
+  while (true) {
+    const char* s = strchr(message, ' ');
+    int wordLen;
+    if (s) wordLen = s-message;
+    else wordLen = strlen(message);
+
+    if (column + wordLen + 1 > width) {
+      out->push_back('\n');
+      out->insert(out->end(), indent, ' ');
+      column = indent;
+    }
+    out->push_back(' ');
+    out->insert(out->end(), message, message + wordLen);
+    column += wordLen + 1;
+    message += wordLen + 1;
+    if (!s) break;
+  }
+  out->push_back('\n');
+}
+
 static Logger_File logger("file");
 
 bool rfb::initFileLogger(const char* filename) {
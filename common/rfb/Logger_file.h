@@ -17,14 +17,21 @@
  */
 
 // -=- Logger_file - log to a file
+//
+// Messages are queued in a ring buffer and written out in batches by a
+// separate thread, so logging doesn't stall the caller on disk I/O. If
+// the buffer fills up then messages are dropped and a note about how
+// many were lost is written once there is room again. Errors are always
+// written out before write() returns.
 
 #ifndef __RFB_LOGGER_FILE_H__
 #define __RFB_LOGGER_FILE_H__
 
 #include <time.h>
+#include <vector>
 #include <rfb/Logger.h>
 
-namespace os { class Mutex; }
+namespace os { class Mutex; class Condition; }
 
 namespace rfb {
 
@@ -37,15 +44,66 @@ namespace rfb {
     void setFilename(const char* filename);
     void setFile(FILE* file);
 
+    // flush() waits until everything logged so far has been written
+    void flush();
+
+    // getDropped() returns how many messages have been lost because
+    // the buffer was full
+    unsigned getDropped();
+
     int indent;
     int width;
 
+    // A named file is rotated once it grows beyond maxSize bytes,
+    // keeping maxFiles old copies as filename.1 (the most recent),
+    // filename.2 and so on
+    long maxSize;
+    int maxFiles;
+
   protected:
+    class WriterThread;
+    friend class WriterThread;
+
     void closeFile();
+    bool openFile();
+    void rotateFiles();
+
+    // queueEntry() hands an entry over to the writer thread and must
+    // be called with mutex held. writeEntry() writes it out directly
+    // and is only used when there is no writer thread.
+    void queueEntry(int level, const char *logname, const char *message);
+    void writeEntry(const char *logname, const char *message);
+
+    void queue(const void* data, size_t length);
+    void writerLoop();
+    void formatEntry(std::vector<char>* out, time_t time,
+                     const char* logname, const char* message);
+
     char* m_filename;
     FILE* m_file;
     time_t m_lastLogTime;
+
+    // Protects m_filename and m_file, held by the writer thread
+    // whilst it writes out a batch
+    os::Mutex* fileMutex;
+
+    // Protects the ring buffer and the counters below
     os::Mutex* mutex;
+    os::Condition* queuedCond;
+    os::Condition* writtenCond;
+
+    WriterThread* thread;
+    bool threadFailed;
+    bool stopping;
+
+    char* ring;
+    size_t ringStart;
+    size_t ringUsed;
+
+    unsigned long long queuedCount;
+    unsigned long long writtenCount;
+    unsigned dropped;
+    unsigned totalDropped;
   };
 
   bool initFileLogger(const char* filename);
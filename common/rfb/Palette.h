@@ -28,12 +28,12 @@
 namespace rfb {
   class Palette {
   public:
-    Palette() { clear(); }
+    Palette() { numColours = 0; memset(table, 0, sizeof(table)); }
     ~Palette() {}
 
     int size() const { return numColours; }
 
-    void clear() { numColours = 0; memset(hash, 0, sizeof(hash)); }
+    inline void clear();
 
     inline bool insert(rdr::U32 colour, int numPixels);
     inline unsigned char lookup(rdr::U32 colour) const;
@@ -41,72 +41,67 @@ namespace rfb {
     inline int getCount(unsigned char index) const;
 
   protected:
-    inline unsigned char genHash(rdr::U32 colour) const;
+    inline unsigned genHash(rdr::U32 colour) const;
+    inline void sortUp(unsigned char idx, unsigned char slot,
+                       int numPixels);
 
   protected:
-    int numColours;
+    // Four times as many buckets as colours keeps the probe sequences
+    // short even when the palette is full
+    static const unsigned tableBits = 10;
+    static const unsigned tableSize = 1 << tableBits;
 
-    struct PaletteListNode {
-      PaletteListNode *next;
-      unsigned char idx;
-      rdr::U32 colour;
-    };
+    int numColours;
 
     struct PaletteEntry {
-      PaletteListNode *listNode;
+      unsigned char slot;
       int numPixels;
     };
 
     // This is the raw list of colours, allocated from 0 and up
-    PaletteListNode list[256];
-    // Hash table for quick lookup into the list above
-    PaletteListNode *hash[256];
+    rdr::U32 colours[256];
+    // Open addressed hash table with linear probing. Each bucket holds
+    // the colour's slot plus one, or zero if it is unused.
+    rdr::U16 table[tableSize];
+    // Which bucket each slot ended up in, so clear() only has to reset
+    // those
+    rdr::U16 buckets[256];
+    // Where each slot currently is in entry[] below
+    unsigned char index[256];
     // Occurances of each colour, where the 0:th entry is the most common.
     // Indices also refer to this array.
     PaletteEntry entry[256];
   };
 }
 
-inline bool rfb::Palette::insert(rdr::U32 colour, int numPixels)
+inline void rfb::Palette::clear()
 {
-  PaletteListNode* pnode;
-  PaletteListNode* prev_pnode;
-  unsigned char hash_key, idx;
+  for (int i = 0; i < numColours; i++)
+    table[buckets[i]] = 0;
+  numColours = 0;
+}
 
-  hash_key = genHash(colour);
+inline bool rfb::Palette::insert(rdr::U32 colour, int numPixels)
+{
+  unsigned bucket;
+  unsigned char slot;
 
-  pnode = hash[hash_key];
-  prev_pnode = NULL;
+  bucket = genHash(colour);
 
   // Do we already have an entry for this colour?
-  while (pnode != NULL) {
-    if (pnode->colour == colour) {
+  while (table[bucket] != 0) {
+    slot = table[bucket] - 1;
+    if (colours[slot] == colour) {
       // Yup
 
-      idx = pnode->idx;
-      numPixels = entry[idx].numPixels + numPixels;
-
       // The extra pixels might mean we have to adjust the sort list
-      while (idx > 0) {
-        if (entry[idx-1].numPixels >= numPixels)
-          break;
-        entry[idx] = entry[idx-1];
-        entry[idx].listNode->idx = idx;
-        idx--;
-      }
-
-      if (idx != pnode->idx) {
-        entry[idx].listNode = pnode;
-        pnode->idx = idx;
-      }
-
-      entry[idx].numPixels = numPixels;
+      numPixels += entry[index[slot]].numPixels;
+      sortUp(index[slot], slot, numPixels);
 
       return true;
     }
 
-    prev_pnode = pnode;
-    pnode = pnode->next;
+    bucket = (bucket + 1) & (tableSize - 1);
   }
 
   // Check if palette is full.
@@ -114,31 +109,14 @@ inline bool rfb::Palette::insert(rdr::U32 colour, int numPixels)
     return false;
 
   // Create a new colour entry
-  pnode = &list[numColours];
-  pnode->next = NULL;
-  pnode->idx = 0;
-  pnode->colour = colour;
-
-  // Add it to the hash table
-  if (prev_pnode != NULL)
-    prev_pnode->next = pnode;
-  else
-    hash[hash_key] = pnode;
-
-  // Move palette entries with lesser pixel counts.
-  idx = numColours;
-  while (idx > 0) {
-    if (entry[idx-1].numPixels >= numPixels)
-      break;
-    entry[idx] = entry[idx-1];
-    entry[idx].listNode->idx = idx;
-    idx--;
-  }
+  slot = numColours;
+  colours[slot] = colour;
+  table[bucket] = slot + 1;
+  buckets[slot] = bucket;
 
-  // And add it into the freed slot.
-  pnode->idx = idx;
-  entry[idx].listNode = pnode;
-  entry[idx].numPixels = numPixels;
+  // And add it at the end, moving it past entries with lesser
+  // pixel counts
+  sortUp(numColours, slot, numPixels);
 
   numColours++;
 
@@ -147,16 +125,18 @@ inline bool rfb::Palette::insert(rdr::U32 colour, int numPixels)
 
 inline unsigned char rfb::Palette::lookup(rdr::U32 colour) const
 {
-  unsigned char hash_key;
-  PaletteListNode* pnode;
+  unsigned bucket;
+
+  bucket = genHash(colour);
 
-  hash_key = genHash(colour);
-  pnode = hash[hash_key];
+  while (table[bucket] != 0) {
+    unsigned char slot;
 
-  while (pnode != NULL) {
-    if (pnode->colour == colour)
-      return pnode->idx;
-    pnode = pnode->next;
+    slot = table[bucket] - 1;
+    if (colours[slot] == colour)
+      return index[slot];
+
+    bucket = (bucket + 1) & (tableSize - 1);
   }
 
   // We are being fed a bad colour
@@ -167,7 +147,7 @@ inline unsigned char rfb::Palette::lookup(rdr::U32 colour) const
 
 inline rdr::U32 rfb::Palette::getColour(unsigned char index) const
 {
-  return entry[index].listNode->colour;
+  return colours[entry[index].slot];
 }
 
 inline int rfb::Palette::getCount(unsigned char index) const
@@ -175,16 +155,27 @@ inline int rfb::Palette::getCount(unsigned char index) const
   return entry[index].numPixels;
 }
 
-inline unsigned char rfb::Palette::genHash(rdr::U32 colour) const
+inline unsigned rfb::Palette::genHash(rdr::U32 colour) const
 {
-  unsigned char hash_key;
+  // Fibonacci hashing, which spreads out the similar colours that are
+  // common in real images
+  return (rdr::U32)(colour * 2654435761U) >> (32 - tableBits);
+}
 
-  // djb2 hash function
-  hash_key = 5; // 5381 & 0xff
-  for (int i = 0; i < 32; i += 8)
-    hash_key = ((hash_key << 5) + hash_key) ^ (colour >> i);
+inline void rfb::Palette::sortUp(unsigned char idx, unsigned char slot,
+                                 int numPixels)
+{
+  while (idx > 0) {
+    if (entry[idx-1].numPixels >= numPixels)
+      break;
+    entry[idx] = entry[idx-1];
+    index[entry[idx].slot] = idx;
+    idx--;
+  }
 
-  return hash_key;
+  entry[idx].slot = slot;
+  entry[idx].numPixels = numPixels;
+  index[slot] = idx;
 }
 
 #endif
@@ -404,7 +404,9 @@ void ManagedPixelBuffer::setSize(int w, int h)
   unsigned long new_datasize = w * h * (format.bpp/8);
 
   new_datasize = w * h * (format.bpp/8);
-  if (datasize < new_datasize) {
+  // The memory is kept when shrinking, unless the buffer goes away
+  // completely
+  if ((datasize < new_datasize) || (new_datasize == 0)) {
     if (data_) {
       delete [] data_;
       data_ = NULL;
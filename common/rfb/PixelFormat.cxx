@@ -25,6 +25,7 @@
 #include <rdr/OutStream.h>
 #include <rfb/Exception.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <rfb/util.h>
 
 #ifdef _WIN32
@@ -388,6 +389,8 @@ void PixelFormat::bufferFromBuffer(rdr::U8* dst, const PixelFormat &srcPF,
     // Optimised common case A: byte shuffling (e.g. endian conversion)
     rdr::U8 *d[4], *s[4];
     int dstPad, srcPad;
+    SIMDConversion conv;
+    bool useSIMD;
 
     if (bigEndian) {
       s[0] = dst + (24 - redShift)/8;
@@ -413,10 +416,29 @@ void PixelFormat::bufferFromBuffer(rdr::U8* dst, const PixelFormat &srcPF,
       d[(48 - srcPF.redShift - srcPF.greenShift - srcPF.blueShift)/8] = s[3];
     }
 
+    for (int i = 0; i < 4; i++)
+      conv.order[d[i] - dst] = i;
+    useSIMD = prepareSIMDSwizzle(&conv);
+
     dstPad = (dstStride - w) * 4;
     srcPad = (srcStride - w) * 4;
     while (h--) {
       int w_ = w;
+
+      // The vectorised code can do most of the row, but not all
+      if (useSIMD) {
+        int n;
+
+        n = simdSwizzle888(dst, src, w, conv);
+
+        d[0] += n * 4;
+        d[1] += n * 4;
+        d[2] += n * 4;
+        d[3] += n * 4;
+        src += n * 4;
+        w_ -= n;
+      }
+
       while (w_--) {
         *d[0] = *(src++);
         *d[1] = *(src++);
@@ -432,6 +454,7 @@ void PixelFormat::bufferFromBuffer(rdr::U8* dst, const PixelFormat &srcPF,
       d[2] += dstPad;
       d[3] += dstPad;
       src += srcPad;
+      dst += dstStride * 4;
     }
   } else if (IS_ALIGNED(dst, bpp/8) && srcPF.is888()) {
     // Optimised common case B: 888 source
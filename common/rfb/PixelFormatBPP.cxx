@@ -43,6 +43,9 @@ void PixelFormat::directBufferFromBufferFrom888(rdr::UOUT* dst,
 
   const rdr::U8 *redDownTable, *greenDownTable, *blueDownTable;
 
+  SIMDConversion conv;
+  bool useSIMD;
+
   redDownTable = &downconvTable[(redBits-1)*256];
   greenDownTable = &downconvTable[(greenBits-1)*256];
   blueDownTable = &downconvTable[(blueBits-1)*256];
@@ -57,10 +60,41 @@ void PixelFormat::directBufferFromBufferFrom888(rdr::UOUT* dst,
     b = src + srcPF.blueShift/8;
   }
 
+#if OUTBPP != 32
+  conv.offsets[0] = r - src;
+  conv.offsets[1] = g - src;
+  conv.offsets[2] = b - src;
+  conv.offsets[3] = 6 - conv.offsets[0] - conv.offsets[1] - conv.offsets[2];
+  conv.max[0] = redMax;
+  conv.max[1] = greenMax;
+  conv.max[2] = blueMax;
+  conv.shift[0] = redShift;
+  conv.shift[1] = greenShift;
+  conv.shift[2] = blueShift;
+  conv.swap = endianMismatch;
+  useSIMD = prepareSIMDConversion(&conv);
+#else
+  useSIMD = false;
+#endif
+
   dstPad = (dstStride - w);
   srcPad = (srcStride - w) * 4;
   while (h--) {
     int w_ = w;
+
+    // The vectorised code can do most of the row, but not all
+    if (useSIMD) {
+      int n;
+
+      n = simdFrom888((rdr::U8*)dst, OUTBPP, r - conv.offsets[0], w, conv);
+
+      dst += n;
+      r += n * 4;
+      g += n * 4;
+      b += n * 4;
+      w_ -= n;
+    }
+
     while (w_--) {
       rdr::UOUT d;
 
@@ -103,6 +137,9 @@ void PixelFormat::directBufferFromBufferTo888(rdr::U8* dst,
 
   const rdr::U8 *redUpTable, *greenUpTable, *blueUpTable;
 
+  SIMDConversion conv;
+  bool useSIMD;
+
   redUpTable = &upconvTable[(srcPF.redBits-1)*256];
   greenUpTable = &upconvTable[(srcPF.greenBits-1)*256];
   blueUpTable = &upconvTable[(srcPF.blueBits-1)*256];
@@ -119,10 +156,42 @@ void PixelFormat::directBufferFromBufferTo888(rdr::U8* dst,
     x = dst + (48 - redShift - greenShift - blueShift)/8;
   }
 
+#if INBPP != 32
+  conv.offsets[0] = r - dst;
+  conv.offsets[1] = g - dst;
+  conv.offsets[2] = b - dst;
+  conv.offsets[3] = x - dst;
+  conv.max[0] = srcPF.redMax;
+  conv.max[1] = srcPF.greenMax;
+  conv.max[2] = srcPF.blueMax;
+  conv.shift[0] = srcPF.redShift;
+  conv.shift[1] = srcPF.greenShift;
+  conv.shift[2] = srcPF.blueShift;
+  conv.swap = srcPF.endianMismatch;
+  useSIMD = prepareSIMDConversion(&conv);
+#else
+  useSIMD = false;
+#endif
+
   dstPad = (dstStride - w) * 4;
   srcPad = (srcStride - w);
   while (h--) {
     int w_ = w;
+
+    // The vectorised code can do most of the row, but not all
+    if (useSIMD) {
+      int n;
+
+      n = simdTo888(r - conv.offsets[0], (const rdr::U8*)src, INBPP, w, conv);
+
+      r += n * 4;
+      g += n * 4;
+      b += n * 4;
+      x += n * 4;
+      src += n;
+      w_ -= n;
+    }
+
     while (w_--) {
       rdr::UIN s;
 
@@ -0,0 +1,721 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include <rfb/PixelFormatSIMD.h>
+
+#if defined(HAVE_X86_SIMD)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace rfb;
+
+//
+// The conversions to fewer bits use the same rounding as the generic
+// code, i.e. (v * max + 128) / 255, where the division is done as
+// (x + 1 + (x >> 8)) >> 8. That is exact for any x below 65535.
+//
+// The conversions to more bits should give floor(v * 255 / max),
+// which is done as ((v << upShift) * upMul) >> 16. With the constants
+// from prepareSIMDConversion() this is exact for all of v's values.
+//
+
+#if defined(HAVE_X86_SIMD)
+
+__attribute__((target("ssse3")))
+static int swizzleSSSE3(rdr::U8* dst, const rdr::U8* src, int pixels,
+                        const SIMDConversion& conv)
+{
+  __m128i mask;
+  int i;
+
+  mask = _mm_loadu_si128((const __m128i*)conv.swizzle);
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m128i a, b;
+
+    a = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    b = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(a, mask));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_shuffle_epi8(b, mask));
+  }
+
+  return i;
+}
+
+__attribute__((target("ssse3")))
+static int from888SSSE3(rdr::U8* dst, int bpp, const rdr::U8* src,
+                        int pixels, const SIMDConversion& conv)
+{
+  __m128i extract[3], mul[3], shift[3];
+  __m128i round, one, swap;
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    extract[c] = _mm_loadu_si128((const __m128i*)conv.extract[c]);
+    mul[c] = _mm_set1_epi16(conv.max[c]);
+    shift[c] = _mm_cvtsi32_si128(conv.shift[c]);
+  }
+
+  round = _mm_set1_epi16(128);
+  one = _mm_set1_epi16(1);
+  swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                       9, 8, 11, 10, 13, 12, 15, 14);
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m128i a, b, pix;
+
+    a = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    b = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+
+    pix = _mm_setzero_si128();
+    for (int c = 0; c < 3; c++) {
+      __m128i v;
+
+      // Get the component of each pixel in to a 16 bit lane
+      v = _mm_or_si128(_mm_shuffle_epi8(a, extract[c]),
+                       _mm_slli_si128(_mm_shuffle_epi8(b, extract[c]), 8));
+
+      v = _mm_add_epi16(_mm_mullo_epi16(v, mul[c]), round);
+      v = _mm_add_epi16(_mm_add_epi16(v, one), _mm_srli_epi16(v, 8));
+      v = _mm_srli_epi16(v, 8);
+
+      pix = _mm_or_si128(pix, _mm_sll_epi16(v, shift[c]));
+    }
+
+    if (bpp == 16) {
+      if (conv.swap)
+        pix = _mm_shuffle_epi8(pix, swap);
+      _mm_storeu_si128((__m128i*)(dst + i * 2), pix);
+    } else {
+      _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(pix, pix));
+    }
+  }
+
+  return i;
+}
+
+__attribute__((target("ssse3")))
+static int to888SSSE3(rdr::U8* dst, const rdr::U8* src, int bpp,
+                      int pixels, const SIMDConversion& conv)
+{
+  __m128i max[3], shift[3], upMul[3], upShift[3];
+  __m128i place, swap;
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    max[c] = _mm_set1_epi16(conv.max[c]);
+    shift[c] = _mm_cvtsi32_si128(conv.shift[c]);
+    upMul[c] = _mm_set1_epi16(conv.upMul[c]);
+    upShift[c] = _mm_cvtsi32_si128(conv.upShift[c]);
+  }
+
+  place = _mm_loadu_si128((const __m128i*)conv.place);
+  swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                       9, 8, 11, 10, 13, 12, 15, 14);
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    __m128i pix, v[3], rg, lo, hi;
+
+    if (bpp == 16) {
+      pix = _mm_loadu_si128((const __m128i*)(src + i * 2));
+      if (conv.swap)
+        pix = _mm_shuffle_epi8(pix, swap);
+    } else {
+      pix = _mm_loadl_epi64((const __m128i*)(src + i));
+      pix = _mm_unpacklo_epi8(pix, _mm_setzero_si128());
+    }
+
+    for (int c = 0; c < 3; c++) {
+      v[c] = _mm_and_si128(_mm_srl_epi16(pix, shift[c]), max[c]);
+      v[c] = _mm_mulhi_epu16(_mm_sll_epi16(v[c], upShift[c]), upMul[c]);
+    }
+
+    // Interleave to red, green, blue, zero and then move them in to
+    // the correct place
+    rg = _mm_or_si128(v[0], _mm_slli_epi16(v[1], 8));
+    lo = _mm_unpacklo_epi16(rg, v[2]);
+    hi = _mm_unpackhi_epi16(rg, v[2]);
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(lo, place));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_shuffle_epi8(hi, place));
+  }
+
+  return i;
+}
+
+__attribute__((target("ssse3")))
+static int runLengthSSSE3(const rdr::U8* src, int bpp, int pixels,
+                          rdr::U32 colour)
+{
+  __m128i match;
+  int shift, bytes, i;
+
+  if (bpp == 32)
+    match = _mm_set1_epi32(colour);
+  else if (bpp == 16)
+    match = _mm_set1_epi16(colour);
+  else
+    match = _mm_set1_epi8(colour);
+
+  shift = bpp == 32 ? 2 : (bpp == 16 ? 1 : 0);
+  bytes = pixels << shift;
+
+  for (i = 0; i + 16 <= bytes; i += 16) {
+    unsigned mask;
+
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + i)),
+                                            match));
+    if (mask != 0xffff)
+      return (i + __builtin_ctz(~mask)) >> shift;
+  }
+
+  return i >> shift;
+}
+
+__attribute__((target("avx2")))
+static int swizzleAVX2(rdr::U8* dst, const rdr::U8* src, int pixels,
+                       const SIMDConversion& conv)
+{
+  __m256i mask;
+  int i;
+
+  mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)conv.swizzle));
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    __m256i a, b;
+
+    a = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+    b = _mm256_loadu_si256((const __m256i*)(src + i * 4 + 32));
+
+    _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(a, mask));
+    _mm256_storeu_si256((__m256i*)(dst + i * 4 + 32), _mm256_shuffle_epi8(b, mask));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int from888AVX2(rdr::U8* dst, int bpp, const rdr::U8* src,
+                       int pixels, const SIMDConversion& conv)
+{
+  __m256i extract[3], mul[3];
+  __m128i shift[3];
+  __m256i round, one, swap;
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    extract[c] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)conv.extract[c]));
+    mul[c] = _mm256_set1_epi16(conv.max[c]);
+    shift[c] = _mm_cvtsi32_si128(conv.shift[c]);
+  }
+
+  round = _mm256_set1_epi16(128);
+  one = _mm256_set1_epi16(1);
+  swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                          9, 8, 11, 10, 13, 12, 15, 14,
+                          1, 0, 3, 2, 5, 4, 7, 6,
+                          9, 8, 11, 10, 13, 12, 15, 14);
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    __m256i a, b, pix;
+
+    a = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+    b = _mm256_loadu_si256((const __m256i*)(src + i * 4 + 32));
+
+    pix = _mm256_setzero_si256();
+    for (int c = 0; c < 3; c++) {
+      __m256i v;
+
+      // Shuffles stay within each 128 bit half, so this gives us
+      // pixels 0-3, 8-11, 4-7 and 12-15
+      v = _mm256_or_si256(_mm256_shuffle_epi8(a, extract[c]),
+                          _mm256_slli_si256(_mm256_shuffle_epi8(b, extract[c]), 8));
+
+      v = _mm256_add_epi16(_mm256_mullo_epi16(v, mul[c]), round);
+      v = _mm256_add_epi16(_mm256_add_epi16(v, one), _mm256_srli_epi16(v, 8));
+      v = _mm256_srli_epi16(v, 8);
+
+      pix = _mm256_or_si256(pix, _mm256_sll_epi16(v, shift[c]));
+    }
+
+    pix = _mm256_permute4x64_epi64(pix, 0xd8);
+
+    if (bpp == 16) {
+      if (conv.swap)
+        pix = _mm256_shuffle_epi8(pix, swap);
+      _mm256_storeu_si256((__m256i*)(dst + i * 2), pix);
+    } else {
+      pix = _mm256_packus_epi16(pix, pix);
+      pix = _mm256_permute4x64_epi64(pix, 0x08);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(pix));
+    }
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int to888AVX2(rdr::U8* dst, const rdr::U8* src, int bpp,
+                     int pixels, const SIMDConversion& conv)
+{
+  __m256i max[3], upMul[3];
+  __m128i shift[3], upShift[3];
+  __m256i place, swap;
+  int i;
+
+  for (int c = 0; c < 3; c++) {
+    max[c] = _mm256_set1_epi16(conv.max[c]);
+    shift[c] = _mm_cvtsi32_si128(conv.shift[c]);
+    upMul[c] = _mm256_set1_epi16(conv.upMul[c]);
+    upShift[c] = _mm_cvtsi32_si128(conv.upShift[c]);
+  }
+
+  place = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)conv.place));
+  swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                          9, 8, 11, 10, 13, 12, 15, 14,
+                          1, 0, 3, 2, 5, 4, 7, 6,
+                          9, 8, 11, 10, 13, 12, 15, 14);
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    __m256i pix, v[3], rg, lo, hi;
+
+    if (bpp == 16) {
+      pix = _mm256_loadu_si256((const __m256i*)(src + i * 2));
+      if (conv.swap)
+        pix = _mm256_shuffle_epi8(pix, swap);
+    } else {
+      pix = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src + i)));
+    }
+
+    for (int c = 0; c < 3; c++) {
+      v[c] = _mm256_and_si256(_mm256_srl_epi16(pix, shift[c]), max[c]);
+      v[c] = _mm256_mulhi_epu16(_mm256_sll_epi16(v[c], upShift[c]), upMul[c]);
+    }
+
+    // Unpacking also stays within each half, giving pixels 0-3 and
+    // 8-11 in lo, and 4-7 and 12-15 in hi
+    rg = _mm256_or_si256(v[0], _mm256_slli_epi16(v[1], 8));
+    lo = _mm256_unpacklo_epi16(rg, v[2]);
+    hi = _mm256_unpackhi_epi16(rg, v[2]);
+
+    _mm256_storeu_si256((__m256i*)(dst + i * 4),
+                        _mm256_shuffle_epi8(_mm256_permute2x128_si256(lo, hi, 0x20), place));
+    _mm256_storeu_si256((__m256i*)(dst + i * 4 + 32),
+                        _mm256_shuffle_epi8(_mm256_permute2x128_si256(lo, hi, 0x31), place));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int runLengthAVX2(const rdr::U8* src, int bpp, int pixels,
+                         rdr::U32 colour)
+{
+  __m256i match;
+  int shift, bytes, i;
+
+  if (bpp == 32)
+    match = _mm256_set1_epi32(colour);
+  else if (bpp == 16)
+    match = _mm256_set1_epi16(colour);
+  else
+    match = _mm256_set1_epi8(colour);
+
+  shift = bpp == 32 ? 2 : (bpp == 16 ? 1 : 0);
+  bytes = pixels << shift;
+
+  for (i = 0; i + 32 <= bytes; i += 32) {
+    unsigned mask;
+
+    mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src + i)),
+                                                  match));
+    if (mask != 0xffffffff)
+      return (i + __builtin_ctz(~mask)) >> shift;
+  }
+
+  return i >> shift;
+}
+
+#elif defined(__aarch64__)
+
+static int swizzleNEON(rdr::U8* dst, const rdr::U8* src, int pixels,
+                       const SIMDConversion& conv)
+{
+  uint8x16_t mask;
+  int i;
+
+  mask = vld1q_u8(conv.swizzle);
+
+  for (i = 0; i + 4 <= pixels; i += 4)
+    vst1q_u8(dst + i * 4, vqtbl1q_u8(vld1q_u8(src + i * 4), mask));
+
+  return i;
+}
+
+static int from888NEON(rdr::U8* dst, int bpp, const rdr::U8* src,
+                       int pixels, const SIMDConversion& conv)
+{
+  uint16x8_t round, one;
+  int i;
+
+  round = vdupq_n_u16(128);
+  one = vdupq_n_u16(1);
+
+  for (i = 0; i + 16 <= pixels; i += 16) {
+    uint8x16x4_t in;
+    uint16x8_t lo, hi;
+
+    // This splits the pixels in to one vector per byte
+    in = vld4q_u8(src + i * 4);
+
+    lo = vdupq_n_u16(0);
+    hi = vdupq_n_u16(0);
+    for (int c = 0; c < 3; c++) {
+      uint8x16_t comp;
+      uint8x8_t mul;
+      int16x8_t shift;
+      uint16x8_t vlo, vhi;
+
+      comp = in.val[conv.offsets[c]];
+      mul = vdup_n_u8(conv.max[c]);
+      shift = vdupq_n_s16(conv.shift[c]);
+
+      vlo = vmlal_u8(round, vget_low_u8(comp), mul);
+      vhi = vmlal_u8(round, vget_high_u8(comp), mul);
+      vlo = vshrq_n_u16(vaddq_u16(vaddq_u16(vlo, one), vshrq_n_u16(vlo, 8)), 8);
+      vhi = vshrq_n_u16(vaddq_u16(vaddq_u16(vhi, one), vshrq_n_u16(vhi, 8)), 8);
+
+      lo = vorrq_u16(lo, vshlq_u16(vlo, shift));
+      hi = vorrq_u16(hi, vshlq_u16(vhi, shift));
+    }
+
+    if (bpp == 16) {
+      uint8x16_t blo, bhi;
+
+      blo = vreinterpretq_u8_u16(lo);
+      bhi = vreinterpretq_u8_u16(hi);
+      if (conv.swap) {
+        blo = vrev16q_u8(blo);
+        bhi = vrev16q_u8(bhi);
+      }
+
+      vst1q_u8(dst + i * 2, blo);
+      vst1q_u8(dst + i * 2 + 16, bhi);
+    } else {
+      vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+  }
+
+  return i;
+}
+
+static int to888NEON(rdr::U8* dst, const rdr::U8* src, int bpp,
+                     int pixels, const SIMDConversion& conv)
+{
+  int i;
+
+  for (i = 0; i + 8 <= pixels; i += 8) {
+    uint16x8_t pix;
+    uint8x8x4_t out;
+
+    if (bpp == 16) {
+      uint8x16_t bytes;
+
+      bytes = vld1q_u8(src + i * 2);
+      if (conv.swap)
+        bytes = vrev16q_u8(bytes);
+      pix = vreinterpretq_u16_u8(bytes);
+    } else {
+      pix = vmovl_u8(vld1_u8(src + i));
+    }
+
+    for (int c = 0; c < 3; c++) {
+      uint16x8_t v;
+      uint16x4_t mul;
+      uint32x4_t lo, hi;
+
+      v = vshlq_u16(pix, vdupq_n_s16(-conv.shift[c]));
+      v = vandq_u16(v, vdupq_n_u16(conv.max[c]));
+      v = vshlq_u16(v, vdupq_n_s16(conv.upShift[c]));
+
+      mul = vdup_n_u16(conv.upMul[c]);
+      lo = vmull_u16(vget_low_u16(v), mul);
+      hi = vmull_u16(vget_high_u16(v), mul);
+
+      v = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+      out.val[conv.offsets[c]] = vmovn_u16(v);
+    }
+    out.val[conv.offsets[3]] = vdup_n_u8(0);
+
+    // And this puts them back together again
+    vst4_u8(dst + i * 4, out);
+  }
+
+  return i;
+}
+
+static int runLengthNEON(const rdr::U8* src, int bpp, int pixels,
+                         rdr::U32 colour)
+{
+  uint8x16_t match;
+  int shift, bytes, i;
+
+  if (bpp == 32)
+    match = vreinterpretq_u8_u32(vdupq_n_u32(colour));
+  else if (bpp == 16)
+    match = vreinterpretq_u8_u16(vdupq_n_u16(colour));
+  else
+    match = vdupq_n_u8(colour);
+
+  shift = bpp == 32 ? 2 : (bpp == 16 ? 1 : 0);
+  bytes = pixels << shift;
+
+  for (i = 0; i + 16 <= bytes; i += 16) {
+    uint8x16_t eq;
+    uint64_t mask;
+
+    eq = vceqq_u8(vld1q_u8(src + i), match);
+    if (vminvq_u8(eq) == 0xff)
+      continue;
+
+    // Narrow to four bits per byte to find the first difference
+    mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return (i + __builtin_ctzll(~mask) / 4) >> shift;
+  }
+
+  return i >> shift;
+}
+
+#endif
+
+static bool isSupported(SIMDLevel level)
+{
+  switch (level) {
+  case simdNone:
+    return true;
+#if defined(HAVE_X86_SIMD)
+  case simdSSSE3:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+  case simdAVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(__aarch64__)
+  case simdNEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+static SIMDLevel bestLevel()
+{
+  // The NEON code hasn't been verified on real hardware yet, so it is
+  // only used if explicitly asked for with setSIMDLevel()
+  static const SIMDLevel levels[] = { simdAVX2, simdSSSE3 };
+
+  for (size_t i = 0; i < sizeof(levels)/sizeof(levels[0]); i++) {
+    if (isSupported(levels[i]))
+      return levels[i];
+  }
+
+  return simdNone;
+}
+
+// Picked by a static initialiser, so that it is settled before any
+// threads are started. PixelFormat might be used by other static
+// initialisers though, so those set it up on first use instead.
+static int currentLevel = -1;
+
+static struct SIMDLevelInit {
+  SIMDLevelInit() { getSIMDLevel(); }
+} simdLevelInit;
+
+SIMDLevel rfb::getSIMDLevel()
+{
+  if (currentLevel == -1)
+    currentLevel = bestLevel();
+
+  return (SIMDLevel)currentLevel;
+}
+
+bool rfb::setSIMDLevel(SIMDLevel level)
+{
+  if (!isSupported(level))
+    return false;
+
+  currentLevel = level;
+
+  return true;
+}
+
+const char* rfb::simdLevelName(SIMDLevel level)
+{
+  switch (level) {
+  case simdNone:
+    return "None";
+  case simdSSSE3:
+    return "SSSE3";
+  case simdAVX2:
+    return "AVX2";
+  case simdNEON:
+    return "NEON";
+  }
+
+  return "Unknown";
+}
+
+bool rfb::prepareSIMDSwizzle(SIMDConversion* conv)
+{
+  if (getSIMDLevel() == simdNone)
+    return false;
+
+  for (int p = 0; p < 4; p++) {
+    for (int b = 0; b < 4; b++)
+      conv->swizzle[p * 4 + b] = p * 4 + conv->order[b];
+  }
+
+  return true;
+}
+
+bool rfb::prepareSIMDConversion(SIMDConversion* conv)
+{
+  if (getSIMDLevel() == simdNone)
+    return false;
+
+  for (int c = 0; c < 3; c++) {
+    int bits;
+
+    if (conv->max[c] < 1)
+      return false;
+
+    bits = 0;
+    while ((1 << bits) <= conv->max[c])
+      bits++;
+
+    // Pushing the value up to the 9th bit before multiplying is what
+    // keeps enough precision for this to be exact
+    conv->upShift[c] = 9 - bits;
+    conv->upMul[c] = ((255 << (7 + bits)) + conv->max[c] - 1) / conv->max[c];
+
+    // Pixel p's component in to the 16 bit lane p, leaving the upper
+    // four lanes empty
+    for (int p = 0; p < 4; p++) {
+      conv->extract[c][p * 2] = p * 4 + conv->offsets[c];
+      conv->extract[c][p * 2 + 1] = 0x80;
+    }
+    for (int b = 8; b < 16; b++)
+      conv->extract[c][b] = 0x80;
+  }
+
+  // From red, green, blue and zero to where they should be
+  for (int p = 0; p < 4; p++) {
+    for (int c = 0; c < 4; c++)
+      conv->place[p * 4 + conv->offsets[c]] = p * 4 + c;
+  }
+
+  return true;
+}
+
+int rfb::simdSwizzle888(rdr::U8* dst, const rdr::U8* src, int pixels,
+                        const SIMDConversion& conv)
+{
+  switch (getSIMDLevel()) {
+#if defined(HAVE_X86_SIMD)
+  case simdSSSE3:
+    return swizzleSSSE3(dst, src, pixels, conv);
+  case simdAVX2:
+    return swizzleAVX2(dst, src, pixels, conv);
+#elif defined(__aarch64__)
+  case simdNEON:
+    return swizzleNEON(dst, src, pixels, conv);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::simdFrom888(rdr::U8* dst, int bpp, const rdr::U8* src, int pixels,
+                     const SIMDConversion& conv)
+{
+  if ((bpp != 8) && (bpp != 16))
+    return 0;
+
+  switch (getSIMDLevel()) {
+#if defined(HAVE_X86_SIMD)
+  case simdSSSE3:
+    return from888SSSE3(dst, bpp, src, pixels, conv);
+  case simdAVX2:
+    return from888AVX2(dst, bpp, src, pixels, conv);
+#elif defined(__aarch64__)
+  case simdNEON:
+    return from888NEON(dst, bpp, src, pixels, conv);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::simdTo888(rdr::U8* dst, const rdr::U8* src, int bpp, int pixels,
+                   const SIMDConversion& conv)
+{
+  if ((bpp != 8) && (bpp != 16))
+    return 0;
+
+  switch (getSIMDLevel()) {
+#if defined(HAVE_X86_SIMD)
+  case simdSSSE3:
+    return to888SSSE3(dst, src, bpp, pixels, conv);
+  case simdAVX2:
+    return to888AVX2(dst, src, bpp, pixels, conv);
+#elif defined(__aarch64__)
+  case simdNEON:
+    return to888NEON(dst, src, bpp, pixels, conv);
+#endif
+  default:
+    return 0;
+  }
+}
+
+int rfb::simdRunLength(const rdr::U8* src, int bpp, int pixels,
+                       rdr::U32 colour)
+{
+  switch (getSIMDLevel()) {
+#if defined(HAVE_X86_SIMD)
+  case simdSSSE3:
+    return runLengthSSSE3(src, bpp, pixels, colour);
+  case simdAVX2:
+    return runLengthAVX2(src, bpp, pixels, colour);
+#elif defined(__aarch64__)
+  case simdNEON:
+    return runLengthNEON(src, bpp, pixels, colour);
+#endif
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,94 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+// -=- PixelFormatSIMD.h - vectorised pixel format conversion
+//
+// PixelFormat uses these for the most common conversions: shuffling
+// bytes between 888 formats, and going between 888 and 8 or 16 bpp
+// formats. The best implementation the CPU supports is picked at
+// runtime. They give exactly the same result as the generic code.
+//
+// There is also a scan for runs of identical pixels, which the
+// EncodeManager uses when counting colours.
+
+#ifndef __RFB_PIXELFORMATSIMD_H__
+#define __RFB_PIXELFORMATSIMD_H__
+
+#include <rdr/types.h>
+
+namespace rfb {
+
+  enum SIMDLevel { simdNone, simdSSSE3, simdAVX2, simdNEON };
+
+  // getSIMDLevel() returns the implementation currently in use, which
+  // is picked at startup. It can be changed with setSIMDLevel() for
+  // testing and benchmarking, which returns false if the CPU doesn't
+  // support it. That must only be done before any threads that might
+  // convert pixels have been started.
+  SIMDLevel getSIMDLevel();
+  bool setSIMDLevel(SIMDLevel level);
+  const char* simdLevelName(SIMDLevel level);
+
+  struct SIMDConversion {
+    // Where red, green, blue and the padding are in the 888 format,
+    // counted in bytes from the start of the pixel in memory
+    int offsets[4];
+
+    // For 888 to 888, which source byte each destination byte is
+    // copied from
+    int order[4];
+
+    // For 888 to or from 8 or 16 bpp, the components of the other
+    // format and if it needs to be byte swapped
+    int max[3];
+    int shift[3];
+    bool swap;
+
+    // Filled in by prepareSIMDSwizzle() or prepareSIMDConversion()
+    rdr::U8 swizzle[16];
+    rdr::U8 extract[3][16];
+    rdr::U8 place[16];
+    rdr::U16 upShift[3];
+    rdr::U16 upMul[3];
+  };
+
+  // prepareSIMDSwizzle() and prepareSIMDConversion() set up the
+  // constants the vectorised code needs, the former for 888 to 888 and
+  // the latter for everything else. They return false if there is no
+  // point in calling the vectorised code.
+  bool prepareSIMDSwizzle(SIMDConversion* conv);
+  bool prepareSIMDConversion(SIMDConversion* conv);
+
+  // These convert as many pixels from the start of a row as they can
+  // efficiently handle and return how many that was, leaving the rest
+  // for the caller.
+  int simdSwizzle888(rdr::U8* dst, const rdr::U8* src, int pixels,
+                     const SIMDConversion& conv);
+  int simdFrom888(rdr::U8* dst, int bpp, const rdr::U8* src, int pixels,
+                  const SIMDConversion& conv);
+  int simdTo888(rdr::U8* dst, const rdr::U8* src, int bpp, int pixels,
+                const SIMDConversion& conv);
+
+  // simdRunLength() counts how many pixels from the start of a row are
+  // equal to colour. Like the conversions it may stop short of the end
+  // of the row, so the caller has to check the remaining pixels.
+  int simdRunLength(const rdr::U8* src, int bpp, int pixels,
+                    rdr::U32 colour);
+}
+
+#endif
@@ -0,0 +1,164 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This code picks the JPEG quality and zlib compression levels for a
+ * connection based on how busy the link and the encoder are.
+ *
+ * Updates are measured over a window of a few round trips. For each
+ * window we estimate how long the data took to send using the
+ * bandwidth estimate from the congestion control, and add the time
+ * spent encoding. If that is most of the window, or if the average
+ * update takes longer than the latency budget, we are too slow and
+ * need to produce less data or spend less time producing it. If we are
+ * mostly idle then there is room for better quality.
+ *
+ * The quality level also controls chroma subsampling, see
+ * TightJPEGEncoder.
+ */
+
+#include <rfb/LogWriter.h>
+#include <rfb/QualityController.h>
+#include <rfb/util.h>
+
+using namespace rfb;
+
+static LogWriter vlog("QualityController");
+
+// Shortest window we measure over, in ms
+static const unsigned MinimumWindow = 250;
+// Window length in round trips, so each adjustment can be seen in the
+// next measurement
+static const unsigned WindowRTTs = 4;
+
+// Fraction of the window we can be busy before backing off, and the
+// fraction under which we try to improve quality
+static const double HighUtilisation = 0.9;
+static const double LowUtilisation = 0.5;
+
+static const int MinQualityLevel = 0;
+static const int MaxQualityLevel = 9;
+static const int MinCompressLevel = 1;
+static const int MaxCompressLevel = 6;
+
+QualityController::QualityController()
+  : latencyBudget(100)
+{
+  reset(8, 2);
+}
+
+QualityController::~QualityController()
+{
+}
+
+void QualityController::reset(int qualityLevel_, int compressLevel_)
+{
+  qualityLevel = __rfbmin(__rfbmax(qualityLevel_, MinQualityLevel),
+                          MaxQualityLevel);
+  compressLevel = __rfbmin(__rfbmax(compressLevel_, MinCompressLevel),
+                           MaxCompressLevel);
+  defaultCompressLevel = compressLevel;
+
+  startWindow();
+}
+
+void QualityController::setLatencyBudget(unsigned ms)
+{
+  latencyBudget = ms;
+}
+
+void QualityController::updateSent(size_t bytes_, double encodeTime_)
+{
+  updates++;
+  bytes += bytes_;
+  encodeTime += encodeTime_;
+}
+
+bool QualityController::adjust(size_t bandwidth, unsigned rtt)
+{
+  unsigned elapsed;
+  double sendTime, encodeTimeMs, busy, utilisation, perUpdate;
+  bool linkBound;
+  int oldQuality, oldCompress;
+
+  elapsed = msSince(&windowStart);
+  if (elapsed < __rfbmax(MinimumWindow, rtt * WindowRTTs))
+    return false;
+
+  // Nothing to learn from an idle period
+  if ((updates == 0) || (bandwidth == 0)) {
+    startWindow();
+    return false;
+  }
+
+  sendTime = (double)bytes * 1000.0 / bandwidth;
+  encodeTimeMs = encodeTime * 1000.0;
+  busy = sendTime + encodeTimeMs;
+
+  utilisation = busy / elapsed;
+  perUpdate = busy / updates;
+
+  // Which one is holding us back?
+  linkBound = sendTime >= encodeTimeMs;
+
+  oldQuality = qualityLevel;
+  oldCompress = compressLevel;
+
+  if ((utilisation > HighUtilisation) || (perUpdate > latencyBudget)) {
+    if (linkBound) {
+      // Compress harder if we have the CPU to spare, as that doesn't
+      // cost any quality
+      if ((compressLevel < MaxCompressLevel) &&
+          (encodeTimeMs < elapsed * LowUtilisation))
+        compressLevel++;
+      else if (qualityLevel > MinQualityLevel)
+        qualityLevel--;
+    } else {
+      if (compressLevel > MinCompressLevel)
+        compressLevel--;
+      else if (qualityLevel > MinQualityLevel)
+        qualityLevel--;
+    }
+  } else if ((utilisation < LowUtilisation) &&
+             (perUpdate < latencyBudget / 2)) {
+    if (qualityLevel < MaxQualityLevel)
+      qualityLevel++;
+    else if (compressLevel < defaultCompressLevel)
+      compressLevel++;
+  }
+
+  startWindow();
+
+  if ((qualityLevel == oldQuality) && (compressLevel == oldCompress))
+    return false;
+
+  vlog.debug("%s bound, %d%% busy, %.1f ms per update: quality level %d, "
+             "compression level %d", linkBound ? "Link" : "Encoder",
+             (int)(utilisation * 100), perUpdate, qualityLevel,
+             compressLevel);
+
+  return true;
+}
+
+void QualityController::startWindow()
+{
+  gettimeofday(&windowStart, NULL);
+  updates = 0;
+  bytes = 0;
+  encodeTime = 0.0;
+}
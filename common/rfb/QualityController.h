@@ -0,0 +1,68 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __RFB_QUALITYCONTROLLER_H__
+#define __RFB_QUALITYCONTROLLER_H__
+
+#include <stddef.h>
+#include <sys/time.h>
+
+namespace rfb {
+  class QualityController {
+  public:
+    QualityController();
+    ~QualityController();
+
+    // reset() starts over from the given levels, forgetting anything
+    // measured so far.
+    void reset(int qualityLevel, int compressLevel);
+
+    // setLatencyBudget() sets the maximum time in milliseconds that
+    // each update should take to encode and send.
+    void setLatencyBudget(unsigned ms);
+
+    // updateSent() must be called after each update with the number of
+    // bytes written and the number of seconds it took to encode them.
+    void updateSent(size_t bytes, double encodeTime);
+
+    // adjust() reevaluates the levels given the current bandwidth (in
+    // bytes per second) and round trip time (in milliseconds). Returns
+    // true if the levels have changed.
+    bool adjust(size_t bandwidth, unsigned rtt);
+
+    int getQualityLevel() const { return qualityLevel; }
+    int getCompressLevel() const { return compressLevel; }
+
+  private:
+    void startWindow();
+
+  private:
+    int qualityLevel;
+    int compressLevel;
+    int defaultCompressLevel;
+
+    unsigned latencyBudget;
+
+    struct timeval windowStart;
+    unsigned updates;
+    unsigned long long bytes;
+    double encodeTime;
+  };
+}
+
+#endif
@@ -287,6 +287,11 @@ bool SConnection::accessCheck(AccessRights ar) const
   return (accessRights & ar) == ar;
 }
 
+bool SConnection::sendFd(int fd)
+{
+  return false;
+}
+
 void SConnection::setEncodings(int nEncodings, const rdr::S32* encodings)
 {
   int i;
@@ -370,6 +375,11 @@ void SConnection::supportsQEMUKeyEvent()
   writer()->writeQEMUKeyEvent();
 }
 
+void SConnection::supportsTightParallel()
+{
+  writer()->writeTightParallel();
+}
+
 void SConnection::versionReceived()
 {
 }
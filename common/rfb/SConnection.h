@@ -90,6 +90,7 @@ namespace rfb {
                                         const rdr::U8* const* data);
 
     virtual void supportsQEMUKeyEvent();
+    virtual void supportsTightParallel();
 
 
     // Methods to be overridden in a derived class
@@ -192,6 +193,11 @@ namespace rfb {
     virtual void setAccessRights(AccessRights ar);
     virtual bool accessCheck(AccessRights ar) const;
 
+    // sendFd() passes a file descriptor to the client along with the
+    // data written next. It returns false if the connection can't do
+    // that.
+    virtual bool sendFd(int fd);
+
     // authenticated() returns true if the client has authenticated
     // successfully.
     bool authenticated() { return (state_ == RFBSTATE_INITIALISATION ||
@@ -43,12 +43,14 @@ void SMsgHandler::setPixelFormat(const PixelFormat& pf)
 void SMsgHandler::setEncodings(int nEncodings, const rdr::S32* encodings)
 {
   bool firstFence, firstContinuousUpdates, firstLEDState,
-       firstQEMUKeyEvent;
+       firstQEMUKeyEvent, firstServerScale, firstTightParallel;
 
   firstFence = !client.supportsFence();
   firstContinuousUpdates = !client.supportsContinuousUpdates();
   firstLEDState = !client.supportsLEDState();
   firstQEMUKeyEvent = !client.supportsEncoding(pseudoEncodingQEMUKeyEvent);
+  firstServerScale = !client.supportsEncoding(pseudoEncodingServerScale);
+  firstTightParallel = !client.supportsEncoding(pseudoEncodingTightParallel);
 
   client.setEncodings(nEncodings, encodings);
 
@@ -62,6 +64,14 @@ void SMsgHandler::setEncodings(int nEncodings, const rdr::S32* encodings)
     supportsLEDState();
   if (client.supportsEncoding(pseudoEncodingQEMUKeyEvent) && firstQEMUKeyEvent)
     supportsQEMUKeyEvent();
+  if (client.supportsEncoding(pseudoEncodingServerScale) && firstServerScale)
+    supportsServerScale();
+  if (client.supportsEncoding(pseudoEncodingTightParallel) && firstTightParallel)
+    supportsTightParallel();
+}
+
+void SMsgHandler::setScale(int scale)
+{
 }
 
 void SMsgHandler::handleClipboardCaps(rdr::U32 flags, const rdr::U32* lengths)
@@ -106,3 +116,11 @@ void SMsgHandler::supportsLEDState()
 void SMsgHandler::supportsQEMUKeyEvent()
 {
 }
+
+void SMsgHandler::supportsServerScale()
+{
+}
+
+void SMsgHandler::supportsTightParallel()
+{
+}
@@ -53,6 +53,7 @@ namespace rfb {
     virtual void fence(rdr::U32 flags, unsigned len, const char data[]) = 0;
     virtual void enableContinuousUpdates(bool enable,
                                          int x, int y, int w, int h) = 0;
+    virtual void setScale(int scale);
 
     virtual void handleClipboardCaps(rdr::U32 flags,
                                      const rdr::U32* lengths);
@@ -94,6 +95,18 @@ namespace rfb {
     // handler will send a pseudo-rect back, signalling server support.
     virtual void supportsQEMUKeyEvent();
 
+    // supportsServerScale() is called the first time we detect that
+    // the client wants the server scaling extension. A pseudo-rect
+    // should be sent back if the server is willing to scale the
+    // framebuffer for the client.
+    virtual void supportsServerScale();
+
+    // supportsTightParallel() is called the first time we detect that
+    // the client wants Tight rects that can be decoded independently.
+    // The default handler will send a pseudo-rect back, signalling
+    // server support.
+    virtual void supportsTightParallel();
+
     ClientParams client;
   };
 }
@@ -83,6 +83,9 @@ void SMsgReader::readMsg()
   case msgTypeClientCutText:
     readClientCutText();
     break;
+  case msgTypeSetScale:
+    readSetScale();
+    break;
   case msgTypeQEMUClientMessage:
     readQEMUMessage();
     break;
@@ -321,6 +324,13 @@ void SMsgReader::readExtendedClipboard(rdr::S32 len)
   }
 }
 
+void SMsgReader::readSetScale()
+{
+  int scale = is->readU8();
+  is->skip(2);
+  handler->setScale(scale);
+}
+
 void SMsgReader::readQEMUMessage()
 {
   int subType = is->readU8();
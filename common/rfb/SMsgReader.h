@@ -54,6 +54,7 @@ namespace rfb {
     void readKeyEvent();
     void readPointerEvent();
     void readClientCutText();
+    void readSetScale();
     void readExtendedClipboard(rdr::S32 len);
 
     void readQEMUMessage();
@@ -33,6 +33,7 @@
 #include <rfb/SMsgWriter.h>
 #include <rfb/LogWriter.h>
 #include <rfb/ledStates.h>
+#include <rfb/SharedFramebuffer.h>
 
 using namespace rfb;
 
@@ -42,7 +43,8 @@ SMsgWriter::SMsgWriter(ClientParams* client_, rdr::OutStream* os_)
   : client(client_), os(os_),
     nRectsInUpdate(0), nRectsInHeader(0),
     needSetDesktopName(false), needCursor(false),
-    needLEDState(false), needQEMUKeyEvent(false)
+    needLEDState(false), needQEMUKeyEvent(false), needServerScale(false),
+    needTightParallel(false)
 {
 }
 
@@ -287,6 +289,22 @@ void SMsgWriter::writeQEMUKeyEvent()
   needQEMUKeyEvent = true;
 }
 
+void SMsgWriter::writeServerScale()
+{
+  if (!client->supportsEncoding(pseudoEncodingServerScale))
+    throw Exception("Client does not support server scaling");
+
+  needServerScale = true;
+}
+
+void SMsgWriter::writeTightParallel()
+{
+  if (!client->supportsEncoding(pseudoEncodingTightParallel))
+    throw Exception("Client does not support parallel Tight decoding");
+
+  needTightParallel = true;
+}
+
 bool SMsgWriter::needFakeUpdate()
 {
   if (needSetDesktopName)
@@ -297,6 +315,10 @@ bool SMsgWriter::needFakeUpdate()
     return true;
   if (needQEMUKeyEvent)
     return true;
+  if (needServerScale)
+    return true;
+  if (needTightParallel)
+    return true;
   if (needNoDataUpdate())
     return true;
 
@@ -343,6 +365,10 @@ void SMsgWriter::writeFramebufferUpdateStart(int nRects)
       nRects++;
     if (needQEMUKeyEvent)
       nRects++;
+    if (needServerScale)
+      nRects++;
+    if (needTightParallel)
+      nRects++;
   }
 
   os->writeU16(nRects);
@@ -382,6 +408,41 @@ void SMsgWriter::writeCopyRect(const Rect& r, int srcX, int srcY)
   endRect();
 }
 
+void SMsgWriter::writeContentCacheRect(const Rect& r, int op, rdr::U32 id)
+{
+  if (!client->supportsContentCache())
+    throw Exception("Client does not support the content cache");
+
+  startRect(r, pseudoEncodingContentCache);
+  os->writeU8(op);
+  os->writeU32(id);
+  endRect();
+}
+
+void SMsgWriter::writeSharedFramebufferAttach(int width, int height,
+                                              const PixelFormat& pf,
+                                              int stride)
+{
+  if (!client->supportsSharedFramebuffer())
+    throw Exception("Client does not support a shared framebuffer");
+
+  startRect(Rect(0, 0, width, height), pseudoEncodingSharedFramebuffer);
+  os->writeU8(sharedFramebufferAttach);
+  pf.write(os);
+  os->writeU32(stride);
+  endRect();
+}
+
+void SMsgWriter::writeSharedFramebufferRect(const Rect& r)
+{
+  if (!client->supportsSharedFramebuffer())
+    throw Exception("Client does not support a shared framebuffer");
+
+  startRect(r, pseudoEncodingSharedFramebuffer);
+  os->writeU8(sharedFramebufferUpdate);
+  endRect();
+}
+
 void SMsgWriter::startRect(const Rect& r, int encoding)
 {
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
@@ -399,6 +460,16 @@ void SMsgWriter::endRect()
   os->flush();
 }
 
+void SMsgWriter::writeEncodedRects(int nRects, const void* data,
+                                   size_t length)
+{
+  nRectsInUpdate += nRects;
+  if (nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw Exception("SMsgWriter::writeEncodedRects: nRects out of sync");
+
+  os->writeBytes(data, length);
+}
+
 void SMsgWriter::startMsg(int type)
 {
   os->writeU8(type);
@@ -468,6 +539,16 @@ void SMsgWriter::writePseudoRects()
     writeQEMUKeyEventRect();
     needQEMUKeyEvent = false;
   }
+
+  if (needServerScale) {
+    writeServerScaleRect();
+    needServerScale = false;
+  }
+
+  if (needTightParallel) {
+    writeTightParallelRect();
+    needTightParallel = false;
+  }
 }
 
 void SMsgWriter::writeNoDataRects()
@@ -684,3 +765,31 @@ void SMsgWriter::writeQEMUKeyEventRect()
   os->writeU16(0);
   os->writeU32(pseudoEncodingQEMUKeyEvent);
 }
+
+void SMsgWriter::writeServerScaleRect()
+{
+  if (!client->supportsEncoding(pseudoEncodingServerScale))
+    throw Exception("Client does not support server scaling");
+  if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw Exception("SMsgWriter::writeServerScaleRect: nRects out of sync");
+
+  os->writeS16(0);
+  os->writeS16(0);
+  os->writeU16(0);
+  os->writeU16(0);
+  os->writeU32(pseudoEncodingServerScale);
+}
+
+void SMsgWriter::writeTightParallelRect()
+{
+  if (!client->supportsEncoding(pseudoEncodingTightParallel))
+    throw Exception("Client does not support parallel Tight decoding");
+  if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw Exception("SMsgWriter::writeTightParallelRect: nRects out of sync");
+
+  os->writeS16(0);
+  os->writeS16(0);
+  os->writeU16(0);
+  os->writeU16(0);
+  os->writeU32(pseudoEncodingTightParallel);
+}
@@ -89,6 +89,14 @@ namespace rfb {
     // And QEMU keyboard event handshake
     void writeQEMUKeyEvent();
 
+    // writeServerScale() tells the client that the server supports
+    // scaling the framebuffer for it
+    void writeServerScale();
+
+    // writeTightParallel() tells the client that every zlib compressed
+    // Tight rect will reset its stream from now on
+    void writeTightParallel();
+
     // needFakeUpdate() returns true when an immediate update is needed in
     // order to flush out pseudo-rectangles to the client.
     bool needFakeUpdate();
@@ -112,11 +120,26 @@ namespace rfb {
     // There is no explicit encoder for CopyRect rects.
     void writeCopyRect(const Rect& r, int srcX, int srcY);
 
+    // Tells the client to store, draw or forget content cache entries.
+    // Only valid if the client supports the content cache.
+    void writeContentCacheRect(const Rect& r, int op, rdr::U32 id);
+
+    // writeSharedFramebufferAttach() tells the client to map the shared
+    // framebuffer that was just passed to it, and
+    // writeSharedFramebufferRect() that a rect has been copied in to it.
+    void writeSharedFramebufferAttach(int width, int height,
+                                      const PixelFormat& pf, int stride);
+    void writeSharedFramebufferRect(const Rect& r);
+
     // Encoders should call these to mark the start and stop of individual
     // rects.
     void startRect(const Rect& r, int enc);
     void endRect();
 
+    // writeEncodedRects() adds rects that have already been fully
+    // written, headers and all, to a separate stream.
+    void writeEncodedRects(int nRects, const void* data, size_t length);
+
   protected:
     void startMsg(int type);
     void endMsg();
@@ -143,6 +166,8 @@ namespace rfb {
                                   const rdr::U8* data);
     void writeLEDStateRect(rdr::U8 state);
     void writeQEMUKeyEventRect();
+    void writeServerScaleRect();
+    void writeTightParallelRect();
 
     ClientParams* client;
     rdr::OutStream* os;
@@ -154,6 +179,8 @@ namespace rfb {
     bool needCursor;
     bool needLEDState;
     bool needQEMUKeyEvent;
+    bool needServerScale;
+    bool needTightParallel;
 
     typedef struct {
       rdr::U16 reason, result;
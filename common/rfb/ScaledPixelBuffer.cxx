@@ -0,0 +1,226 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <rfb/Exception.h>
+#include <rfb/ScaledPixelBuffer.h>
+
+using namespace rfb;
+
+ScaledPixelBuffer::ScaledPixelBuffer()
+  : src(NULL), scale(1), margin(0), xWeightTabs(NULL), yWeightTabs(NULL)
+{
+}
+
+ScaledPixelBuffer::~ScaledPixelBuffer()
+{
+  freeWeightTabs();
+}
+
+void ScaledPixelBuffer::setSource(const PixelBuffer* src_, int scale_,
+                                  unsigned int filter)
+{
+  ScaleFilters filters;
+  int w, h;
+
+  if (scale_ < 1)
+    throw Exception("Invalid scale factor %d", scale_);
+  if (filter > scaleFilterMaxNumber)
+    throw Exception("Invalid scale filter %u", filter);
+
+  freeWeightTabs();
+
+  src = src_;
+  scale = scale_;
+
+  w = (src->width() + scale - 1) / scale;
+  h = (src->height() + scale - 1) / scale;
+
+  setPF(src->getPF());
+  setSize(w, h);
+
+  filters.makeWeightTabs(filter, src->width(), w, &xWeightTabs);
+  filters.makeWeightTabs(filter, src->height(), h, &yWeightTabs);
+
+  // How far, in our pixels, a source pixel can have an effect
+  margin = (int)ceil(filters[filter].radius) + 1;
+}
+
+Region ScaledPixelBuffer::scaleRegion(const Region& region) const
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
+  Region scaled;
+
+  region.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i) {
+    Rect r;
+
+    r.tl.x = i->tl.x / scale - margin;
+    r.tl.y = i->tl.y / scale - margin;
+    r.br.x = (i->br.x + scale - 1) / scale + margin;
+    r.br.y = (i->br.y + scale - 1) / scale + margin;
+
+    scaled.assign_union(r.intersect(getRect()));
+  }
+
+  return scaled;
+}
+
+Region ScaledPixelBuffer::unscaleRegion(const Region& region) const
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
+  Region unscaled;
+
+  region.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i) {
+    Rect r;
+
+    r.tl.x = i->tl.x * scale;
+    r.tl.y = i->tl.y * scale;
+    r.br.x = i->br.x * scale;
+    r.br.y = i->br.y * scale;
+
+    unscaled.assign_union(r.intersect(src->getRect()));
+  }
+
+  return unscaled;
+}
+
+Point ScaledPixelBuffer::unscalePoint(const Point& pos) const
+{
+  Point p;
+
+  p.x = pos.x * scale + scale / 2;
+  p.y = pos.y * scale + scale / 2;
+
+  if (p.x >= src->width())
+    p.x = src->width() - 1;
+  if (p.y >= src->height())
+    p.y = src->height() - 1;
+
+  return p;
+}
+
+void ScaledPixelBuffer::update(const Region& region)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
+
+  region.intersect(getRect()).get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i)
+    updateRect(*i);
+}
+
+void ScaledPixelBuffer::updateRect(const Rect& rect)
+{
+  int srcX, srcWidth;
+
+  // The weight tabs are ordered, so this covers every source pixel
+  // we'll need for this rect
+  srcX = xWeightTabs[rect.tl.x].i0;
+  srcWidth = xWeightTabs[rect.br.x - 1].i1 - srcX;
+
+  srcRow.resize(srcWidth * 3);
+  columns.resize(srcWidth * 3);
+  dstRow.resize(rect.width() * 3);
+
+  for (int y = rect.tl.y; y < rect.br.y; y++) {
+    const SFilterWeightTab* yTab;
+    rdr::U8* buffer;
+    int stride;
+
+    yTab = &yWeightTabs[y];
+
+    // First filter vertically, for all the columns we need...
+    memset(&columns[0], 0, columns.size() * sizeof(int));
+    for (int sy = yTab->i0; sy < yTab->i1; sy++) {
+      const rdr::U8* data;
+      int weight;
+
+      data = src->getBuffer(Rect(srcX, sy, srcX + srcWidth, sy + 1),
+                            &stride);
+      src->getPF().rgbFromBuffer(&srcRow[0], data, srcWidth);
+
+      weight = yTab->weight[sy - yTab->i0];
+      for (int i = 0; i < srcWidth * 3; i++)
+        columns[i] += weight * srcRow[i];
+    }
+
+    // ...dropping enough precision that the next step won't overflow
+    for (int i = 0; i < srcWidth * 3; i++)
+      columns[i] = (columns[i] + (1 << (BITS_OF_CHANEL - 1))) >> BITS_OF_CHANEL;
+
+    // Then horizontally
+    for (int x = rect.tl.x; x < rect.br.x; x++) {
+      const SFilterWeightTab* xTab;
+      int sum[3];
+
+      xTab = &xWeightTabs[x];
+
+      sum[0] = sum[1] = sum[2] = 0;
+      for (int sx = xTab->i0; sx < xTab->i1; sx++) {
+        const int* column;
+        int weight;
+
+        column = &columns[(sx - srcX) * 3];
+        weight = xTab->weight[sx - xTab->i0];
+
+        sum[0] += weight * column[0];
+        sum[1] += weight * column[1];
+        sum[2] += weight * column[2];
+      }
+
+      for (int c = 0; c < 3; c++) {
+        int value;
+
+        value = (sum[c] + (1 << (FINALSHIFT - 1))) >> FINALSHIFT;
+        if (value < 0)
+          value = 0;
+        else if (value > 255)
+          value = 255;
+
+        dstRow[(x - rect.tl.x) * 3 + c] = value;
+      }
+    }
+
+    buffer = getBufferRW(Rect(rect.tl.x, y, rect.br.x, y + 1), &stride);
+    getPF().bufferFromRGB(buffer, &dstRow[0], rect.width());
+    commitBufferRW(Rect(rect.tl.x, y, rect.br.x, y + 1));
+  }
+}
+
+void ScaledPixelBuffer::freeWeightTabs()
+{
+  if (xWeightTabs != NULL) {
+    for (int x = 0; x < width(); x++)
+      delete [] xWeightTabs[x].weight;
+    delete [] xWeightTabs;
+    xWeightTabs = NULL;
+  }
+
+  if (yWeightTabs != NULL) {
+    for (int y = 0; y < height(); y++)
+      delete [] yWeightTabs[y].weight;
+    delete [] yWeightTabs;
+    yWeightTabs = NULL;
+  }
+}
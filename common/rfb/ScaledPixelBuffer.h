@@ -0,0 +1,80 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ScaledPixelBuffer - A copy of another PixelBuffer that has been
+// scaled down by an integer factor using one of the ScaleFilters.
+//
+
+#ifndef __RFB_SCALEDPIXELBUFFER_H__
+#define __RFB_SCALEDPIXELBUFFER_H__
+
+#include <vector>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/Region.h>
+#include <rfb/ScaleFilters.h>
+
+namespace rfb {
+
+  class ScaledPixelBuffer : public ManagedPixelBuffer {
+  public:
+    ScaledPixelBuffer();
+    virtual ~ScaledPixelBuffer();
+
+    // setSource() sets the buffer that should be scaled, the factor to
+    // scale it down by and which filter to use. The contents are
+    // undefined until update() is called.
+    void setSource(const PixelBuffer* src, int scale,
+                   unsigned int filter=defaultScaleFilter);
+
+    int getScale() const { return scale; }
+
+    // scaleRegion() returns the area of this buffer that depends on
+    // the given area of the source
+    Region scaleRegion(const Region& region) const;
+
+    // unscaleRegion() and unscalePoint() convert coordinates in this
+    // buffer to the corresponding ones in the source
+    Region unscaleRegion(const Region& region) const;
+    Point unscalePoint(const Point& pos) const;
+
+    // update() recalculates the given area from the source
+    void update(const Region& region);
+
+  protected:
+    void updateRect(const Rect& rect);
+
+    void freeWeightTabs();
+
+  protected:
+    const PixelBuffer* src;
+    int scale;
+    int margin;
+
+    SFilterWeightTab* xWeightTabs;
+    SFilterWeightTab* yWeightTabs;
+
+    std::vector<rdr::U8> srcRow;
+    std::vector<int> columns;
+    std::vector<rdr::U8> dstRow;
+  };
+
+}
+
+#endif
@@ -47,15 +47,66 @@ rfb::IntParameter rfb::Server::clientWaitTimeMillis
  "The number of milliseconds to wait for a client which is no longer "
  "responding",
  20000, 0);
+rfb::IntParameter rfb::Server::maxSendQueue
+("MaxSendQueue",
+ "The amount of data, in KiB, that can be queued for a client that is "
+ "slow to receive it before the server has to wait for the client",
+ 16384, 0);
 rfb::IntParameter rfb::Server::compareFB
 ("CompareFB",
  "Perform pixel comparison on framebuffer to reduce unnecessary updates "
- "(0: never, 1: always, 2: auto)",
+ "(0: never, 1: always, 2: auto, 3: always, but only keep a hash of each "
+ "block)",
  2);
+rfb::BoolParameter rfb::Server::detectScrolling
+("DetectScrolling",
+ "Look for areas that have been scrolled by redrawing them, and send "
+ "them as copies instead (only when comparing without hashing)",
+ false);
 rfb::IntParameter rfb::Server::frameRate
 ("FrameRate",
  "The maximum number of updates per second sent to each client",
  60);
+rfb::IntParameter rfb::Server::encodeThreads
+("EncodeThreads",
+ "The number of threads used to encode updates for each client "
+ "(0: automatic, 1: no extra threads)",
+ 1, 0);
+rfb::BoolParameter rfb::Server::clientThreads
+("ClientThreads",
+ "Encode the updates for each client on a separate thread, so that "
+ "slow clients do not hold up the server",
+ false);
+rfb::StringParameter rfb::Server::statsFile
+("StatsFile",
+ "Periodically write encoding and network statistics for each client "
+ "to this file",
+ "");
+rfb::IntParameter rfb::Server::statsInterval
+("StatsInterval",
+ "How often, in seconds, StatsFile is written",
+ 10, 1);
+rfb::IntParameter rfb::Server::autoQuality
+("AutoQuality",
+ "Adjust the image quality and compression level to the available "
+ "bandwidth. 0 = Off, 1 = Only levels not set by the client, "
+ "2 = All levels",
+ 0, 0, 2);
+rfb::IntParameter rfb::Server::autoQualityLatency
+("AutoQualityLatency",
+ "The longest time, in milliseconds, that AutoQuality should let each "
+ "update take to encode and send",
+ 100, 1);
+rfb::IntParameter rfb::Server::videoQuality
+("VideoQuality",
+ "JPEG quality level used for areas that keep changing, such as video. "
+ "-1 = Disable video detection",
+ -1, -1, 9);
+rfb::IntParameter rfb::Server::videoFrameRate
+("VideoFrameRate",
+ "The maximum number of updates per second sent for areas that keep "
+ "changing, such as video. 0 = Same as FrameRate",
+ 0, 0);
 rfb::BoolParameter rfb::Server::protocol3_3
 ("Protocol3.3",
  "Always use protocol version 3.3 for backwards compatibility with "
@@ -97,6 +148,16 @@ rfb::BoolParameter rfb::Server::acceptSetDesktopSize
 ("AcceptSetDesktopSize",
  "Accept set desktop size events from clients.",
  true);
+rfb::BoolParameter rfb::Server::acceptSetScale
+("AcceptSetScale",
+ "Accept requests from clients to scale down the desktop before it is "
+ "sent to them.",
+ false);
+rfb::IntParameter rfb::Server::scaleFilter
+("ScaleFilter",
+ "Filter used when scaling down the desktop for clients "
+ "(0: nearest neighbour, 1: bilinear, 2: bicubic)",
+ 1, 0, 2);
 rfb::BoolParameter rfb::Server::queryConnect
 ("QueryConnect",
  "Prompt the local user to accept or reject incoming connections.",
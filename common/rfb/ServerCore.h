@@ -37,8 +37,18 @@ namespace rfb {
     static IntParameter maxConnectionTime;
     static IntParameter maxIdleTime;
     static IntParameter clientWaitTimeMillis;
+    static IntParameter maxSendQueue;
     static IntParameter compareFB;
+    static BoolParameter detectScrolling;
     static IntParameter frameRate;
+    static IntParameter encodeThreads;
+    static BoolParameter clientThreads;
+    static StringParameter statsFile;
+    static IntParameter statsInterval;
+    static IntParameter autoQuality;
+    static IntParameter autoQualityLatency;
+    static IntParameter videoQuality;
+    static IntParameter videoFrameRate;
     static BoolParameter protocol3_3;
     static BoolParameter alwaysShared;
     static BoolParameter neverShared;
@@ -48,6 +58,8 @@ namespace rfb {
     static BoolParameter acceptCutText;
     static BoolParameter sendCutText;
     static BoolParameter acceptSetDesktopSize;
+    static BoolParameter acceptSetScale;
+    static IntParameter scaleFilter;
     static BoolParameter queryConnect;
 
   };
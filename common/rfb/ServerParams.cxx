@@ -27,7 +27,8 @@ ServerParams::ServerParams()
   : majorVersion(0), minorVersion(0),
     supportsQEMUKeyEvent(false),
     supportsSetDesktopSize(false), supportsFence(false),
-    supportsContinuousUpdates(false),
+    supportsContinuousUpdates(false), supportsServerScale(false),
+    supportsTightParallel(false),
     width_(0), height_(0), name_(0),
     ledState_(ledUnknown)
 {
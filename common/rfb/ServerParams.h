@@ -76,6 +76,8 @@ namespace rfb {
     bool supportsSetDesktopSize;
     bool supportsFence;
     bool supportsContinuousUpdates;
+    bool supportsServerScale;
+    bool supportsTightParallel;
 
   private:
 
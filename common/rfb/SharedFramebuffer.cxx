@@ -0,0 +1,207 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <rdr/Exception.h>
+#include <rfb/Exception.h>
+#include <rfb/SharedFramebuffer.h>
+
+using namespace rfb;
+
+SharedFramebuffer::SharedFramebuffer()
+  : fd(-1), mapping(NULL), length(0), stride(0)
+{
+}
+
+SharedFramebuffer::~SharedFramebuffer()
+{
+  release();
+}
+
+#ifdef WIN32
+
+void SharedFramebuffer::create(const PixelFormat& pf, int width, int height)
+{
+  throw Exception("Shared framebuffers are not supported on this platform");
+}
+
+void SharedFramebuffer::attach(int fd_, const PixelFormat& pf,
+                               int width, int height, int stride_)
+{
+  throw Exception("Shared framebuffers are not supported on this platform");
+}
+
+bool SharedFramebuffer::canAttach()
+{
+  return false;
+}
+
+void SharedFramebuffer::release()
+{
+}
+
+void SharedFramebuffer::map(int fd_, size_t length_, bool writable)
+{
+}
+
+#else
+
+void SharedFramebuffer::create(const PixelFormat& pf, int width, int height)
+{
+  int newFd;
+  size_t newLength;
+
+  release();
+
+  if ((width <= 0) || (height <= 0))
+    throw Exception("Invalid shared framebuffer size %dx%d", width, height);
+
+  newLength = (size_t)width * height * (pf.bpp/8);
+
+  // The viewer only accepts sealed memory, as otherwise we could crash
+  // it by truncating the file
+#if defined(HAVE_MEMFD_CREATE) && defined(F_ADD_SEALS)
+  newFd = memfd_create("tigervnc-framebuffer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (newFd < 0)
+    throw rdr::SystemException("memfd_create", errno);
+
+  if (ftruncate(newFd, newLength) < 0) {
+    int err = errno;
+    close(newFd);
+    throw rdr::SystemException("ftruncate", err);
+  }
+
+  if (fcntl(newFd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+    int err = errno;
+    close(newFd);
+    throw rdr::SystemException("fcntl", err);
+  }
+#else
+  throw Exception("Shared framebuffers are not supported on this platform");
+#endif
+
+  map(newFd, newLength, true);
+
+  format = pf;
+  stride = width;
+  setBuffer(width, height, (rdr::U8*)mapping, stride);
+}
+
+void SharedFramebuffer::attach(int fd_, const PixelFormat& pf,
+                               int width, int height, int stride_)
+{
+  struct stat st;
+  size_t needed;
+
+  release();
+
+  if ((width <= 0) || (height <= 0) || (stride_ < width)) {
+    close(fd_);
+    throw Exception("Invalid shared framebuffer size %dx%d", width, height);
+  }
+
+#if defined(HAVE_MEMFD_CREATE) && defined(F_GET_SEALS)
+  int seals;
+
+  seals = fcntl(fd_, F_GET_SEALS);
+  if ((seals < 0) || !(seals & F_SEAL_SHRINK)) {
+    close(fd_);
+    throw Exception("Shared framebuffer is not sealed against shrinking");
+  }
+#else
+  close(fd_);
+  throw Exception("Shared framebuffers cannot be checked on this platform");
+#endif
+
+  needed = (size_t)stride_ * height * (pf.bpp/8);
+
+  if (fstat(fd_, &st) < 0) {
+    int err = errno;
+    close(fd_);
+    throw rdr::SystemException("fstat", err);
+  }
+  if ((size_t)st.st_size < needed) {
+    close(fd_);
+    throw Exception("Shared framebuffer is too small");
+  }
+
+  map(fd_, needed, false);
+
+  format = pf;
+  stride = stride_;
+  setBuffer(width, height, (rdr::U8*)mapping, stride);
+}
+
+bool SharedFramebuffer::canAttach()
+{
+#if defined(HAVE_MEMFD_CREATE) && defined(F_GET_SEALS)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SharedFramebuffer::release()
+{
+  if (mapping != NULL) {
+    setBuffer(0, 0, NULL, 0);
+    munmap(mapping, length);
+    mapping = NULL;
+    length = 0;
+  }
+
+  if (fd != -1) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+void SharedFramebuffer::map(int fd_, size_t length_, bool writable)
+{
+  void* newMapping;
+
+  newMapping = mmap(NULL, length_,
+                    writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_SHARED, fd_, 0);
+  if (newMapping == MAP_FAILED) {
+    int err = errno;
+    close(fd_);
+    throw rdr::SystemException("mmap", err);
+  }
+
+  fd = fd_;
+  mapping = newMapping;
+  length = length_;
+}
+
+#endif
@@ -0,0 +1,85 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+
+//
+// SharedFramebuffer - A framebuffer in memory that is shared between
+// a server and a viewer running on the same host.
+//
+// The server creates it and passes the file descriptor over the UNIX
+// domain socket. After that an update only has to say which rects
+// have been copied in to it, and the viewer copies them out again.
+//
+// The server keeps writing to the memory whilst the viewer is reading
+// it, so the viewer can see content that is newer than the update it
+// is processing. That is fine as a later update will always cover it,
+// but it means that the viewer's framebuffer must not be used as the
+// source for anything, e.g. CopyRect.
+//
+
+#ifndef __RFB_SHAREDFRAMEBUFFER_H__
+#define __RFB_SHAREDFRAMEBUFFER_H__
+
+#include <stddef.h>
+
+#include <rfb/PixelBuffer.h>
+
+namespace rfb {
+
+  // Operations in a pseudoEncodingSharedFramebuffer rect
+  const int sharedFramebufferAttach = 0;
+  const int sharedFramebufferUpdate = 1;
+
+  class SharedFramebuffer : public FullFramePixelBuffer {
+  public:
+    SharedFramebuffer();
+    virtual ~SharedFramebuffer();
+
+    // create() allocates new shared memory for the given format and
+    // size, dropping any previous memory. The file descriptor stays
+    // owned by this object.
+    void create(const PixelFormat& pf, int width, int height);
+
+    // attach() maps memory from create() in another process. It takes
+    // over the file descriptor. The memory is read only, so only
+    // getBuffer() can be used. It is refused unless it is sealed
+    // against shrinking, as the other process could otherwise make us
+    // crash by truncating it. canAttach() returns false if that can't
+    // be checked on this platform.
+    void attach(int fd, const PixelFormat& pf, int width, int height,
+                int stride);
+    static bool canAttach();
+
+    void release();
+
+    bool isValid() const { return mapping != NULL; }
+    int getFd() const { return fd; }
+    int getStride() const { return stride; }
+
+  private:
+    void map(int fd, size_t length, bool writable);
+
+    int fd;
+    void* mapping;
+    size_t length;
+    int stride;
+  };
+
+}
+
+#endif
@@ -148,6 +148,21 @@ void TightDecoder::readRect(const Rect& r, rdr::InStream* is,
   }
 }
 
+// Rects that start over on the zlib stream they use don't depend on
+// anything that came before them. But we can only skip updating the
+// shared streams if the server has promised that nothing after them
+// will depend on them either.
+static bool isIndependent(rdr::U8 comp_ctl, const ServerParams& server)
+{
+  if (!server.supportsTightParallel)
+    return false;
+
+  if ((comp_ctl & 0x80) != 0x00)
+    return false;
+
+  return (comp_ctl & 0x0f) == (1 << ((comp_ctl >> 4) & 0x03));
+}
+
 bool TightDecoder::doRectsConflict(const Rect& rectA,
                                    const void* bufferA,
                                    size_t buflenA,
@@ -164,6 +179,9 @@ bool TightDecoder::doRectsConflict(const Rect& rectA,
   comp_ctl_a = *(const rdr::U8*)bufferA;
   comp_ctl_b = *(const rdr::U8*)bufferB;
 
+  if (isIndependent(comp_ctl_a, server) || isIndependent(comp_ctl_b, server))
+    return false;
+
   // Resets or use of zlib pose the same problem, so merge them
   if ((comp_ctl_a & 0x80) == 0x00)
     comp_ctl_a |= 1 << ((comp_ctl_a >> 4) & 0x03);
@@ -184,6 +202,7 @@ void TightDecoder::decodeRect(const Rect& r, const void* buffer,
   const PixelFormat& pf = server.pf();
 
   rdr::U8 comp_ctl;
+  bool independent;
 
   bufptr = (const rdr::U8*)buffer;
 
@@ -193,9 +212,13 @@ void TightDecoder::decodeRect(const Rect& r, const void* buffer,
   bufptr += 1;
   buflen -= 1;
 
+  // Independent rects might be decoded in parallel with others, so
+  // they get a stream of their own rather than touching the shared ones
+  independent = isIndependent(comp_ctl, server);
+
   // Reset zlib streams if we are told by the server to do so.
   for (int i = 0; i < 4; i++) {
-    if (comp_ctl & 1) {
+    if ((comp_ctl & 1) && !independent) {
       zis[i].reset();
     }
     comp_ctl >>= 1;
@@ -323,6 +346,7 @@ void TightDecoder::decodeRect(const Rect& r, const void* buffer,
     rdr::U32 len;
     int streamId;
     rdr::MemInStream* ms;
+    rdr::ZlibInStream* zs;
 
     assert(buflen >= 4);
 
@@ -333,18 +357,26 @@ void TightDecoder::decodeRect(const Rect& r, const void* buffer,
     assert(buflen >= len);
 
     streamId = comp_ctl & 0x03;
+    if (independent)
+      zs = new rdr::ZlibInStream;
+    else
+      zs = &zis[streamId];
+
     ms = new rdr::MemInStream(bufptr, len);
-    zis[streamId].setUnderlying(ms, len);
+    zs->setUnderlying(ms, len);
 
     // Allocate buffer and decompress the data
     netbuf = new rdr::U8[dataSize];
 
-    zis[streamId].readBytes(netbuf, dataSize);
+    zs->readBytes(netbuf, dataSize);
 
-    zis[streamId].flushUnderlying();
-    zis[streamId].setUnderlying(NULL, 0);
+    zs->flushUnderlying();
+    zs->setUnderlying(NULL, 0);
     delete ms;
 
+    if (independent)
+      delete zs;
+
     bufptr = netbuf;
     buflen = dataSize;
   }
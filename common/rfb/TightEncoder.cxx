@@ -56,7 +56,7 @@ static const TightConf conf[10] = {
 };
 
 TightEncoder::TightEncoder(SConnection* conn) :
-  Encoder(conn, encodingTight, EncoderPlain, 256)
+  Encoder(conn, encodingTight, EncoderPlain, 256), resetStreams(false)
 {
   setCompressLevel(-1);
 }
@@ -103,7 +103,7 @@ void TightEncoder::writeSolidRect(int width, int height,
 {
   rdr::OutStream* os;
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU8(tightFill << 4);
   writePixels(colour, pf, 1, os);
@@ -164,9 +164,9 @@ void TightEncoder::writeFullColourRect(const PixelBuffer* pb, const Palette& pal
   const rdr::U8* buffer;
   int stride, h;
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
-  os->writeU8(streamId << 4);
+  os->writeU8((streamId << 4) | checkZlibReset(streamId));
 
   // Set up compression
   if ((pb->getPF().bpp != 32) || !pb->getPF().is888())
@@ -232,12 +232,37 @@ void TightEncoder::writeCompact(rdr::OutStream* os, rdr::U32 value)
   }
 }
 
+rdr::U8 TightEncoder::checkZlibReset(int streamId)
+{
+  rdr::U8 mask;
+
+  assert(streamId >= 0);
+  assert(streamId < 4);
+
+  mask = 1 << streamId;
+
+  // A client that decodes rects in parallel needs each of them to
+  // start with a fresh zlib stream. It will also have stopped keeping
+  // track of the shared streams, and it can't tell exactly when we
+  // notice that it stops asking for this, so keep resetting them for
+  // the rest of the connection.
+  if (conn->client.supportsEncoding(pseudoEncodingTightParallel))
+    resetStreams = true;
+
+  if (!resetStreams)
+    return 0;
+
+  zlibStreams[streamId].reset();
+
+  return mask;
+}
+
 rdr::OutStream* TightEncoder::getZlibOutStream(int streamId, int level, size_t length)
 {
   // Minimum amount of data to be compressed. This value should not be
   // changed, doing so will break compatibility with existing clients.
   if (length < 12)
-    return conn->getOutStream();
+    return getOutStream();
 
   assert(streamId >= 0);
   assert(streamId < 4);
@@ -260,7 +285,7 @@ void TightEncoder::flushZlibOutStream(rdr::OutStream* os_)
   zos->flush();
   zos->setUnderlying(NULL);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   writeCompact(os, memStream.length());
   os->writeBytes(memStream.data(), memStream.length());
@@ -50,6 +50,7 @@ namespace rfb {
 
     void writeCompact(rdr::OutStream* os, rdr::U32 value);
 
+    rdr::U8 checkZlibReset(int streamId);
     rdr::OutStream* getZlibOutStream(int streamId, int level, size_t length);
     void flushZlibOutStream(rdr::OutStream* os);
 
@@ -73,6 +74,7 @@ namespace rfb {
                           const PixelFormat& pf, const Palette& palette);
 
     rdr::ZlibOutStream zlibStreams[4];
+    bool resetStreams;
     rdr::MemOutStream memStream;
 
     int idxZlibLevel, monoZlibLevel, rawZlibLevel;
@@ -38,9 +38,10 @@ void TightEncoder::writeMonoRect(int width, int height,
 
   assert(palette.size() == 2);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  os->writeU8(((streamId | tightExplicitFilter) << 4) |
+              checkZlibReset(streamId));
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -125,9 +126,10 @@ void TightEncoder::writeIndexedRect(int width, int height,
   assert(palette.size() > 0);
   assert(palette.size() <= 256);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  os->writeU8(((streamId | tightExplicitFilter) << 4) |
+              checkZlibReset(streamId));
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -65,7 +65,8 @@ static const struct TightJPEGConfiguration conf[10] = {
 
 TightJPEGEncoder::TightJPEGEncoder(SConnection* conn) :
   Encoder(conn, encodingTight,
-          (EncoderFlags)(EncoderUseNativePF | EncoderLossy), -1, 9),
+          (EncoderFlags)(EncoderUseNativePF | EncoderLossy |
+                         EncoderStateless), -1, 9),
   qualityLevel(-1), fineQuality(-1), fineSubsampling(subsampleUndefined)
 {
 }
@@ -107,6 +108,16 @@ int TightJPEGEncoder::getQualityLevel()
   return qualityLevel;
 }
 
+int TightJPEGEncoder::getJPEGQuality(int qualityLevel, int fineQuality)
+{
+  // Fine settings trump level
+  if (fineQuality != -1)
+    return fineQuality;
+  if (qualityLevel >= 0 && qualityLevel <= 9)
+    return conf[qualityLevel].quality;
+  return -1;
+}
+
 void TightJPEGEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 {
   const rdr::U8* buffer;
@@ -118,17 +129,14 @@ void TightJPEGEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 
   buffer = pb->getBuffer(pb->getRect(), &stride);
 
-  if (qualityLevel >= 0 && qualityLevel <= 9) {
-    quality = conf[qualityLevel].quality;
+  quality = getJPEGQuality(qualityLevel, fineQuality);
+
+  if (qualityLevel >= 0 && qualityLevel <= 9)
     subsampling = conf[qualityLevel].subsampling;
-  } else {
-    quality = -1;
+  else
     subsampling = subsampleUndefined;
-  }
 
   // Fine settings trump level
-  if (fineQuality != -1)
-    quality = fineQuality;
   if (fineSubsampling != subsampleUndefined)
     subsampling = fineSubsampling;
 
@@ -136,7 +144,7 @@ void TightJPEGEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
   jc.compress(buffer, stride, pb->getRect(),
               pb->getPF(), quality, subsampling);
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU8(tightJpeg << 4);
 
@@ -37,6 +37,10 @@ namespace rfb {
 
     virtual int getQualityLevel();
 
+    // getJPEGQuality() returns the JPEG quality, 0-100, that a quality
+    // level and a fine quality level result in, or -1 if neither is set
+    static int getJPEGQuality(int qualityLevel, int fineQuality);
+
     virtual void writeRect(const PixelBuffer* pb, const Palette& palette);
     virtual void writeSolidRect(int width, int height,
                                 const PixelFormat& pf,
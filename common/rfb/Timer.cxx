@@ -20,8 +20,13 @@
 // -=- Timer.cxx
 
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 
+#ifdef WIN32
+#include <windows.h>
+#endif
+
 #include <rfb/Timer.h>
 #include <rfb/util.h>
 #include <rfb/LogWriter.h>
@@ -32,116 +37,190 @@ using namespace rfb;
 static LogWriter vlog("Timer");
 #endif
 
+static const size_t notPending = (size_t)-1;
 
-// Millisecond timeout processing helper functions
+std::vector<Timer*> Timer::pending;
+rdr::U64 Timer::nextSequence = 0;
 
-inline static timeval addMillis(timeval inTime, int millis) {
-  int secs = millis / 1000;
-  millis = millis % 1000;
-  inTime.tv_sec += secs;
-  inTime.tv_usec += millis * 1000;
-  if (inTime.tv_usec >= 1000000) {
-    inTime.tv_sec++;
-    inTime.tv_usec -= 1000000;
-  }
-  return inTime;
+Timer::Timer(Callback* cb_)
+  : dueTime(0), sequence(0), timeoutMs(0), heapIndex(notPending), cb(cb_)
+{
 }
 
-inline static int diffTimeMillis(timeval later, timeval earlier) {
-  return ((later.tv_sec - earlier.tv_sec) * 1000) + ((later.tv_usec - earlier.tv_usec) / 1000);
-}
-
-std::list<Timer*> Timer::pending;
-
 int Timer::checkTimeouts() {
-  timeval start;
+  rdr::U64 start;
 
   if (pending.empty())
     return 0;
 
-  gettimeofday(&start, 0);
-  while (pending.front()->isBefore(start)) {
+  // Everything that is due within the same millisecond gets handled
+  // in one go
+  start = getTimeMs();
+  while (!pending.empty() && (pending.front()->dueTime <= start)) {
     Timer* timer;
-    timeval before;
+    rdr::U64 before;
 
     timer = pending.front();
-    pending.pop_front();
+    removeTimer(timer);
 
-    gettimeofday(&before, 0);
+    before = getTimeMs();
     if (timer->cb->handleTimeout(timer)) {
-      timeval now;
+      rdr::U64 now;
 
-      gettimeofday(&now, 0);
+      // The handler might have restarted the timer itself
+      if (timer->isStarted())
+        continue;
 
-      timer->dueTime = addMillis(timer->dueTime, timer->timeoutMs);
-      if (timer->isBefore(now)) {
-        // Time has jumped forwards, or we're not getting enough
-        // CPU time for the timers
+      now = getTimeMs();
 
-        timer->dueTime = addMillis(before, timer->timeoutMs);
-        if (timer->isBefore(now))
+      timer->dueTime += timer->timeoutMs;
+      if (timer->dueTime <= now) {
+        // We're not getting enough CPU time for the timers
+        timer->dueTime = before + timer->timeoutMs;
+        if (timer->dueTime <= now)
           timer->dueTime = now;
       }
 
       insertTimer(timer);
-    } else if (pending.empty()) {
-      return 0;
     }
   }
+
+  if (pending.empty())
+    return 0;
+
   return getNextTimeout();
 }
 
 int Timer::getNextTimeout() {
-  timeval now;
-  gettimeofday(&now, 0);
-  int toWait = __rfbmax(1, pending.front()->getRemainingMs());
-  if (toWait > pending.front()->timeoutMs) {
-    if (toWait - pending.front()->timeoutMs < 1000) {
-      vlog.info("gettimeofday is broken...");
-      return toWait;
-    }
-    // Time has jumped backwards!
-    vlog.info("time has moved backwards!");
-    pending.front()->dueTime = now;
+  int toWait;
+
+  if (pending.empty())
+    return 0;
+
+  // Zero means there are no timers, so never return that even if the
+  // timer became due just now
+  toWait = pending.front()->getRemainingMs();
+  if (toWait < 1)
     toWait = 1;
-  }
+
   return toWait;
 }
 
+rdr::U64 Timer::getTimeMs() {
+#ifdef WIN32
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+
+  if (frequency.QuadPart == 0)
+    QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+
+  return (rdr::U64)counter.QuadPart * 1000 / frequency.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (rdr::U64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+bool Timer::isBefore(const Timer* a, const Timer* b) {
+  if (a->dueTime != b->dueTime)
+    return a->dueTime < b->dueTime;
+  // Timers due at the same time fire in the order they were started
+  return a->sequence < b->sequence;
+}
+
 void Timer::insertTimer(Timer* t) {
-  std::list<Timer*>::iterator i;
-  for (i=pending.begin(); i!=pending.end(); i++) {
-    if (t->isBefore((*i)->dueTime)) {
-      pending.insert(i, t);
-      return;
-    }
-  }
+  t->sequence = nextSequence++;
+  t->heapIndex = pending.size();
   pending.push_back(t);
+  siftUp(t->heapIndex);
+}
+
+void Timer::removeTimer(Timer* t) {
+  size_t index;
+  Timer* last;
+
+  index = t->heapIndex;
+  t->heapIndex = notPending;
+
+  last = pending.back();
+  pending.pop_back();
+  if (last == t)
+    return;
+
+  // Move the last Timer into the hole and restore the heap from there
+  pending[index] = last;
+  last->heapIndex = index;
+  siftUp(index);
+  siftDown(last->heapIndex);
+}
+
+void Timer::siftUp(size_t index) {
+  Timer* t;
+
+  t = pending[index];
+  while (index > 0) {
+    size_t parent;
+
+    parent = (index - 1) / 2;
+    if (!isBefore(t, pending[parent]))
+      break;
+
+    pending[index] = pending[parent];
+    pending[index]->heapIndex = index;
+    index = parent;
+  }
+
+  pending[index] = t;
+  t->heapIndex = index;
+}
+
+void Timer::siftDown(size_t index) {
+  Timer* t;
+
+  t = pending[index];
+  while (true) {
+    size_t child;
+
+    child = index * 2 + 1;
+    if (child >= pending.size())
+      break;
+    if ((child + 1 < pending.size()) &&
+        isBefore(pending[child + 1], pending[child]))
+      child++;
+
+    if (!isBefore(pending[child], t))
+      break;
+
+    pending[index] = pending[child];
+    pending[index]->heapIndex = index;
+    index = child;
+  }
+
+  pending[index] = t;
+  t->heapIndex = index;
 }
 
 void Timer::start(int timeoutMs_) {
-  timeval now;
-  gettimeofday(&now, 0);
   stop();
   timeoutMs = timeoutMs_;
   // The rest of the code assumes non-zero timeout
   if (timeoutMs <= 0)
     timeoutMs = 1;
-  dueTime = addMillis(now, timeoutMs);
+  dueTime = getTimeMs() + timeoutMs;
   insertTimer(this);
 }
 
 void Timer::stop() {
-  pending.remove(this);
+  if (isStarted())
+    removeTimer(this);
 }
 
 bool Timer::isStarted() {
-  std::list<Timer*>::iterator i;
-  for (i=pending.begin(); i!=pending.end(); i++) {
-    if (*i == this)
-      return true;
-  }
-  return false;
+  return heapIndex != notPending;
 }
 
 int Timer::getTimeoutMs() {
@@ -149,13 +228,11 @@ int Timer::getTimeoutMs() {
 }
 
 int Timer::getRemainingMs() {
-  timeval now;
-  gettimeofday(&now, 0);
-  return __rfbmax(0, diffTimeMillis(dueTime, now));
-}
+  rdr::U64 now;
+
+  now = getTimeMs();
+  if (dueTime <= now)
+    return 0;
 
-bool Timer::isBefore(timeval other) {
-  return (dueTime.tv_sec < other.tv_sec) ||
-    ((dueTime.tv_sec == other.tv_sec) &&
-     (dueTime.tv_usec < other.tv_usec));
+  return dueTime - now;
 }
@@ -20,9 +20,11 @@
 #ifndef __RFB_TIMER_H__
 #define __RFB_TIMER_H__
 
-#include <list>
+#include <vector>
 #include <sys/time.h>
 
+#include <rdr/types.h>
+
 namespace rfb {
 
   /* Timer
@@ -60,8 +62,13 @@ namespace rfb {
     //   any elapsed Timers.
     static int getNextTimeout();
 
+    // getTimeMs()
+    //   Returns the time since some arbitrary point in milliseconds, on the same
+    //   clock as the Timers use. Unaffected by changes to the system clock.
+    static rdr::U64 getTimeMs();
+
     // Create a Timer with the specified callback handler
-    Timer(Callback* cb_) {cb = cb_;}
+    Timer(Callback* cb_);
     ~Timer() {stop();}
 
     // startTimer
@@ -87,18 +94,23 @@ namespace rfb {
     //   will timeout. Only valid for an active timer.
     int getRemainingMs();
 
-    // isBefore
-    //   Determine whether the Timer will timeout before the specified time.
-    bool isBefore(timeval other);
-
   protected:
-    timeval dueTime;
+    // The pending Timers are kept in a binary heap ordered by when
+    // they are due, with each Timer keeping track of where it is
+    static void insertTimer(Timer* t);
+    static void removeTimer(Timer* t);
+    static void siftUp(size_t index);
+    static void siftDown(size_t index);
+    static bool isBefore(const Timer* a, const Timer* b);
+
+    rdr::U64 dueTime;
+    rdr::U64 sequence;
     int timeoutMs;
+    size_t heapIndex;
     Callback* cb;
 
-    static void insertTimer(Timer* t);
-    // The list of currently active Timers, ordered by time left until timeout.
-    static std::list<Timer*> pending;
+    static std::vector<Timer*> pending;
+    static rdr::U64 nextSequence;
   };
 
 };
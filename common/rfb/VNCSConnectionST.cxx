@@ -49,9 +49,19 @@ VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket *s,
     inProcessMessages(false),
     pendingSyncFence(false), syncFence(false), fenceFlags(0),
     fenceDataLen(0), fenceData(NULL), congestionTimer(this),
-    losslessTimer(this), server(server_),
+    losslessTimer(this), congestionBlocked(false),
+    congestionBlockedTime(0), updatePending(false), frames(0),
+    frameLatencyTotal(0), frameLatencyMax(0), statsUpdates(0),
+    statsQualityLevel(-1), statsCompressLevel(-1), statsCopy(),
+    statsEncoders(EncodeManager::encoderClassCount() *
+                  EncodeManager::encoderTypeCount()),
+    server(server_),
     updateRenderedCursor(false), removeRenderedCursor(false),
-    continuousUpdates(false), encodeManager(this), idleTimer(this),
+    continuousUpdates(false),
+    encodeManager(this, server_->getWakeupFd() != -1 ? this : NULL),
+    videoTimer(this),
+    updateStartPos(0), scale(1),
+    idleTimer(this),
     pointerEventTime(0), clientHasCursor(false),
     authFailureTimer(this)
 {
@@ -60,6 +70,12 @@ VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket *s,
 
   // Configure the socket
   setSocketTimeouts();
+  sock->outStream().setQueueLimit(rfb::Server::maxSendQueue * 1024);
+
+  autoQualityClientLevels[0] = autoQualityClientLevels[1] = -1;
+
+  lastVideoUpdate.tv_sec = 0;
+  lastVideoUpdate.tv_usec = 0;
 
   // Kick off the idle timer
   if (rfb::Server::idleTimeout) {
@@ -91,6 +107,9 @@ VNCSConnectionST::~VNCSConnectionST()
     server->keyEvent(keysym, keycode, false);
   }
 
+  // The update thread might still be using our state
+  encodeManager.cancelUpdate();
+
   delete [] fenceData;
 }
 
@@ -107,6 +126,16 @@ bool VNCSConnectionST::accessCheck(AccessRights ar) const
   return SConnection::accessCheck(ar);
 }
 
+bool VNCSConnectionST::sendFd(int fd)
+{
+  if (!sock->canPassFds())
+    return false;
+
+  sock->outStream().sendFd(fd);
+
+  return true;
+}
+
 void VNCSConnectionST::close(const char* reason)
 {
   // Log the reason for the close
@@ -209,9 +238,12 @@ void VNCSConnectionST::pixelBufferChange()
 {
   try {
     if (!authenticated()) return;
-    if (client.width() && client.height() &&
-        (server->getPixelBuffer()->width() != client.width() ||
-         server->getPixelBuffer()->height() != client.height()))
+    finishUpdate();
+    if (scale != 1) {
+      scaledBuffer.setSource(server->getPixelBuffer(), scale,
+                             rfb::Server::scaleFilter);
+    }
+    if (client.width() && client.height() && updateDimensions())
     {
       // We need to clip the next update to the new size, but also add any
       // extra bits if it's bigger.  If we wanted to do this exactly, something
@@ -230,9 +262,6 @@ void VNCSConnectionST::pixelBufferChange()
 
       damagedCursorRegion.assign_intersect(server->getPixelBuffer()->getRect());
 
-      client.setDimensions(server->getPixelBuffer()->width(),
-                           server->getPixelBuffer()->height(),
-                           server->getScreenLayout());
       if (state() == RFBSTATE_NORMAL) {
         if (!client.supportsDesktopSize()) {
           close("Client does not support desktop resize");
@@ -242,7 +271,8 @@ void VNCSConnectionST::pixelBufferChange()
       }
 
       // Drop any lossy tracking that is now outside the framebuffer
-      encodeManager.pruneLosslessRefresh(Region(server->getPixelBuffer()->getRect()));
+      encodeManager.pruneLosslessRefresh(Region(Rect(0, 0, client.width(),
+                                                     client.height())));
     }
     // Just update the whole screen at the moment because we're too lazy to
     // work out what's actually changed.
@@ -263,6 +293,18 @@ void VNCSConnectionST::writeFramebufferUpdateOrClose()
   }
 }
 
+void VNCSConnectionST::finishUpdateOrClose()
+{
+  try {
+    if (!encodeManager.isUpdateReady())
+      return;
+    finishUpdate();
+    writeFramebufferUpdate();
+  } catch(rdr::Exception &e) {
+    close(e.str());
+  }
+}
+
 void VNCSConnectionST::screenLayoutChangeOrClose(rdr::U16 reason)
 {
   try {
@@ -391,6 +433,11 @@ bool VNCSConnectionST::needRenderedCursor()
   if (state() != RFBSTATE_NORMAL)
     return false;
 
+  // We can't render the cursor in a scaled framebuffer, but scaling
+  // is only allowed with clients that can show the cursor themselves
+  if (scale != 1)
+    return false;
+
   if (!client.supportsLocalCursor())
     return true;
   if (!server->getCursorPos().equals(pointerEventPos) &&
@@ -421,9 +468,7 @@ void VNCSConnectionST::authSuccess()
     idleTimer.start(secsToMillis(rfb::Server::idleTimeout));
 
   // - Set the connection parameters appropriately
-  client.setDimensions(server->getPixelBuffer()->width(),
-                       server->getPixelBuffer()->height(),
-                       server->getScreenLayout());
+  updateDimensions();
   client.setName(server->getName());
   client.setLEDState(server->getLEDState());
   
@@ -463,6 +508,7 @@ void VNCSConnectionST::clientInit(bool shared)
 
 void VNCSConnectionST::setPixelFormat(const PixelFormat& pf)
 {
+  finishUpdate();
   SConnection::setPixelFormat(pf);
   char buffer[256];
   pf.print(buffer, 256);
@@ -470,6 +516,13 @@ void VNCSConnectionST::setPixelFormat(const PixelFormat& pf)
   setCursor();
 }
 
+void VNCSConnectionST::setEncodings(int nEncodings,
+                                    const rdr::S32* encodings)
+{
+  finishUpdate();
+  SConnection::setEncodings(nEncodings, encodings);
+}
+
 void VNCSConnectionST::pointerEvent(const Point& pos, int buttonMask)
 {
   if (rfb::Server::idleTimeout)
@@ -477,7 +530,10 @@ void VNCSConnectionST::pointerEvent(const Point& pos, int buttonMask)
   pointerEventTime = time(0);
   if (!accessCheck(AccessPtrEvents)) return;
   if (!rfb::Server::acceptPointerEvents) return;
-  pointerEventPos = pos;
+  if (scale != 1)
+    pointerEventPos = scaledBuffer.unscalePoint(pos);
+  else
+    pointerEventPos = pos;
   server->pointerEvent(this, pointerEventPos, buttonMask);
 }
 
@@ -629,6 +685,8 @@ void VNCSConnectionST::framebufferUpdateRequest(const Rect& r,bool incremental)
   // Just update the requested region.
   // Framebuffer update will be sent a bit later, see processMessages().
   Region reqRgn(r);
+  if (scale != 1)
+    reqRgn = scaledBuffer.unscaleRegion(reqRgn);
   if (!incremental || !continuousUpdates)
     requested.assign_union(reqRgn);
 
@@ -656,6 +714,13 @@ void VNCSConnectionST::setDesktopSize(int fb_width, int fb_height,
   if (!accessCheck(AccessSetDesktopSize)) return;
   if (!rfb::Server::acceptSetDesktopSize) return;
 
+  // The client doesn't know the real size of the framebuffer, so it
+  // can't sensibly ask for a new one
+  if (scale != 1) {
+    writer()->writeDesktopSize(reasonClient, resultProhibited);
+    return;
+  }
+
   result = server->setDesktopSize(this, fb_width, fb_height, layout);
   writer()->writeDesktopSize(reasonClient, result);
 }
@@ -716,6 +781,8 @@ void VNCSConnectionST::enableContinuousUpdates(bool enable,
 
   rect.setXYWH(x, y, w, h);
   cuRegion.reset(rect);
+  if (scale != 1)
+    cuRegion = scaledBuffer.unscaleRegion(cuRegion);
 
   if (enable) {
     requested.clear();
@@ -781,11 +848,73 @@ void VNCSConnectionST::supportsLEDState()
   writer()->writeLEDState();
 }
 
+void VNCSConnectionST::supportsServerScale()
+{
+  if (!rfb::Server::acceptSetScale)
+    return;
+
+  writer()->writeServerScale();
+}
+
+void VNCSConnectionST::setScale(int newScale)
+{
+  if (!rfb::Server::acceptSetScale) {
+    vlog.debug("Ignoring request to scale by %d", newScale);
+    return;
+  }
+
+  if (newScale < 1) {
+    vlog.error("Client requested invalid scale factor %d", newScale);
+    return;
+  }
+
+  if (newScale == scale)
+    return;
+
+  finishUpdate();
+
+  if (newScale != 1) {
+    // The client needs to resize its framebuffer and to draw the
+    // cursor itself
+    if (!client.supportsDesktopSize() || !client.supportsLocalCursor()) {
+      vlog.error("Client requested scaling without support for desktop "
+                 "resize and local cursor");
+      return;
+    }
+  }
+
+  vlog.info("Scaling framebuffer down by %d for %s", newScale,
+            peerEndpoint.buf);
+
+  scale = newScale;
+  if (scale != 1) {
+    scaledBuffer.setSource(server->getPixelBuffer(), scale,
+                           rfb::Server::scaleFilter);
+  }
+
+  updateDimensions();
+  writer()->writeDesktopSize(reasonServer);
+
+  // Any rendered cursor will be overwritten by the full update below
+  damagedCursorRegion.clear();
+  removeRenderedCursor = false;
+
+  // Everything the client has needs to be replaced
+  encodeManager.pruneLosslessRefresh(Region());
+  if (continuousUpdates)
+    cuRegion.reset(server->getPixelBuffer()->getRect());
+  updates.clear();
+  updates.add_changed(server->getPixelBuffer()->getRect());
+
+  setCursor();
+}
+
 bool VNCSConnectionST::handleTimeout(Timer* t)
 {
   try {
     if ((t == &congestionTimer) ||
-        (t == &losslessTimer))
+        (t == &losslessTimer) ||
+        (t == &videoTimer))
       writeFramebufferUpdate();
     else if (t == &authFailureTimer)
       SConnection::authFailure(authFailureMsg.buf);
@@ -799,6 +928,13 @@ bool VNCSConnectionST::handleTimeout(Timer* t)
   return false;
 }
 
+void VNCSConnectionST::updateReady()
+{
+  // We can't touch the connection from this thread, so have the main
+  // loop call finishUpdateOrClose()
+  server->wakeup();
+}
+
 bool VNCSConnectionST::isShiftPressed()
 {
     std::map<rdr::U32, rdr::U32>::const_iterator iter;
@@ -832,6 +968,22 @@ void VNCSConnectionST::writeRTTPing()
   congestion.sentPing();
 }
 
+bool VNCSConnectionST::isBusy()
+{
+  if (state() != RFBSTATE_NORMAL)
+    return false;
+
+  if (encodeManager.isUpdatePending())
+    return true;
+
+  try {
+    return isCongested();
+  } catch(rdr::Exception &e) {
+    close(e.str());
+    return false;
+  }
+}
+
 bool VNCSConnectionST::isCongested()
 {
   int eta;
@@ -858,6 +1010,148 @@ bool VNCSConnectionST::isCongested()
   return true;
 }
 
+// startUpdateLatency() and endUpdateLatency() measure how long changes
+// to the framebuffer wait before we send them to the client
+
+void VNCSConnectionST::startUpdateLatency()
+{
+  if (updatePending)
+    return;
+
+  gettimeofday(&updatePendingStart, NULL);
+  updatePending = true;
+}
+
+void VNCSConnectionST::endUpdateLatency()
+{
+  unsigned latency;
+
+  if (!updatePending)
+    return;
+
+  latency = msSince(&updatePendingStart);
+
+  frames++;
+  frameLatencyTotal += latency;
+  if (latency > frameLatencyMax)
+    frameLatencyMax = latency;
+
+  // Anything left over was not requested by the client, so start
+  // measuring again from now
+  if (updates.is_empty())
+    updatePending = false;
+  else
+    gettimeofday(&updatePendingStart, NULL);
+}
+
+static void writeJSONString(FILE* f, const char* str)
+{
+  fputc('"', f);
+  for (; *str != '\0'; str++) {
+    if ((*str == '"') || (*str == '\\'))
+      fprintf(f, "\\%c", *str);
+    else if ((unsigned char)*str < 0x20)
+      fprintf(f, "\\u%04x", (unsigned char)*str);
+    else
+      fputc(*str, f);
+  }
+  fputc('"', f);
+}
+
+static void writeEncoderStats(FILE* f, const char* name,
+                              const EncodeManager::EncoderStats& stats)
+{
+  fprintf(f, "{\"name\": ");
+  writeJSONString(f, name);
+  fprintf(f, ", \"rects\": %u", stats.rects);
+  fprintf(f, ", \"pixels\": %llu", stats.pixels);
+  fprintf(f, ", \"bytes\": %llu", stats.bytes);
+  fprintf(f, ", \"equivalent\": %llu", stats.equivalent);
+  fprintf(f, ", \"ratio\": %.3f",
+          stats.bytes ? (double)stats.equivalent / stats.bytes : 0.0);
+  fprintf(f, ", \"encode_ms\": %.3f}", stats.time * 1000.0);
+}
+
+void VNCSConnectionST::writeStats(FILE* f)
+{
+  unsigned long long blocked;
+  bool first;
+
+  // The encoder statistics belong to the update thread whilst it is
+  // busy, and we don't want to wait for it, so in that case we report
+  // what they were after the previous update
+  if (!encodeManager.isUpdatePending())
+    saveEncoderStats();
+
+  blocked = congestionBlockedTime;
+  if (congestionBlocked)
+    blocked += msSince(&congestionBlockedStart);
+
+  fprintf(f, "{\"peer\": ");
+  writeJSONString(f, peerEndpoint.buf);
+  fprintf(f, ", \"updates\": %u", statsUpdates);
+  fprintf(f, ", \"bandwidth\": %u",
+          (unsigned)congestion.getBandwidth());
+  fprintf(f, ", \"rtt_ms\": %u", congestion.getRTT());
+  fprintf(f, ", \"quality_level\": %d", statsQualityLevel);
+  fprintf(f, ", \"compress_level\": %d", statsCompressLevel);
+  fprintf(f, ", \"congestion_blocked_ms\": %llu", blocked);
+  fprintf(f, ", \"frames\": %u", frames);
+  fprintf(f, ", \"frame_latency_total_ms\": %llu", frameLatencyTotal);
+  fprintf(f, ", \"frame_latency_max_ms\": %u", frameLatencyMax);
+
+  // The maximum is only for the time since the last call
+  frameLatencyMax = 0;
+
+  fprintf(f, ", \"encoders\": [");
+
+  first = true;
+
+  if (statsCopy.rects != 0) {
+    writeEncoderStats(f, "CopyRect", statsCopy);
+    first = false;
+  }
+
+  for (int klass = 0;klass < EncodeManager::encoderClassCount();klass++) {
+    for (int type = 0;type < EncodeManager::encoderTypeCount();type++) {
+      const EncodeManager::EncoderStats* stats;
+      char name[256];
+
+      stats = &statsEncoders[klass * EncodeManager::encoderTypeCount() + type];
+      if (stats->rects == 0)
+        continue;
+
+      if (!first)
+        fprintf(f, ", ");
+      first = false;
+
+      snprintf(name, sizeof(name), "%s/%s",
+               EncodeManager::encoderClassName(klass),
+               EncodeManager::encoderTypeName(type));
+      writeEncoderStats(f, name, *stats);
+    }
+  }
+
+  fprintf(f, "]}");
+}
+
+void VNCSConnectionST::saveEncoderStats()
+{
+  int classes, types;
+
+  classes = EncodeManager::encoderClassCount();
+  types = EncodeManager::encoderTypeCount();
+
+  statsUpdates = encodeManager.getUpdateCount();
+  statsQualityLevel = encodeManager.getQualityLevel();
+  statsCompressLevel = encodeManager.getCompressLevel();
+  statsCopy = encodeManager.getCopyStats();
+
+  for (int klass = 0;klass < classes;klass++) {
+    for (int type = 0;type < types;type++)
+      statsEncoders[klass * types + type] = encodeManager.getStats(klass, type);
+  }
+}
 
 void VNCSConnectionST::writeFramebufferUpdate()
 {
@@ -880,10 +1174,25 @@ void VNCSConnectionST::writeFramebufferUpdate()
   if (requested.is_empty() && !continuousUpdates)
     return;
 
+  // Only one update can be encoded at a time. updateReady() will give
+  // us another chance once the current one is done.
+  if (encodeManager.isUpdatePending())
+    return;
+
   // Check that we actually have some space on the link and retry in a
   // bit if things are congested.
-  if (isCongested())
+  if (isCongested()) {
+    if (!congestionBlocked) {
+      congestionBlocked = true;
+      gettimeofday(&congestionBlockedStart, NULL);
+    }
     return;
+  }
+
+  if (congestionBlocked) {
+    congestionBlockedTime += msSince(&congestionBlockedStart);
+    congestionBlocked = false;
+  }
 
   // Updates often consists of many small writes, and in continuous
   // mode, we will also have small fence messages around the update. We
@@ -984,6 +1293,36 @@ void VNCSConnectionST::writeDataUpdate()
     ui.copied.clear();
   }
 
+  if (rfb::Server::videoQuality >= 0) {
+    const PixelBuffer* pb = server->getPixelBuffer();
+
+    videoDetector.setSize(pb->width(), pb->height());
+    videoDetector.add(ui.changed);
+
+    // Hold back changes to video if it is limited to a lower frame
+    // rate. Copies might depend on those changes, so don't bother
+    // when there are any.
+    if ((rfb::Server::videoFrameRate > 0) && ui.copied.is_empty()) {
+      Region video;
+      unsigned interval, elapsed;
+
+      video = ui.changed.intersect(videoDetector.getVideoRegion());
+      interval = 1000 / rfb::Server::videoFrameRate;
+      elapsed = msSince(&lastVideoUpdate);
+
+      if (!video.is_empty()) {
+        if (elapsed < interval) {
+          ui.changed.assign_subtract(video);
+          req.assign_subtract(video);
+          if (!videoTimer.isStarted())
+            videoTimer.start(interval - elapsed);
+        } else {
+          gettimeofday(&lastVideoUpdate, NULL);
+        }
+      }
+    }
+  }
+
   // Does the client need a server-side rendered cursor?
 
   cursor = NULL;
@@ -1013,22 +1352,42 @@ void VNCSConnectionST::writeDataUpdate()
 
   // We have something to send, so let's get to it
 
-  writeRTTPing();
+  updateVideoRegion();
 
-  encodeManager.writeUpdate(ui, server->getPixelBuffer(), cursor);
+  beginUpdate();
 
-  writeRTTPing();
+  if (scale != 1) {
+    Region scaled;
+
+    // Copies don't survive scaling intact, so they have to be sent
+    // as changes in the scaled framebuffer
+    scaled = scaledBuffer.scaleRegion(ui.changed.union_(ui.copied));
+    scaledBuffer.update(scaled);
+
+    ui.changed = scaled;
+    ui.copied.clear();
+
+    // The shared cache holds unscaled data
+    encodeManager.writeUpdate(ui, &scaledBuffer, NULL, NULL);
+  } else {
+    encodeManager.writeUpdate(ui, server->getPixelBuffer(), cursor,
+                              server->getEncodeCache());
+  }
+
+  endUpdate();
 
   // The request might be for just part of the screen, so we cannot
   // just clear the entire update tracker.
   updates.subtract(req);
 
+  endUpdateLatency();
+
   requested.clear();
 }
 
 void VNCSConnectionST::writeLosslessRefresh()
 {
-  Region req, pending;
+  Region req, lossyReq, pending;
   const RenderedCursor *cursor;
 
   int nextRefresh, nextUpdate;
@@ -1055,12 +1414,21 @@ void VNCSConnectionST::writeLosslessRefresh()
     req.assign_subtract(ui.copied);
   }
 
+  // The lossy tracking is done in the client's coordinates
+  if (scale != 1)
+    lossyReq = scaledBuffer.scaleRegion(req);
+  else
+    lossyReq = req;
+
+  // Video that has stopped can be refreshed
+  updateVideoRegion();
+
   // Any lossy area we can refresh?
-  if (!encodeManager.needsLosslessRefresh(req))
+  if (!encodeManager.needsLosslessRefresh(lossyReq))
     return;
 
   // Right away? Or later?
-  nextRefresh = encodeManager.getNextLosslessRefresh(req);
+  nextRefresh = encodeManager.getNextLosslessRefresh(lossyReq);
   if (nextRefresh > 0) {
     losslessTimer.start(nextRefresh);
     return;
@@ -1090,24 +1458,180 @@ void VNCSConnectionST::writeLosslessRefresh()
 
   maxUpdateSize = bandwidth * nextUpdate / 1000;
 
+  beginUpdate();
+
+  if (scale != 1) {
+    encodeManager.writeLosslessRefresh(lossyReq, &scaledBuffer,
+                                       NULL, maxUpdateSize);
+  } else {
+    encodeManager.writeLosslessRefresh(req, server->getPixelBuffer(),
+                                       cursor, maxUpdateSize);
+  }
+
+  endUpdate();
+
+  requested.clear();
+}
+
+void VNCSConnectionST::updateVideoRegion()
+{
+  Region video;
+
+  if (rfb::Server::videoQuality >= 0) {
+    video = videoDetector.getVideoRegion();
+    if (scale != 1)
+      video = scaledBuffer.scaleRegion(video);
+  }
+
+  encodeManager.setVideoRegion(video);
+}
+
+void VNCSConnectionST::adjustQuality()
+{
+  bool overrideQuality, overrideCompress;
+
+  if (rfb::Server::autoQuality == 0) {
+    encodeManager.setQualityOverride(-1);
+    encodeManager.setCompressOverride(-1);
+    return;
+  }
+
+  // Start over from whatever the client asked for if that changes
+  if ((client.qualityLevel != autoQualityClientLevels[0]) ||
+      (client.compressLevel != autoQualityClientLevels[1])) {
+    autoQualityClientLevels[0] = client.qualityLevel;
+    autoQualityClientLevels[1] = client.compressLevel;
+
+    qualityController.reset(client.qualityLevel == -1 ?
+                              8 : client.qualityLevel,
+                            client.compressLevel == -1 ?
+                              2 : client.compressLevel);
+  }
+
+  qualityController.setLatencyBudget(rfb::Server::autoQualityLatency);
+  qualityController.adjust(congestion.getBandwidth(), congestion.getRTT());
+
+  if (rfb::Server::autoQuality == 2) {
+    overrideQuality = true;
+    overrideCompress = true;
+  } else {
+    overrideQuality = (client.qualityLevel == -1) &&
+                      (client.fineQualityLevel == -1);
+    overrideCompress = client.compressLevel == -1;
+  }
+
+  // Note that this will only have an effect on the JPEG quality if the
+  // client has indicated that it supports JPEG
+  encodeManager.setQualityOverride(overrideQuality ?
+                                   qualityController.getQualityLevel() :
+                                   -1);
+  encodeManager.setCompressOverride(overrideCompress ?
+                                    qualityController.getCompressLevel() :
+                                    -1);
+}
+
+void VNCSConnectionST::updateSent()
+{
+  struct timeval now;
+
+  if (rfb::Server::autoQuality == 0)
+    return;
+
+  gettimeofday(&now, NULL);
+
+  qualityController.updateSent(sock->outStream().length() - updateStartPos,
+                               (now.tv_sec - updateStart.tv_sec) +
+                               (now.tv_usec - updateStart.tv_usec) / 1000000.0);
+}
+
+void VNCSConnectionST::beginUpdate()
+{
+  // The time until the update is ready is not time spent on the
+  // link, so don't let it distort the congestion control
+  if (!encodeManager.isThreaded())
+    writeRTTPing();
+
+  adjustQuality();
+
+  updateStartPos = sock->outStream().length();
+  gettimeofday(&updateStart, NULL);
+}
+
+void VNCSConnectionST::endUpdate()
+{
+  if (encodeManager.isUpdatePending())
+    return;
+
+  updateSent();
+
   writeRTTPing();
+}
 
-  encodeManager.writeLosslessRefresh(req, server->getPixelBuffer(),
-                                     cursor, maxUpdateSize);
+void VNCSConnectionST::finishUpdate()
+{
+  if (!encodeManager.isUpdatePending())
+    return;
+
+  sock->cork(true);
 
   writeRTTPing();
 
-  requested.clear();
+  updateStartPos = sock->outStream().length();
+  encodeManager.finishUpdate();
+
+  saveEncoderStats();
+
+  updateSent();
+
+  writeRTTPing();
+
+  sock->cork(false);
+
+  congestion.updatePosition(sock->outStream().length());
 }
 
 
+bool VNCSConnectionST::updateDimensions()
+{
+  const PixelBuffer* pb;
+  ScreenSet layout;
+  ScreenSet::iterator iter;
+  int oldWidth, oldHeight;
+
+  oldWidth = client.width();
+  oldHeight = client.height();
+
+  if (scale == 1) {
+    pb = server->getPixelBuffer();
+    client.setDimensions(pb->width(), pb->height(),
+                         server->getScreenLayout());
+  } else {
+    pb = &scaledBuffer;
+
+    layout = server->getScreenLayout();
+    for (iter = layout.begin(); iter != layout.end(); ++iter) {
+      Rect* r = &iter->dimensions;
+      r->tl.x = r->tl.x / scale;
+      r->tl.y = r->tl.y / scale;
+      r->br.x = (r->br.x + scale - 1) / scale;
+      r->br.y = (r->br.y + scale - 1) / scale;
+      *r = r->intersect(pb->getRect());
+    }
+
+    client.setDimensions(pb->width(), pb->height(), layout);
+  }
+
+  return (client.width() != oldWidth) || (client.height() != oldHeight);
+}
+
 void VNCSConnectionST::screenLayoutChange(rdr::U16 reason)
 {
   if (!authenticated())
     return;
 
-  client.setDimensions(client.width(), client.height(),
-                       server->getScreenLayout());
+  finishUpdate();
+
+  updateDimensions();
 
   if (state() != RFBSTATE_NORMAL)
     return;
@@ -28,17 +28,25 @@
 #define __RFB_VNCSCONNECTIONST_H__
 
 #include <map>
+#include <vector>
+
+#include <stdio.h>
+#include <sys/time.h>
 
 #include <rfb/Congestion.h>
 #include <rfb/EncodeManager.h>
+#include <rfb/QualityController.h>
 #include <rfb/SConnection.h>
+#include <rfb/ScaledPixelBuffer.h>
 #include <rfb/Timer.h>
+#include <rfb/VideoDetector.h>
 
 namespace rfb {
   class VNCServerST;
 
   class VNCSConnectionST : public SConnection,
-                           public Timer::Callback {
+                           public Timer::Callback,
+                           public EncodeManager::UpdateHandler {
   public:
     VNCSConnectionST(VNCServerST* server_, network::Socket* s, bool reverse);
     virtual ~VNCSConnectionST();
@@ -46,6 +54,7 @@ namespace rfb {
     // SConnection methods
 
     virtual bool accessCheck(AccessRights ar) const;
+    virtual bool sendFd(int fd);
     virtual void close(const char* reason);
 
     // Methods called from VNCServerST.  None of these methods ever knowingly
@@ -70,6 +79,7 @@ namespace rfb {
     // Wrappers to make these methods "safe" for VNCServerST.
     void writeFramebufferUpdateOrClose();
     void screenLayoutChangeOrClose(rdr::U16 reason);
+    void finishUpdateOrClose();
     void setCursorOrClose();
     void bellOrClose();
     void setDesktopNameOrClose(const char *name);
@@ -96,12 +106,26 @@ namespace rfb {
     // or because the current cursor position has not been set by this client.
     bool needRenderedCursor();
 
+    // isBusy() returns true if this client cannot take another update
+    // right now, as it is still encoding or sending the previous one.
+    bool isBusy();
+
     network::Socket* getSock() { return sock; }
 
+    // writeStats() writes a JSON object to the file describing how well
+    // updates are being encoded and sent to this client
+    void writeStats(FILE* f);
+
     // Change tracking
 
-    void add_changed(const Region& region) { updates.add_changed(region); }
+    void add_changed(const Region& region) {
+      if (!region.is_empty())
+        startUpdateLatency();
+      updates.add_changed(region);
+    }
     void add_copied(const Region& dest, const Point& delta) {
+      if (!dest.is_empty())
+        startUpdateLatency();
       updates.add_copied(dest, delta);
     }
 
@@ -115,6 +139,7 @@ namespace rfb {
     virtual void queryConnection(const char* userName);
     virtual void clientInit(bool shared);
     virtual void setPixelFormat(const PixelFormat& pf);
+    virtual void setEncodings(int nEncodings, const rdr::S32* encodings);
     virtual void pointerEvent(const Point& pos, int buttonMask);
     virtual void keyEvent(rdr::U32 keysym, rdr::U32 keycode, bool down);
     virtual void framebufferUpdateRequest(const Rect& r, bool incremental);
@@ -130,10 +155,15 @@ namespace rfb {
     virtual void supportsFence();
     virtual void supportsContinuousUpdates();
     virtual void supportsLEDState();
+    virtual void supportsServerScale();
+    virtual void setScale(int scale);
 
     // Timer callbacks
     virtual bool handleTimeout(Timer* t);
 
+    // EncodeManager callbacks, called from the update thread
+    virtual void updateReady();
+
     // Internal methods
 
     bool isShiftPressed();
@@ -142,6 +172,10 @@ namespace rfb {
     void writeRTTPing();
     bool isCongested();
 
+    // Statistics
+    void startUpdateLatency();
+    void endUpdateLatency();
+
     // writeFramebufferUpdate() attempts to write a framebuffer update to the
     // client.
 
@@ -150,6 +184,30 @@ namespace rfb {
     void writeDataUpdate();
     void writeLosslessRefresh();
 
+    // updateVideoRegion() tells the encoder which areas currently
+    // contain video
+    void updateVideoRegion();
+
+    // beginUpdate() and endUpdate() surround the encoding of an update,
+    // and finishUpdate() sends one that was encoded on the update
+    // thread. The latter blocks until it is ready, so it is also used
+    // before anything the update thread depends on is changed.
+    void beginUpdate();
+    void endUpdate();
+    void finishUpdate();
+
+    // adjustQuality() updates the levels AutoQuality is overriding and
+    // updateSent() tells it about what was just sent
+    void adjustQuality();
+    void updateSent();
+
+    // saveEncoderStats() copies the encoder statistics for writeStats()
+    void saveEncoderStats();
+
+    // updateDimensions() sets the framebuffer size and screen layout
+    // the client sees, returning true if the size has changed
+    bool updateDimensions();
+
     void screenLayoutChange(rdr::U16 reason);
     void setCursor();
     void setDesktopName(const char *name);
@@ -172,6 +230,23 @@ namespace rfb {
     Timer congestionTimer;
     Timer losslessTimer;
 
+    bool congestionBlocked;
+    struct timeval congestionBlockedStart;
+    unsigned long long congestionBlockedTime;
+
+    bool updatePending;
+    struct timeval updatePendingStart;
+    unsigned frames;
+    unsigned long long frameLatencyTotal;
+    unsigned frameLatencyMax;
+
+    // The encoder statistics as of the last finished update, as the
+    // update thread might be changing them when writeStats() is called
+    unsigned statsUpdates;
+    int statsQualityLevel, statsCompressLevel;
+    EncodeManager::EncoderStats statsCopy;
+    std::vector<EncodeManager::EncoderStats> statsEncoders;
+
     VNCServerST* server;
     SimpleUpdateTracker updates;
     Region requested;
@@ -181,6 +256,24 @@ namespace rfb {
     Region cuRegion;
     EncodeManager encodeManager;
 
+    // Areas that are showing video, and when changes to them were
+    // last sent
+    VideoDetector videoDetector;
+    Timer videoTimer;
+    struct timeval lastVideoUpdate;
+
+    size_t updateStartPos;
+    struct timeval updateStart;
+
+    QualityController qualityController;
+    int autoQualityClientLevels[2];
+
+    // The client's view of the framebuffer when it has asked for it to
+    // be scaled down. Update tracking is still done in the coordinates
+    // of the server's framebuffer.
+    int scale;
+    ScaledPixelBuffer scaledBuffer;
+
     std::map<rdr::U32, rdr::U32> pressedKeys;
 
     Timer idleTimer;
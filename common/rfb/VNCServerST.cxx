@@ -49,7 +49,17 @@
 
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include <rfb/ComparingUpdateTracker.h>
 #include <rfb/KeyRemapper.h>
@@ -68,6 +78,29 @@ using namespace rfb;
 static LogWriter slog("VNCServerST");
 static LogWriter connectionsLog("Connections");
 
+// Upper limit for how much encoded data is kept around for sharing
+// between clients during a single frame
+static const size_t EncodeCacheMaxSize = 64 * 1024 * 1024;
+
+// How long the application has to be quiet before we consider it done
+// drawing and send the changes (ms)
+static const unsigned frameSettleTime = 4;
+// How long changes may be held back because the clients are busy, and
+// the slowest drawing rate we bother tracking (ms)
+static const unsigned maxFrameDelay = 100;
+static const unsigned maxDamageInterval = 1000;
+
+// Milliseconds from then until now, where a then of zero means it
+// never happened and counts as long ago
+static unsigned elapsedMs(rdr::U64 then, rdr::U64 now)
+{
+  if (now < then)
+    return 0;
+  if (now - then > UINT_MAX)
+    return UINT_MAX;
+  return now - then;
+}
+
 //
 // -=- VNCServerST Implementation
 //
@@ -80,9 +113,13 @@ VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
     name(strDup(name_)), pointerClient(0), clipboardClient(0),
     comparer(0), cursor(new Cursor(0, 0, Point(), NULL)),
     renderedCursorInvalid(false),
+    encodeCache(EncodeCacheMaxSize), encodeCacheActive(false),
+    grabFrames(0), grabTimeTotal(0), grabTimeMax(0),
+    lastDamage(0), burstStart(0), lastFrame(0),
+    burstPending(false), damageInterval(0),
     keyRemapper(&KeyRemapper::defInstance),
     idleTimer(this), disconnectTimer(this), connectTimer(this),
-    frameTimer(this)
+    frameTimer(this), statsTimer(this)
 {
   slog.debug("creating single-threaded server %s", name.buf);
 
@@ -91,6 +128,26 @@ VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
     idleTimer.start(secsToMillis(rfb::Server::maxIdleTime));
   if (rfb::Server::maxDisconnectionTime)
     disconnectTimer.start(secsToMillis(rfb::Server::maxDisconnectionTime));
+
+  CharArray statsFile(rfb::Server::statsFile.getData());
+  if (statsFile.buf[0] != '\0')
+    statsTimer.start(secsToMillis(rfb::Server::statsInterval));
+
+  wakeupPipe[0] = wakeupPipe[1] = -1;
+#ifndef WIN32
+  if (rfb::Server::clientThreads) {
+    if (pipe(wakeupPipe) < 0) {
+      slog.error("Failed to create wakeup pipe: %s", strerror(errno));
+      wakeupPipe[0] = wakeupPipe[1] = -1;
+    } else {
+      for (int i = 0; i < 2; i++) {
+        fcntl(wakeupPipe[i], F_SETFL,
+              fcntl(wakeupPipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wakeupPipe[i], F_SETFD, FD_CLOEXEC);
+      }
+    }
+  }
+#endif
 }
 
 VNCServerST::~VNCServerST()
@@ -119,6 +176,13 @@ VNCServerST::~VNCServerST()
   delete comparer;
 
   delete cursor;
+
+#ifndef WIN32
+  if (wakeupPipe[0] != -1) {
+    close(wakeupPipe[0]);
+    close(wakeupPipe[1]);
+  }
+#endif
 }
 
 
@@ -227,6 +291,32 @@ void VNCServerST::processSocketWriteEvent(network::Socket* sock)
   throw rdr::Exception("invalid Socket in VNCServerST");
 }
 
+void VNCServerST::processWakeup()
+{
+  std::list<VNCSConnectionST*>::iterator ci, ci_next;
+
+#ifndef WIN32
+  char buf[64];
+
+  while (read(wakeupPipe[0], buf, sizeof(buf)) > 0)
+    ;
+#endif
+
+  for (ci = clients.begin(); ci != clients.end(); ci = ci_next) {
+    ci_next = ci; ci_next++;
+    (*ci)->finishUpdateOrClose();
+  }
+}
+
+void VNCServerST::wakeup()
+{
+#ifndef WIN32
+  // A full pipe means a wakeup is already pending
+  if (write(wakeupPipe[1], "", 1) < 0)
+    return;
+#endif
+}
+
 // VNCServer methods
 
 void VNCServerST::blockUpdates()
@@ -398,6 +488,7 @@ void VNCServerST::add_changed(const Region& region)
     return;
 
   comparer->add_changed(region);
+  noteDamage();
   startFrameClock();
 }
 
@@ -407,6 +498,7 @@ void VNCServerST::add_copied(const Region& dest, const Point& delta)
     return;
 
   comparer->add_copied(dest, delta);
+  noteDamage();
   startFrameClock();
 }
 
@@ -602,19 +694,41 @@ SConnection* VNCServerST::getConnection(network::Socket* sock) {
 bool VNCServerST::handleTimeout(Timer* t)
 {
   if (t == &frameTimer) {
-    // We keep running until we go a full interval without any updates
+    rdr::U64 now;
+    unsigned interval, sinceDamage, burstAge;
+
     if (comparer->is_empty())
       return false;
 
-    writeUpdate();
+    interval = 1000/rfb::Server::frameRate;
+    now = getTimeMs();
+    sinceDamage = elapsedMs(lastDamage, now);
+    burstAge = elapsedMs(burstStart, now);
+
+    // Is the application still drawing? Then wait for it to finish so
+    // we don't send half a frame, unless it has kept going for a full
+    // frame interval already.
+    if ((sinceDamage < frameSettleTime) && (burstAge < interval)) {
+      frameTimer.start(__rfbmin(frameSettleTime - sinceDamage,
+                                interval - burstAge));
+      return false;
+    }
 
-    // If this is the first iteration then we need to adjust the timeout
-    if (frameTimer.getTimeoutMs() != 1000/rfb::Server::frameRate) {
-      frameTimer.start(1000/rfb::Server::frameRate);
+    // No point in handing out a new frame if every client is still busy
+    // with the previous one. Keep aggregating changes for a while
+    // instead, as that gives the clients less data to deal with.
+    if ((burstAge < maxFrameDelay) && clientsBusy()) {
+      frameTimer.start(interval);
       return false;
     }
 
-    return true;
+    writeUpdate();
+
+    burstPending = false;
+    lastFrame = getTimeMs();
+
+    // The next change will restart the clock
+    return false;
   } else if (t == &idleTimer) {
     slog.info("MaxIdleTime reached, exiting");
     desktop->terminate();
@@ -624,6 +738,16 @@ bool VNCServerST::handleTimeout(Timer* t)
   } else if (t == &connectTimer) {
     slog.info("MaxConnectionTime reached, exiting");
     desktop->terminate();
+  } else if (t == &statsTimer) {
+    CharArray statsFile(rfb::Server::statsFile.getData());
+
+    // The settings might have been changed since we started
+    if (statsFile.buf[0] == '\0')
+      return false;
+
+    writeStats(statsFile.buf);
+
+    statsTimer.start(secsToMillis(rfb::Server::statsInterval));
   }
 
   return false;
@@ -733,6 +857,9 @@ inline bool VNCServerST::needRenderedCursor()
 
 void VNCServerST::startFrameClock()
 {
+  unsigned interval, sinceFrame;
+  int delay;
+
   if (frameTimer.isStarted())
     return;
   if (blockCounter > 0)
@@ -740,10 +867,25 @@ void VNCServerST::startFrameClock()
   if (!desktopStarted)
     return;
 
-  // The first iteration will be just half a frame as we get a very
-  // unstable update rate if we happen to be perfectly in sync with
-  // the application's update rate
-  frameTimer.start(1000/rfb::Server::frameRate/2);
+  // Give the application a moment to finish drawing, but don't send
+  // frames any faster than the frame rate allows
+  interval = 1000/rfb::Server::frameRate;
+  if (lastFrame == 0)
+    delay = frameSettleTime;
+  else {
+    sinceFrame = elapsedMs(lastFrame, getTimeMs());
+    if (sinceFrame >= interval)
+      delay = 0;
+    else
+      delay = interval - sinceFrame;
+  }
+
+  if (delay > (int)interval)
+    delay = interval;
+  if (delay < (int)frameSettleTime)
+    delay = frameSettleTime;
+
+  frameTimer.start(delay);
 }
 
 void VNCServerST::stopFrameClock()
@@ -751,15 +893,70 @@ void VNCServerST::stopFrameClock()
   frameTimer.stop();
 }
 
+void VNCServerST::noteDamage()
+{
+  rdr::U64 now;
+
+  now = getTimeMs();
+
+  // Keep track of how often the application starts drawing something
+  // new, so we know how much time the clients have between frames
+  if (!burstPending) {
+    if (burstStart != 0) {
+      unsigned gap;
+
+      gap = elapsedMs(burstStart, now);
+      if (gap > maxDamageInterval)
+        gap = maxDamageInterval;
+
+      damageInterval = (damageInterval * 3 + gap) / 4;
+    }
+
+    burstStart = now;
+    burstPending = true;
+  }
+
+  lastDamage = now;
+}
+
+bool VNCServerST::clientsBusy()
+{
+  std::list<VNCSConnectionST*>::iterator ci;
+
+  if (clients.empty())
+    return false;
+
+  for (ci = clients.begin(); ci != clients.end(); ci++) {
+    if (!(*ci)->isBusy())
+      return false;
+  }
+
+  return true;
+}
+
 int VNCServerST::msToNextUpdate()
 {
-  // FIXME: If the application is updating slower than frameRate then
-  //        we could allow the clients more time here
+  int interval, remaining;
+  unsigned burstAge;
 
-  if (!frameTimer.isStarted())
-    return 1000/rfb::Server::frameRate/2;
-  else
+  if (frameTimer.isStarted())
     return frameTimer.getRemainingMs();
+
+  // Nothing pending, so guess when the application will draw next
+  // based on how often it has been doing so
+  interval = 1000/rfb::Server::frameRate;
+  burstAge = elapsedMs(burstStart, getTimeMs());
+  if (burstAge >= damageInterval + frameSettleTime)
+    remaining = 0;
+  else
+    remaining = damageInterval + frameSettleTime - burstAge;
+
+  if (remaining < interval/2)
+    remaining = interval/2;
+  if (remaining > (int)maxFrameDelay)
+    remaining = maxFrameDelay;
+
+  return remaining;
 }
 
 // writeUpdate() is called on a regular interval in order to see what
@@ -773,6 +970,8 @@ void VNCServerST::writeUpdate()
 {
   UpdateInfo ui;
   Region toCheck;
+  struct timeval grabStart, grabEnd;
+  unsigned grabTime;
 
   std::list<VNCSConnectionST*>::iterator ci, ci_next;
 
@@ -791,7 +990,20 @@ void VNCServerST::writeUpdate()
       renderedCursorInvalid = true;
   }
 
+  gettimeofday(&grabStart, NULL);
   pb->grabRegion(toCheck);
+  gettimeofday(&grabEnd, NULL);
+
+  grabTime = (grabEnd.tv_sec - grabStart.tv_sec) * 1000000 +
+             (grabEnd.tv_usec - grabStart.tv_usec);
+
+  grabFrames++;
+  grabTimeTotal += grabTime;
+  if (grabTime > grabTimeMax)
+    grabTimeMax = grabTime;
+
+  comparer->setHashing(rfb::Server::compareFB == 3);
+  comparer->setScrollDetection(rfb::Server::detectScrolling);
 
   if (getComparerState())
     comparer->enable();
@@ -803,12 +1015,19 @@ void VNCServerST::writeUpdate()
 
   comparer->clear();
 
+  // The framebuffer will not change until all clients have been
+  // updated, so they can share any identical encoding work
+  encodeCacheActive = clients.size() > 1;
+
   for (ci = clients.begin(); ci != clients.end(); ci = ci_next) {
     ci_next = ci; ci_next++;
     (*ci)->add_copied(ui.copied, ui.copy_delta);
     (*ci)->add_changed(ui.changed);
     (*ci)->writeFramebufferUpdateOrClose();
   }
+
+  encodeCacheActive = false;
+  encodeCache.clear();
 }
 
 // checkUpdate() is called by clients to see if it is safe to read from
@@ -841,6 +1060,14 @@ const RenderedCursor* VNCServerST::getRenderedCursor()
   return &renderedCursor;
 }
 
+EncodeCache* VNCServerST::getEncodeCache()
+{
+  if (!encodeCacheActive)
+    return NULL;
+
+  return &encodeCache;
+}
+
 bool VNCServerST::getComparerState()
 {
   if (rfb::Server::compareFB == 0)
@@ -856,3 +1083,69 @@ bool VNCServerST::getComparerState()
   }
   return false;
 }
+
+rdr::U64 VNCServerST::getTimeMs()
+{
+  return Timer::getTimeMs();
+}
+
+// writeStats() replaces the given file with the current statistics for
+// all clients. The file is written elsewhere first and then renamed so
+// that readers never see a partial file.
+
+void VNCServerST::writeStats(const char* filename)
+{
+  CharArray tmpName(strlen(filename) + 5);
+  FILE* f;
+  bool first;
+
+  sprintf(tmpName.buf, "%s.tmp", filename);
+
+  f = fopen(tmpName.buf, "w");
+  if (f == NULL) {
+    slog.error("Could not open %s: %s", tmpName.buf, strerror(errno));
+    return;
+  }
+
+  fprintf(f, "{\"time\": %lld", (long long)time(NULL));
+  fprintf(f, ", \"grab_frames\": %u", grabFrames);
+  fprintf(f, ", \"grab_time_total_us\": %llu", grabTimeTotal);
+  fprintf(f, ", \"grab_time_max_us\": %u", grabTimeMax);
+  fprintf(f, ", \"clients\": [");
+
+  // The maximum is only for the time since the last call
+  grabTimeMax = 0;
+
+  first = true;
+
+  try {
+    std::list<VNCSConnectionST*>::iterator ci;
+    for (ci = clients.begin(); ci != clients.end(); ++ci) {
+      if (!(*ci)->authenticated())
+        continue;
+
+      if (!first)
+        fprintf(f, ", ");
+      first = false;
+
+      (*ci)->writeStats(f);
+    }
+  } catch (...) {
+    fclose(f);
+    remove(tmpName.buf);
+    throw;
+  }
+
+  fprintf(f, "]}\n");
+
+  if (fclose(f) != 0) {
+    slog.error("Could not write %s: %s", tmpName.buf, strerror(errno));
+    remove(tmpName.buf);
+    return;
+  }
+
+  if (rename(tmpName.buf, filename) != 0) {
+    slog.error("Could not rename %s: %s", tmpName.buf, strerror(errno));
+    remove(tmpName.buf);
+  }
+}
@@ -30,6 +30,7 @@
 #include <rfb/VNCServer.h>
 #include <rfb/Blacklist.h>
 #include <rfb/Cursor.h>
+#include <rfb/EncodeCache.h>
 #include <rfb/Timer.h>
 #include <rfb/ScreenSet.h>
 
@@ -76,6 +77,17 @@ namespace rfb {
     //   Flush pending data from the Socket on to the network.
     virtual void processSocketWriteEvent(network::Socket* sock);
 
+    // getWakeupFd() returns a file descriptor that becomes readable
+    // when processWakeup() needs to be called, or -1 if that is never
+    // needed. This is used to send updates that have been encoded on
+    // other threads when ClientThreads is enabled.
+    int getWakeupFd() const { return wakeupPipe[0]; }
+    void processWakeup();
+
+    // wakeup() makes the wakeup file descriptor readable. It can be
+    // called from any thread.
+    void wakeup();
+
 
     // Methods overridden from VNCServer
 
@@ -152,6 +164,11 @@ namespace rfb {
     // side rendered cursor buffer
     const RenderedCursor* getRenderedCursor();
 
+    // getEncodeCache() returns the cache of encoded rects that can be
+    // shared by all clients for the frame currently being sent, or
+    // NULL if no such frame is being sent
+    EncodeCache* getEncodeCache();
+
   protected:
 
     // Timer callbacks
@@ -166,12 +183,20 @@ namespace rfb {
     int authClientCount();
 
     bool needRenderedCursor();
+    void noteDamage();
+    bool clientsBusy();
     void startFrameClock();
     void stopFrameClock();
     void writeUpdate();
 
     bool getComparerState();
 
+    // getTimeMs() returns the current time in milliseconds, and can be
+    // overridden to control the passing of time
+    virtual rdr::U64 getTimeMs();
+
+    void writeStats(const char* filename);
+
   protected:
     Blacklist blacklist;
     Blacklist* blHosts;
@@ -198,6 +223,24 @@ namespace rfb {
     RenderedCursor renderedCursor;
     bool renderedCursorInvalid;
 
+    EncodeCache encodeCache;
+    bool encodeCacheActive;
+
+    // Time spent reading the screen in writeUpdate(), in microseconds
+    unsigned grabFrames;
+    unsigned long long grabTimeTotal;
+    unsigned grabTimeMax;
+
+    // When the application last changed the framebuffer, when it
+    // started the changes not yet sent, and when we last sent a frame
+    // (ms on the Timer clock, zero if it hasn't happened yet)
+    rdr::U64 lastDamage;
+    rdr::U64 burstStart;
+    rdr::U64 lastFrame;
+    bool burstPending;
+    // Estimated time between the application's bursts of drawing (ms)
+    unsigned damageInterval;
+
     KeyRemapper* keyRemapper;
 
     Timer idleTimer;
@@ -205,6 +248,9 @@ namespace rfb {
     Timer connectTimer;
 
     Timer frameTimer;
+    Timer statsTimer;
+
+    int wakeupPipe[2];
   };
 
 };
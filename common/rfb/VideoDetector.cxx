@@ -0,0 +1,204 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <sys/time.h>
+
+#include <rfb/VideoDetector.h>
+
+using namespace rfb;
+
+// Size of the areas that are tracked individually
+static const int VideoTileSize = 64;
+
+// How much history is kept, as a number of windows of a given length
+static const unsigned VideoWindowMs = 100;
+static const unsigned VideoWindows = 10;
+
+// An area needs to have changed in this many of the recent windows to
+// be considered video, and then stays so until it has changed in no
+// more than the lower number of windows
+static const int VideoEnterWindows = 8;
+static const int VideoLeaveWindows = 2;
+
+static int countWindows(rdr::U16 history)
+{
+  int count;
+
+  count = 0;
+  while (history != 0) {
+    history &= history - 1;
+    count++;
+  }
+
+  return count;
+}
+
+VideoDetector::VideoDetector()
+  : width(0), height(0), tilesX(0), tilesY(0), windowStart(0),
+    videoRegionValid(true)
+{
+}
+
+VideoDetector::~VideoDetector()
+{
+}
+
+void VideoDetector::setSize(int width_, int height_)
+{
+  if ((width_ == width) && (height_ == height))
+    return;
+
+  width = width_;
+  height = height_;
+
+  tilesX = (width + VideoTileSize - 1) / VideoTileSize;
+  tilesY = (height + VideoTileSize - 1) / VideoTileSize;
+
+  history.assign(tilesX * tilesY, 0);
+  video.assign(tilesX * tilesY, false);
+
+  windowStart = getTimeMs();
+
+  videoRegion.clear();
+  videoRegionValid = true;
+}
+
+void VideoDetector::add(const Region& changed)
+{
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator rect;
+
+  age();
+
+  changed.get_rects(&rects);
+  for (rect = rects.begin(); rect != rects.end(); ++rect) {
+    Rect r;
+
+    r = rect->intersect(Rect(0, 0, width, height));
+    if (r.is_empty())
+      continue;
+
+    for (int ty = r.tl.y / VideoTileSize;
+         ty <= (r.br.y - 1) / VideoTileSize; ty++) {
+      for (int tx = r.tl.x / VideoTileSize;
+           tx <= (r.br.x - 1) / VideoTileSize; tx++) {
+        int index;
+
+        index = ty * tilesX + tx;
+
+        history[index] |= 1;
+
+        if (!video[index] &&
+            (countWindows(history[index]) >= VideoEnterWindows)) {
+          video[index] = true;
+          videoRegionValid = false;
+        }
+      }
+    }
+  }
+}
+
+const Region& VideoDetector::getVideoRegion()
+{
+  age();
+
+  if (videoRegionValid)
+    return videoRegion;
+
+  videoRegion.clear();
+
+  // Each row of tiles is added as runs, to keep the number of
+  // operations on the region down
+  for (int ty = 0; ty < tilesY; ty++) {
+    int tx;
+
+    tx = 0;
+    while (tx < tilesX) {
+      int start;
+      Rect r;
+
+      if (!video[ty * tilesX + tx]) {
+        tx++;
+        continue;
+      }
+
+      start = tx;
+      while ((tx < tilesX) && video[ty * tilesX + tx])
+        tx++;
+
+      r.setXYWH(start * VideoTileSize, ty * VideoTileSize,
+                (tx - start) * VideoTileSize, VideoTileSize);
+      videoRegion.assign_union(Region(r.intersect(Rect(0, 0,
+                                                       width, height))));
+    }
+  }
+
+  videoRegionValid = true;
+
+  return videoRegion;
+}
+
+void VideoDetector::age()
+{
+  rdr::U64 now;
+  unsigned windows;
+
+  now = getTimeMs();
+
+  // Don't get confused if the clock goes backwards
+  if (now < windowStart) {
+    windowStart = now;
+    return;
+  }
+
+  if (now - windowStart < VideoWindowMs)
+    return;
+
+  if (now - windowStart >= VideoWindowMs * VideoWindows)
+    windows = VideoWindows;
+  else
+    windows = (now - windowStart) / VideoWindowMs;
+
+  windowStart += (now - windowStart) / VideoWindowMs * VideoWindowMs;
+
+  for (size_t i = 0; i < history.size(); i++) {
+    if (windows >= VideoWindows)
+      history[i] = 0;
+    else
+      history[i] = (history[i] << windows) & ((1 << VideoWindows) - 1);
+
+    if (video[i] && (countWindows(history[i]) <= VideoLeaveWindows)) {
+      video[i] = false;
+      videoRegionValid = false;
+    }
+  }
+}
+
+rdr::U64 VideoDetector::getTimeMs()
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return (rdr::U64)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
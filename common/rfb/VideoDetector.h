@@ -0,0 +1,75 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+// -=- VideoDetector.h
+//
+// Keeps track of how often each part of the screen changes, in order
+// to find the areas that are showing video or animations. Those keep
+// changing at a steady rate and can be sent with lower quality, as
+// any detail is quickly replaced anyway.
+
+#ifndef __RFB_VIDEODETECTOR_H__
+#define __RFB_VIDEODETECTOR_H__
+
+#include <vector>
+
+#include <rdr/types.h>
+#include <rfb/Region.h>
+
+namespace rfb {
+
+  class VideoDetector {
+  public:
+    VideoDetector();
+    virtual ~VideoDetector();
+
+    // setSize() must be called with the size of the framebuffer before
+    // anything is added. Nothing happens if the size is unchanged.
+    void setSize(int width, int height);
+
+    // add() records that the region has changed
+    void add(const Region& changed);
+
+    // getVideoRegion() returns the areas that have been changing
+    // steadily for a while
+    const Region& getVideoRegion();
+
+  protected:
+    void age();
+
+    // getTimeMs() returns the current time in milliseconds, and can be
+    // overridden to control the passing of time
+    virtual rdr::U64 getTimeMs();
+
+  private:
+    int width, height;
+    int tilesX, tilesY;
+
+    // For each tile, a bit for each of the recent windows of time in
+    // which it changed, the current window being the lowest bit
+    std::vector<rdr::U16> history;
+    std::vector<bool> video;
+    rdr::U64 windowStart;
+
+    Region videoRegion;
+    bool videoRegionValid;
+  };
+
+}
+
+#endif
@@ -81,7 +81,7 @@ void ZRLEEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 
   zos.flush();
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU32(mos.length());
   os->writeBytes(mos.data(), mos.length());
@@ -106,7 +106,7 @@ void ZRLEEncoder::writeSolidRect(int width, int height,
 
   zos.flush();
 
-  os = conn->getOutStream();
+  os = getOutStream();
 
   os->writeU32(mos.length());
   os->writeBytes(mos.data(), mos.length());
@@ -66,6 +66,14 @@ namespace rfb {
   // UltraVNC-specific
   const int pseudoEncodingExtendedClipboard = 0xC0A1E5CE;
 
+  // Experimental and private to this implementation. These numbers
+  // are not registered and may change, so they must only be used
+  // between our own viewer and server.
+  const int pseudoEncodingContentCache = 0x54564343;
+  const int pseudoEncodingServerScale = 0x54565343;
+  const int pseudoEncodingTightParallel = 0x54565450;
+  const int pseudoEncodingSharedFramebuffer = 0x54565346;
+
   int encodingNum(const char* name);
   const char* encodingName(int num);
 }
@@ -40,6 +40,8 @@ namespace rfb {
   const int msgTypePointerEvent = 5;
   const int msgTypeClientCutText = 6;
 
+  const int msgTypeSetScale = 8;
+
   const int msgTypeEnableContinuousUpdates = 150;
 
   const int msgTypeClientFence = 248;
@@ -622,4 +622,90 @@ namespace rfb {
                     sizeof(iecPrefixes)/sizeof(*iecPrefixes),
                     precision);
   }
+
+  // A 64-bit hash in the style of xxHash64, fed the rows one after
+  // another. It is not compatible with the real thing, but mixes just
+  // as well and keeps four independent lanes so the multiplications
+  // can run in parallel.
+
+  static const rdr::U64 prime1 = 11400714785074694791ULL;
+  static const rdr::U64 prime2 = 14029467366897019727ULL;
+  static const rdr::U64 prime3 = 1609587929392839161ULL;
+  static const rdr::U64 prime4 = 9650029242287828579ULL;
+
+  static inline rdr::U64 rotl64(rdr::U64 x, int r)
+  {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  static inline rdr::U64 read64(const rdr::U8* p)
+  {
+    rdr::U64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static inline rdr::U64 hashRound(rdr::U64 acc, rdr::U64 input)
+  {
+    acc += input * prime2;
+    acc = rotl64(acc, 31);
+    acc *= prime1;
+    return acc;
+  }
+
+  rdr::U64 hashRect(const void* buffer, int rowBytes,
+                    int strideBytes, int rows)
+  {
+    const rdr::U8* data;
+    rdr::U64 v1, v2, v3, v4, hash;
+
+    data = (const rdr::U8*)buffer;
+
+    v1 = prime1 + prime2;
+    v2 = prime2;
+    v3 = 0;
+    v4 = -prime1;
+
+    while (rows--) {
+      const rdr::U8* p;
+      int left;
+
+      p = data;
+      left = rowBytes;
+
+      while (left >= 32) {
+        v1 = hashRound(v1, read64(p));
+        v2 = hashRound(v2, read64(p + 8));
+        v3 = hashRound(v3, read64(p + 16));
+        v4 = hashRound(v4, read64(p + 24));
+        p += 32;
+        left -= 32;
+      }
+
+      while (left >= 8) {
+        v1 = hashRound(v1, read64(p));
+        p += 8;
+        left -= 8;
+      }
+
+      while (left > 0) {
+        v2 = hashRound(v2, *p);
+        p++;
+        left--;
+      }
+
+      data += strideBytes;
+    }
+
+    hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    hash += (rdr::U64)rowBytes * prime3;
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash ^ prime4;
+  }
 };
@@ -31,6 +31,8 @@
 #include <limits.h>
 #include <string.h>
 
+#include <rdr/types.h>
+
 struct timeval;
 
 #ifdef __GNUC__
@@ -135,6 +137,11 @@ namespace rfb {
                   char *buffer, size_t maxlen, int precision=6);
   size_t iecPrefix(long long value, const char *unit,
                    char *buffer, size_t maxlen, int precision=6);
+
+  // Fast, non-cryptographic, hash of a rectangular area of memory,
+  // e.g. a part of a framebuffer
+  rdr::U64 hashRect(const void* buffer, int rowBytes,
+                    int strideBytes, int rows);
 }
 
 // Some platforms (e.g. Windows) include max() and min() macros in their
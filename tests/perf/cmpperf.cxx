@@ -0,0 +1,289 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program measures how fast ComparingUpdateTracker can find the
+ * changed parts of the framebuffer, compared to the simple row by row
+ * memcmp() that it used to do. The normal mode, the mode that only
+ * keeps block hashes and the mode that also looks for scrolling are
+ * tested.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rfb/ComparingUpdateTracker.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+
+#include "util.h"
+
+static const int fbwidth = 1920;
+static const int fbheight = 1080;
+static const int block = 64;
+static const int iterations = 100;
+static const int runs = 5;
+
+typedef void (*changefn)(rfb::ManagedPixelBuffer* pb, int iteration);
+
+struct ChangeEntry {
+  const char *label;
+  changefn fn;
+};
+
+typedef double (*testfn)(rfb::ManagedPixelBuffer* pb, changefn change);
+
+struct TestEntry {
+  const char *label;
+  testfn fn;
+};
+
+static void changeNothing(rfb::ManagedPixelBuffer* pb, int iteration)
+{
+}
+
+static void changeSparse(rfb::ManagedPixelBuffer* pb, int iteration)
+{
+  rdr::U32* buffer;
+  int stride;
+
+  // One pixel in every block
+  buffer = (rdr::U32*)pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = iteration % block; y < fbheight; y += block) {
+    for (int x = iteration % block; x < fbwidth; x += block)
+      buffer[y * stride + x] ^= 0xffffff;
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static void changeText(rfb::ManagedPixelBuffer* pb, int iteration)
+{
+  rdr::U32* buffer;
+  int stride;
+
+  // A line of "text" every 16 lines in the left half of the screen
+  buffer = (rdr::U32*)pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = (iteration % 16); y < fbheight; y += 16) {
+    for (int x = 0; x < fbwidth / 2; x++) {
+      if ((x + iteration) % 3 == 0)
+        buffer[y * stride + x] ^= 0xffffff;
+    }
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static void changeAll(rfb::ManagedPixelBuffer* pb, int iteration)
+{
+  rdr::U32* buffer;
+  int stride;
+
+  buffer = (rdr::U32*)pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = 0; y < fbheight; y++) {
+    for (int x = 0; x < fbwidth; x++)
+      buffer[y * stride + x] = x * y + iteration;
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static void changeScroll(rfb::ManagedPixelBuffer* pb, int iteration)
+{
+  rdr::U32* buffer;
+  int stride;
+
+  // Scroll a "terminal" in the middle of the screen up by one line of
+  // text and draw a new line at the bottom
+  buffer = (rdr::U32*)pb->getBufferRW(pb->getRect(), &stride);
+  for (int y = fbheight / 8; y < fbheight * 7 / 8 - 16; y++) {
+    memmove(&buffer[y * stride + fbwidth / 8],
+            &buffer[(y + 16) * stride + fbwidth / 8],
+            fbwidth * 3 / 4 * 4);
+  }
+  for (int y = fbheight * 7 / 8 - 16; y < fbheight * 7 / 8; y++) {
+    for (int x = fbwidth / 8; x < fbwidth * 7 / 8; x++)
+      buffer[y * stride + x] = (x + iteration) % 7 ? 0 : 0xffffff;
+  }
+  pb->commitBufferRW(pb->getRect());
+}
+
+static double testMemcmp(rfb::ManagedPixelBuffer* pb, changefn change)
+{
+  rdr::U8 *oldFb;
+  const rdr::U8 *newFb;
+  int stride;
+  double time;
+
+  // This is the algorithm ComparingUpdateTracker used to have, i.e.
+  // stop at the first differing row and mark the whole block
+
+  oldFb = new rdr::U8[fbwidth * fbheight * 4];
+  newFb = pb->getBuffer(pb->getRect(), &stride);
+  memcpy(oldFb, newFb, fbwidth * fbheight * 4);
+
+  time = 0.0;
+
+  for (int i = 0; i < iterations; i++) {
+    change(pb, i);
+
+    startCpuCounter();
+
+    for (int by = 0; by < fbheight; by += block) {
+      int bh = (by + block > fbheight) ? fbheight - by : block;
+      for (int bx = 0; bx < fbwidth; bx += block) {
+        int bw = (bx + block > fbwidth) ? fbwidth - bx : block;
+        for (int y = by; y < by + bh; y++) {
+          size_t offset = (y * fbwidth + bx) * 4;
+          if (memcmp(oldFb + offset, newFb + offset, bw * 4) != 0) {
+            for (; y < by + bh; y++) {
+              offset = (y * fbwidth + bx) * 4;
+              memcpy(oldFb + offset, newFb + offset, bw * 4);
+            }
+            break;
+          }
+        }
+      }
+    }
+
+    endCpuCounter();
+
+    time += getCpuCounter();
+  }
+
+  delete [] oldFb;
+
+  return time;
+}
+
+static double runTracker(rfb::ManagedPixelBuffer* pb, changefn change,
+                         bool hashing, bool scrolling)
+{
+  rfb::ComparingUpdateTracker tracker(pb);
+  double time;
+
+  tracker.setHashing(hashing);
+  tracker.setScrollDetection(scrolling);
+
+  // The first round just takes a copy of the framebuffer
+  tracker.compare();
+  tracker.clear();
+
+  time = 0.0;
+
+  for (int i = 0; i < iterations; i++) {
+    change(pb, i);
+
+    tracker.add_changed(pb->getRect());
+
+    startCpuCounter();
+    tracker.compare();
+    endCpuCounter();
+
+    time += getCpuCounter();
+
+    tracker.clear();
+  }
+
+  return time;
+}
+
+static double testTracker(rfb::ManagedPixelBuffer* pb, changefn change)
+{
+  return runTracker(pb, change, false, false);
+}
+
+static double testHashing(rfb::ManagedPixelBuffer* pb, changefn change)
+{
+  return runTracker(pb, change, true, false);
+}
+
+static double testScrolling(rfb::ManagedPixelBuffer* pb, changefn change)
+{
+  return runTracker(pb, change, false, true);
+}
+
+static struct ChangeEntry changes[] = {
+  {"Unchanged", changeNothing},
+  {"Sparse", changeSparse},
+  {"Text", changeText},
+  {"Full", changeAll},
+  {"Scroll", changeScroll},
+};
+
+static struct TestEntry tests[] = {
+  {"memcmp", testMemcmp},
+  {"ComparingUpdateTracker", testTracker},
+  {"ComparingUpdateTracker (hashed)", testHashing},
+  {"ComparingUpdateTracker (scrolling)", testScrolling},
+};
+
+int main(int argc, char **argv)
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+  rfb::ManagedPixelBuffer pb(pf, fbwidth, fbheight);
+
+  time_t t;
+  char datebuffer[256];
+
+  size_t i, j;
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Framebuffer Comparison Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Frame buffer: %dx%d pixels\n", fbwidth, fbheight);
+  printf("# Iterations: %d (best of %d runs)\n", iterations, runs);
+  printf("#\n");
+  printf("# Note: Results are Mpixels/sec\n");
+  printf("#\n");
+
+  printf("Change");
+  for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++)
+    printf(",%s", tests[i].label);
+  printf("\n");
+
+  for (i = 0;i < sizeof(changes)/sizeof(changes[0]);i++) {
+    printf("%s", changes[i].label);
+
+    for (j = 0;j < sizeof(tests)/sizeof(tests[0]);j++) {
+      double data, time;
+
+      // Use the best run to filter out noise from other processes
+      time = 0.0;
+      for (int run = 0;run < runs;run++) {
+        double runTime;
+
+        changeAll(&pb, 0);
+
+        runTime = tests[j].fn(&pb, changes[i].fn);
+        if ((run == 0) || (runTime < time))
+          time = runTime;
+      }
+
+      data = (double)fbwidth * fbheight * iterations;
+
+      printf(",%g", data / (1000.0*1000.0) / time);
+      fflush(stdout);
+    }
+
+    printf("\n");
+  }
+
+  return 0;
+}
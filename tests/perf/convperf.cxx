@@ -22,6 +22,7 @@
 #include <time.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 #include "util.h"
 
@@ -31,12 +32,39 @@ static const int fbsize = 4096;
 static rdr::U8 *fb1, *fb2;
 
 typedef void (*testfn) (rfb::PixelFormat&, rfb::PixelFormat&, rdr::U8*, rdr::U8*);
+typedef int (*bytesfn) (rfb::PixelFormat&, rfb::PixelFormat&);
 
 struct TestEntry {
   const char *label;
   testfn fn;
+  // How many bytes are read and written per pixel
+  bytesfn bytes;
 };
 
+static const rfb::SIMDLevel levels[] = {
+  rfb::simdNone, rfb::simdSSSE3, rfb::simdAVX2, rfb::simdNEON
+};
+
+static int bytesMemcpy(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
+{
+  return dstpf.bpp/8 * 2;
+}
+
+static int bytesBuffer(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
+{
+  return dstpf.bpp/8 + srcpf.bpp/8;
+}
+
+static int bytesToRGB(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
+{
+  return srcpf.bpp/8 + 3;
+}
+
+static int bytesFromRGB(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
+{
+  return 3 + dstpf.bpp/8;
+}
+
 static void testMemcpy(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf,
                        rdr::U8 *dst, rdr::U8 *src)
 {
@@ -67,7 +95,8 @@ static void testFromRGB(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf,
   dstpf.bufferFromRGB(dst, src, tile, fbsize, tile);
 }
 
-static void doTest(testfn fn, rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
+static void doTest(const TestEntry &test,
+                   rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
 {
   startCpuCounter();
 
@@ -78,26 +107,28 @@ static void doTest(testfn fn, rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
     y = rand() % (fbsize - tile);
     dst = fb1 + (x + y * fbsize) * dstpf.bpp/8;
     src = fb2 + (x + y * fbsize) * srcpf.bpp/8;
-    fn(dstpf, srcpf, dst, src);
+    test.fn(dstpf, srcpf, dst, src);
   }
 
   endCpuCounter();
 
   float data, time;
 
-  data = (double)tile * tile * 10000;
+  data = (double)tile * tile * 10000 * test.bytes(dstpf, srcpf);
   time = getCpuCounter();
 
-  printf("%g", data / (1000.0*1000.0) / time);
+  printf("%g", data / (1000.0*1000.0*1000.0) / time);
 }
 
 struct TestEntry tests[] = {
-  {"memcpy", testMemcpy},
-  {"bufferFromBuffer", testBuffer},
-  {"rgbFromBuffer", testToRGB},
-  {"bufferFromRGB", testFromRGB},
+  {"memcpy", testMemcpy, bytesMemcpy},
+  {"bufferFromBuffer", testBuffer, bytesBuffer},
+  {"rgbFromBuffer", testToRGB, bytesToRGB},
+  {"bufferFromRGB", testFromRGB, bytesFromRGB},
 };
 
+static const TestEntry bufferTest = {"bufferFromBuffer", testBuffer, bytesBuffer};
+
 static void doTests(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
 {
   size_t i;
@@ -110,8 +141,19 @@ static void doTests(rfb::PixelFormat &dstpf, rfb::PixelFormat &srcpf)
 
   for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++) {
     printf(",");
-    doTest(tests[i].fn, dstpf, srcpf);
+    doTest(tests[i], dstpf, srcpf);
+  }
+
+  // And then again for each implementation of the conversion that
+  // the CPU can handle
+  rfb::SIMDLevel best = rfb::getSIMDLevel();
+  for (i = 0;i < sizeof(levels)/sizeof(levels[0]);i++) {
+    if (!rfb::setSIMDLevel(levels[i]))
+      continue;
+    printf(",");
+    doTest(bufferTest, dstpf, srcpf);
   }
+  rfb::setSIMDLevel(best);
 
   printf("\n");
 }
@@ -143,12 +185,23 @@ int main(int argc, char **argv)
   printf("# Frame buffer: %dx%d pixels\n", fbsize, fbsize);
   printf("# Tile size: %dx%d pixels\n", tile, tile);
   printf("#\n");
-  printf("# Note: Results are Mpixels/sec\n");
+  printf("# Vectorised conversion: %s\n",
+         rfb::simdLevelName(rfb::getSIMDLevel()));
+  printf("#\n");
+  printf("# Note: Results are GB/sec, counting both bytes read and written\n");
   printf("#\n");
 
+  rfb::SIMDLevel best = rfb::getSIMDLevel();
+
   printf("Source format,Destination Format");
   for (i = 0;i < sizeof(tests)/sizeof(tests[0]);i++)
     printf(",%s", tests[i].label);
+  for (i = 0;i < sizeof(levels)/sizeof(levels[0]);i++) {
+    if (!rfb::setSIMDLevel(levels[i]))
+      continue;
+    printf(",%s (%s)", bufferTest.label, rfb::simdLevelName(levels[i]));
+  }
+  rfb::setSIMDLevel(best);
   printf("\n");
 
   rfb::PixelFormat dstpf, srcpf;
@@ -21,19 +21,28 @@
  * compare-encodings. It is basically a dump of the RFB protocol
  * from the server side from the ServerInit message and forward.
  * It is assumed that the client is using a bgr888 (LE) pixel
- * format.
+ * format. Such files can also be produced by encperf.
+ *
+ * The results can also be written as JSON, and the test can be
+ * repeated with different numbers of decoder threads.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <sys/time.h>
 
+#include <vector>
+
 #include <rdr/Exception.h>
 #include <rdr/FileInStream.h>
+#include <rdr/OutStream.h>
 
 #include <rfb/CConnection.h>
 #include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
+#include <rfb/Configuration.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/PixelFormat.h>
 
@@ -42,6 +51,20 @@
 // FIXME: Files are always in this format
 static const rfb::PixelFormat filePF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
 
+class DummyOutStream : public rdr::OutStream {
+public:
+  DummyOutStream();
+
+  virtual size_t length();
+  virtual void flush();
+
+private:
+  virtual size_t overrun(size_t itemSize, size_t nItems);
+
+  int offset;
+  rdr::U8 buf[131072];
+};
+
 class CConn : public rfb::CConnection {
 public:
   CConn(const char *filename);
@@ -52,33 +75,67 @@ public:
   virtual void setCursor(int, int, const rfb::Point&, const rdr::U8*);
   virtual void framebufferUpdateStart();
   virtual void framebufferUpdateEnd();
+  virtual void dataRect(const rfb::Rect&, int);
   virtual void setColourMapEntries(int, int, rdr::U16*);
   virtual void bell();
   virtual void serverCutText(const char*);
 
 public:
   double cpuTime;
+  unsigned long long pixels;
 
 protected:
   rdr::FileInStream *in;
+  DummyOutStream *out;
 };
 
+DummyOutStream::DummyOutStream()
+{
+  offset = 0;
+  ptr = buf;
+  end = buf + sizeof(buf);
+}
+
+size_t DummyOutStream::length()
+{
+  flush();
+  return offset;
+}
+
+void DummyOutStream::flush()
+{
+  offset += ptr - buf;
+  ptr = buf;
+}
+
+size_t DummyOutStream::overrun(size_t itemSize, size_t nItems)
+{
+  flush();
+  if (itemSize * nItems > (size_t)(end - ptr))
+    nItems = (end - ptr) / itemSize;
+  return nItems;
+}
+
 CConn::CConn(const char *filename)
 {
   cpuTime = 0.0;
+  pixels = 0;
 
   in = new rdr::FileInStream(filename);
-  setStreams(in, NULL);
+  out = new DummyOutStream;
+  setStreams(in, out);
 
   // Need to skip the initial handshake
   setState(RFBSTATE_INITIALISATION);
   // That also means that the reader and writer weren't setup
   setReader(new rfb::CMsgReader(this, in));
+  setWriter(new rfb::CMsgWriter(&server, out));
 }
 
 CConn::~CConn()
 {
   delete in;
+  delete out;
 }
 
 void CConn::initDone()
@@ -114,6 +171,13 @@ void CConn::framebufferUpdateEnd()
   cpuTime += getCpuCounter();
 }
 
+void CConn::dataRect(const rfb::Rect &r, int encoding)
+{
+  CConnection::dataRect(r, encoding);
+
+  pixels += r.area();
+}
+
 void CConn::setColourMapEntries(int, int, rdr::U16*)
 {
 }
@@ -130,6 +194,7 @@ struct stats
 {
   double decodeTime;
   double realTime;
+  unsigned long long pixels;
 };
 
 static struct stats runTest(const char *fn)
@@ -159,6 +224,7 @@ static struct stats runTest(const char *fn)
   gettimeofday(&stop, NULL);
 
   s.decodeTime = cc->cpuTime;
+  s.pixels = cc->pixels;
   s.realTime = (double)stop.tv_sec - start.tv_sec;
   s.realTime += ((double)stop.tv_usec - start.tv_usec)/1000000.0;
 
@@ -187,54 +253,194 @@ static void sort(double *array, int count)
 
 static const int runCount = 9;
 
-int main(int argc, char **argv)
+struct result
+{
+  int threads;
+  double cpuTime, cpuDev;
+  double coreUsage, coreDev;
+  double realTime;
+  unsigned long long pixels;
+};
+
+static void median(double *values, int count, double *median, double *meddev)
 {
+  double dev[runCount];
   int i;
+
+  sort(values, count);
+  *median = values[count/2];
+
+  for (i = 0;i < count;i++)
+    dev[i] = fabs((values[i] - *median) / *median) * 100;
+
+  sort(dev, count);
+  *meddev = dev[count/2];
+}
+
+static struct result measure(const char *fn, int threads)
+{
+  char value[32];
   struct stats runs[runCount];
-  double values[runCount], dev[runCount];
-  double median, meddev;
+  double values[runCount];
+  double dummy;
+  struct result r;
+  int i;
 
-  if (argc != 2) {
-    printf("Syntax: %s <rfb file>\n", argv[0]);
-    return 1;
-  }
+  snprintf(value, sizeof(value), "%d", threads);
+  rfb::Configuration::setParam("DecodeThreads", value);
 
   // Warmup
-  runTest(argv[1]);
+  runTest(fn);
 
   // Multiple runs to get a good average
   for (i = 0;i < runCount;i++)
-    runs[i] = runTest(argv[1]);
+    runs[i] = runTest(fn);
+
+  r.threads = threads;
+  r.pixels = runs[0].pixels;
 
   // Calculate median and median deviation for CPU usage
   for (i = 0;i < runCount;i++)
     values[i] = runs[i].decodeTime;
+  median(values, runCount, &r.cpuTime, &r.cpuDev);
 
-  sort(values, runCount);
-  median = values[runCount/2];
+  // And for CPU core usage
+  for (i = 0;i < runCount;i++)
+    values[i] = runs[i].decodeTime / runs[i].realTime;
+  median(values, runCount, &r.coreUsage, &r.coreDev);
 
+  // And the wall clock time, which is what more threads should improve
   for (i = 0;i < runCount;i++)
-    dev[i] = fabs((values[i] - median) / median) * 100;
+    values[i] = runs[i].realTime;
+  median(values, runCount, &r.realTime, &dummy);
 
-  sort(dev, runCount);
-  meddev = dev[runCount/2];
+  return r;
+}
 
-  printf("CPU time: %g s (+/- %g %%)\n", median, meddev);
+static void writeResult(FILE *f, const struct result *r, const char *indent)
+{
+  fprintf(f, "%s\"pixels\": %.0f,\n", indent, (double)r->pixels);
+  fprintf(f, "%s\"decode_cpu_s\": %g,\n", indent, r->cpuTime);
+  fprintf(f, "%s\"decode_cpu_dev_pct\": %g,\n", indent, r->cpuDev);
+  fprintf(f, "%s\"core_usage\": %g,\n", indent, r->coreUsage);
+  fprintf(f, "%s\"decode_wall_s\": %g,\n", indent, r->realTime);
+  fprintf(f, "%s\"wall_mpixels_per_s\": %g,\n", indent,
+          r->pixels / r->realTime / 1000000.0);
+  fprintf(f, "%s\"mpixels_per_s\": %g", indent,
+          r->pixels / r->cpuTime / 1000000.0);
+}
 
-  // And for CPU core usage
-  for (i = 0;i < runCount;i++)
-    values[i] = runs[i].decodeTime / runs[i].realTime;
+// parseThreads() parses a comma separated list of thread counts
+static bool parseThreads(const char *list, std::vector<int> *threads)
+{
+  while (*list != '\0') {
+    char *end;
+    long n;
 
-  sort(values, runCount);
-  median = values[runCount/2];
+    n = strtol(list, &end, 10);
+    if ((end == list) || (n < 1) || ((*end != ',') && (*end != '\0')))
+      return false;
 
-  for (i = 0;i < runCount;i++)
-    dev[i] = fabs((values[i] - median) / median) * 100;
+    threads->push_back(n);
 
-  sort(dev, runCount);
-  meddev = dev[runCount/2];
+    list = end;
+    if (*list == ',')
+      list++;
+  }
+
+  return !threads->empty();
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+  const char *fn, *json;
+  std::vector<int> threads;
+  std::vector<struct result> results;
+  FILE *f;
+
+  rfb::Configuration::enableViewerParams();
+
+  fn = NULL;
+  json = NULL;
+  for (i = 1;i < argc;i++) {
+    if ((strcmp(argv[i], "-json") == 0) && (i + 1 < argc)) {
+      json = argv[++i];
+      continue;
+    }
+
+    if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc)) {
+      if (!parseThreads(argv[++i], &threads)) {
+        fn = NULL;
+        break;
+      }
+      continue;
+    }
+
+    if ((argv[i][0] == '-') || (fn != NULL)) {
+      fn = NULL;
+      break;
+    }
+
+    fn = argv[i];
+  }
+
+  if (fn == NULL) {
+    printf("Syntax: %s [-json <output file>] [-threads <n>[,<n>...]] <rfb file>\n",
+           argv[0]);
+    return 1;
+  }
+
+  // Let the decoder pick the number of threads unless told otherwise
+  if (threads.empty())
+    threads.push_back(0);
+
+  for (i = 0;i < (int)threads.size();i++) {
+    struct result r;
+
+    r = measure(fn, threads[i]);
+    results.push_back(r);
+
+    if (r.threads != 0)
+      printf("Threads: %d\n", r.threads);
+
+    printf("CPU time: %g s (+/- %g %%)\n", r.cpuTime, r.cpuDev);
+    printf("Core usage: %g (+/- %g %%)\n", r.coreUsage, r.coreDev);
+
+    if (r.threads != 0) {
+      printf("Wall time: %g s (%g Mpixels/s)\n", r.realTime,
+             r.pixels / r.realTime / 1000000.0);
+      printf("\n");
+    }
+  }
+
+  if (json == NULL)
+    return 0;
+
+  f = fopen(json, "w");
+  if (f == NULL) {
+    printf("Failed to open %s\n", json);
+    return 1;
+  }
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"tool\": \"decperf\",\n");
+  fprintf(f, "  \"runs\": %d,\n", runCount);
+  writeResult(f, &results[0], "  ");
+  if (results[0].threads != 0) {
+    fprintf(f, ",\n");
+    fprintf(f, "  \"threads\": [\n");
+    for (i = 0;i < (int)results.size();i++) {
+      fprintf(f, "    {\n");
+      fprintf(f, "      \"threads\": %d,\n", results[i].threads);
+      writeResult(f, &results[i], "      ");
+      fprintf(f, "\n    }%s\n", i + 1 < (int)results.size() ? "," : "");
+    }
+    fprintf(f, "  ]");
+  }
+  fprintf(f, "\n}\n");
 
-  printf("Core usage: %g (+/- %g %%)\n", median, meddev);
+  fclose(f);
 
   return 0;
 }
@@ -24,13 +24,23 @@
  * the ServerInit message. Mostly this consists of FramebufferUpdate
  * message using the HexTile encoding. Screen size and pixel format
  * are not encoded in the file and must be specified by the user.
+ *
+ * The results can also be written as JSON, including statistics for
+ * each encoder, and the encoded stream can be saved in a format that
+ * decperf can read.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <sys/time.h>
 
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
 #include <rdr/Exception.h>
 #include <rdr/OutStream.h>
 #include <rdr/FileInStream.h>
@@ -39,6 +49,7 @@
 
 #include <rfb/CConnection.h>
 #include <rfb/CMsgReader.h>
+#include <rfb/CMsgWriter.h>
 #include <rfb/UpdateTracker.h>
 
 #include <rfb/EncodeManager.h>
@@ -57,6 +68,9 @@ static rfb::BoolParameter translate("translate",
                                     "Translate 8-bit and 16-bit datasets into 24-bit",
                                     true);
 
+static rfb::StringParameter json("json", "Also write the results as JSON to this file", "");
+static rfb::StringParameter save("save", "Save the encoded stream to this file, for use with decperf", "");
+
 // The frame buffer (and output) is always this format
 static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
 
@@ -67,9 +81,19 @@ static const rdr::S32 encodings[] = {
   rfb::pseudoEncodingQualityLevel0 + 8,
   rfb::pseudoEncodingCompressLevel0 + 2};
 
+struct EncoderResult {
+  unsigned long long rects;
+  unsigned long long pixels;
+  unsigned long long bytes;
+  unsigned long long equivalent;
+  std::vector<double> times;
+};
+
+typedef std::map<std::string, EncoderResult> EncoderResults;
+
 class DummyOutStream : public rdr::OutStream {
 public:
-  DummyOutStream();
+  DummyOutStream(FILE* f=NULL);
 
   virtual size_t length();
   virtual void flush();
@@ -78,18 +102,22 @@ private:
   virtual size_t overrun(size_t itemSize, size_t nItems);
 
   int offset;
+  FILE* file;
   rdr::U8 buf[131072];
 };
 
 class CConn : public rfb::CConnection {
 public:
-  CConn(const char *filename);
+  CConn(const char *filename, FILE* saveFile);
   ~CConn();
 
   void getStats(double& ratio, unsigned long long& bytes,
                 unsigned long long& rawEquivalent);
+  void getEncoderResults(EncoderResults* results);
+  double getAnalysisTime();
 
-  virtual void initDone();
+  virtual void initDone() {}
+  virtual void resizeFramebuffer();
   virtual void setCursor(int, int, const rfb::Point&, const rdr::U8*);
   virtual void framebufferUpdateStart();
   virtual void framebufferUpdateEnd();
@@ -104,6 +132,7 @@ public:
 
 protected:
   rdr::FileInStream *in;
+  DummyOutStream *out;
   rfb::SimpleUpdateTracker updates;
   class SConn *sc;
 };
@@ -113,16 +142,20 @@ public:
   Manager(class rfb::SConnection *conn);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  void getEncoderResults(EncoderResults* results);
+  double getAnalysisTime();
 };
 
 class SConn : public rfb::SConnection {
 public:
-  SConn();
+  SConn(FILE* saveFile);
   ~SConn();
 
   void writeUpdate(const rfb::UpdateInfo& ui, const rfb::PixelBuffer* pb);
 
   void getStats(double&, unsigned long long&, unsigned long long&);
+  void getEncoderResults(EncoderResults* results);
+  double getAnalysisTime();
 
   virtual void setAccessRights(AccessRights ar);
 
@@ -134,9 +167,10 @@ protected:
   Manager *manager;
 };
 
-DummyOutStream::DummyOutStream()
+DummyOutStream::DummyOutStream(FILE* f)
 {
   offset = 0;
+  file = f;
   ptr = buf;
   end = buf + sizeof(buf);
 }
@@ -149,6 +183,10 @@ size_t DummyOutStream::length()
 
 void DummyOutStream::flush()
 {
+  if ((file != NULL) && (ptr != buf)) {
+    if (fwrite(buf, ptr - buf, 1, file) != 1)
+      throw rdr::Exception("Failed to write encoded stream");
+  }
   offset += ptr - buf;
   ptr = buf;
 }
@@ -161,33 +199,41 @@ size_t DummyOutStream::overrun(size_t itemSize, size_t nItems)
   return nItems;
 }
 
-CConn::CConn(const char *filename)
+CConn::CConn(const char *filename, FILE* saveFile)
 {
   decodeTime = 0.0;
   encodeTime = 0.0;
 
   in = new rdr::FileInStream(filename);
-  setStreams(in, NULL);
+  out = new DummyOutStream;
+  setStreams(in, out);
 
   // Need to skip the initial handshake and ServerInit
   setState(RFBSTATE_NORMAL);
   // That also means that the reader and writer weren't setup
   setReader(new rfb::CMsgReader(this, in));
+  setWriter(new rfb::CMsgWriter(&server, out));
   // Nor the frame buffer size and format
   rfb::PixelFormat pf;
   pf.parse(format);
   setPixelFormat(pf);
   setDesktopSize(width, height);
 
-  sc = new SConn();
+  sc = new SConn(saveFile);
   sc->client.setPF((bool)translate ? fbPF : pf);
   sc->setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+
+  // decperf expects the stream to start with a ServerInit
+  if (saveFile != NULL)
+    sc->writer()->writeServerInit(width, height, sc->client.pf(),
+                                  "encperf");
 }
 
 CConn::~CConn()
 {
   delete sc;
   delete in;
+  delete out;
 }
 
 void CConn::getStats(double& ratio, unsigned long long& bytes,
@@ -196,7 +242,17 @@ void CConn::getStats(double& ratio, unsigned long long& bytes,
   sc->getStats(ratio, bytes, rawEquivalent);
 }
 
-void CConn::initDone()
+void CConn::getEncoderResults(EncoderResults* results)
+{
+  sc->getEncoderResults(results);
+}
+
+double CConn::getAnalysisTime()
+{
+  return sc->getAnalysisTime();
+}
+
+void CConn::resizeFramebuffer()
 {
   rfb::ModifiablePixelBuffer *pb;
 
@@ -261,6 +317,7 @@ void CConn::serverCutText(const char*)
 Manager::Manager(class rfb::SConnection *conn) :
   EncodeManager(conn)
 {
+  rectTiming = true;
 }
 
 void Manager::getStats(double& ratio, unsigned long long& encodedBytes,
@@ -283,9 +340,38 @@ void Manager::getStats(double& ratio, unsigned long long& encodedBytes,
   rawEquivalent = equivalent;
 }
 
-SConn::SConn()
+void Manager::getEncoderResults(EncoderResults* results)
 {
-  out = new DummyOutStream;
+  for (size_t i = 0; i < stats.size(); i++) {
+    for (size_t j = 0; j < stats[i].size(); j++) {
+      std::string name;
+      EncoderResult* result;
+
+      if (stats[i][j].rects == 0)
+        continue;
+
+      name = encoderClassName(i);
+      name += "/";
+      name += encoderTypeName(j);
+
+      result = &(*results)[name];
+      result->rects = stats[i][j].rects;
+      result->pixels = stats[i][j].pixels;
+      result->bytes = stats[i][j].bytes;
+      result->equivalent = stats[i][j].equivalent;
+      result->times = rectTimes[i][j];
+    }
+  }
+}
+
+double Manager::getAnalysisTime()
+{
+  return analysisTime;
+}
+
+SConn::SConn(FILE* saveFile)
+{
+  out = new DummyOutStream(saveFile);
   setStreams(NULL, out);
 
   setWriter(new rfb::SMsgWriter(&client, out));
@@ -310,6 +396,16 @@ void SConn::getStats(double& ratio, unsigned long long& bytes,
   manager->getStats(ratio, bytes, rawEquivalent);
 }
 
+void SConn::getEncoderResults(EncoderResults* results)
+{
+  manager->getEncoderResults(results);
+}
+
+double SConn::getAnalysisTime()
+{
+  return manager->getAnalysisTime();
+}
+
 void SConn::setAccessRights(AccessRights ar)
 {
 }
@@ -323,14 +419,17 @@ struct stats
 {
   double decodeTime;
   double encodeTime;
+  double analysisTime;
   double realTime;
 
   double ratio;
   unsigned long long bytes;
   unsigned long long rawEquivalent;
+
+  EncoderResults encoders;
 };
 
-static struct stats runTest(const char *fn)
+static struct stats runTest(const char *fn, FILE* saveFile=NULL)
 {
   CConn *cc;
   struct stats s;
@@ -339,7 +438,7 @@ static struct stats runTest(const char *fn)
   gettimeofday(&start, NULL);
 
   try {
-    cc = new CConn(fn);
+    cc = new CConn(fn, saveFile);
   } catch (rdr::Exception& e) {
     fprintf(stderr, "Failed to open rfb file: %s\n", e.str());
     exit(1);
@@ -361,6 +460,8 @@ static struct stats runTest(const char *fn)
   s.realTime = (double)stop.tv_sec - start.tv_sec;
   s.realTime += ((double)stop.tv_usec - start.tv_usec)/1000000.0;
   cc->getStats(s.ratio, s.bytes, s.rawEquivalent);
+  cc->getEncoderResults(&s.encoders);
+  s.analysisTime = cc->getAnalysisTime();
 
   delete cc;
 
@@ -385,6 +486,103 @@ static void sort(double *array, int count)
   } while (!sorted);
 }
 
+static double percentile(const std::vector<double>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0.0;
+  return sorted[(size_t)((sorted.size() - 1) * p + 0.5)];
+}
+
+static void writeJSONString(FILE *f, const char *str)
+{
+  fputc('"', f);
+  for (; *str != '\0'; str++) {
+    if ((*str == '"') || (*str == '\\'))
+      fputc('\\', f);
+    fputc(*str, f);
+  }
+  fputc('"', f);
+}
+
+static void writeJSON(const char *fn, const struct stats *runs,
+                      int runCount, double decodeTime, double decodeDev,
+                      double encodeTime, double encodeDev,
+                      double analysisTime, double analysisDev)
+{
+  FILE *f;
+  EncoderResults::const_iterator iter;
+
+  f = fopen(json, "w");
+  if (f == NULL) {
+    fprintf(stderr, "Failed to open %s\n", (const char*)json);
+    exit(1);
+  }
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"tool\": \"encperf\",\n");
+  fprintf(f, "  \"file\": ");
+  writeJSONString(f, fn);
+  fprintf(f, ",\n");
+  fprintf(f, "  \"width\": %d,\n", (int)width);
+  fprintf(f, "  \"height\": %d,\n", (int)height);
+  fprintf(f, "  \"runs\": %d,\n", runCount);
+  fprintf(f, "  \"decode_cpu_s\": %g,\n", decodeTime);
+  fprintf(f, "  \"decode_cpu_dev_pct\": %g,\n", decodeDev);
+  fprintf(f, "  \"encode_cpu_s\": %g,\n", encodeTime);
+  fprintf(f, "  \"encode_cpu_dev_pct\": %g,\n", encodeDev);
+  fprintf(f, "  \"analysis_s\": %g,\n", analysisTime);
+  fprintf(f, "  \"analysis_dev_pct\": %g,\n", analysisDev);
+  fprintf(f, "  \"bytes\": %.0f,\n", (double)runs[0].bytes);
+  fprintf(f, "  \"raw_equivalent\": %.0f,\n", (double)runs[0].rawEquivalent);
+  fprintf(f, "  \"ratio\": %g,\n", runs[0].ratio);
+  fprintf(f, "  \"encoders\": [");
+
+  // Sizes are the same for every run, but the times from all of them
+  // are used for the rates and percentiles
+  for (iter = runs[0].encoders.begin();
+       iter != runs[0].encoders.end(); ++iter) {
+    const EncoderResult& result = iter->second;
+    std::vector<double> times;
+    double total;
+
+    for (int i = 0; i < runCount; i++) {
+      EncoderResults::const_iterator other;
+
+      other = runs[i].encoders.find(iter->first);
+      if (other == runs[i].encoders.end())
+        continue;
+
+      times.insert(times.end(), other->second.times.begin(),
+                   other->second.times.end());
+    }
+
+    std::sort(times.begin(), times.end());
+
+    total = 0.0;
+    for (size_t i = 0; i < times.size(); i++)
+      total += times[i];
+
+    fprintf(f, "%s\n", iter == runs[0].encoders.begin() ? "" : ",");
+    fprintf(f, "    {\n");
+    fprintf(f, "      \"name\": \"%s\",\n", iter->first.c_str());
+    fprintf(f, "      \"rects\": %.0f,\n", (double)result.rects);
+    fprintf(f, "      \"pixels\": %.0f,\n", (double)result.pixels);
+    fprintf(f, "      \"bytes\": %.0f,\n", (double)result.bytes);
+    fprintf(f, "      \"ratio\": %g,\n",
+            result.bytes ? (double)result.equivalent / result.bytes : 0.0);
+    fprintf(f, "      \"mpixels_per_s\": %g,\n",
+            total > 0.0 ? (double)result.pixels * runCount / total / 1000000.0 : 0.0);
+    fprintf(f, "      \"p50_us\": %g,\n", percentile(times, 0.50) * 1000000.0);
+    fprintf(f, "      \"p99_us\": %g\n", percentile(times, 0.99) * 1000000.0);
+    fprintf(f, "    }");
+  }
+
+  fprintf(f, "\n  ]\n");
+  fprintf(f, "}\n");
+
+  fclose(f);
+}
+
 static void usage(const char *argv0)
 {
   fprintf(stderr, "Syntax: %s [options] <rfb file>\n", argv0);
@@ -425,6 +623,9 @@ int main(int argc, char **argv)
   double *values = new double[runCount];
   double *dev = new double[runCount];
   double median, meddev;
+  double decodeMedian, decodeDev, encodeMedian, encodeDev;
+  double analysisMedian, analysisDev;
+  FILE *saveFile;
 
   if (fn == NULL) {
     fprintf(stderr, "No file specified!\n\n");
@@ -441,8 +642,20 @@ int main(int argc, char **argv)
     usage(argv[0]);
   }
 
+  saveFile = NULL;
+  if (strcmp(save, "") != 0) {
+    saveFile = fopen(save, "wb");
+    if (saveFile == NULL) {
+      fprintf(stderr, "Failed to open %s\n", (const char*)save);
+      exit(1);
+    }
+  }
+
   // Warmup
-  runTest(fn);
+  runTest(fn, saveFile);
+
+  if (saveFile != NULL)
+    fclose(saveFile);
 
   // Multiple runs to get a good average
   for (i = 0; i < runCount; i++)
@@ -463,6 +676,9 @@ int main(int argc, char **argv)
 
   printf("CPU time (decoding): %g s (+/- %g %%)\n", median, meddev);
 
+  decodeMedian = median;
+  decodeDev = meddev;
+
   // And for CPU usage encoding
   for (i = 0;i < runCount;i++)
     values[i] = runs[i].encodeTime;
@@ -478,6 +694,27 @@ int main(int argc, char **argv)
 
   printf("CPU time (encoding): %g s (+/- %g %%)\n", median, meddev);
 
+  encodeMedian = median;
+  encodeDev = meddev;
+
+  // And for the part of that spent analysing rects
+  for (i = 0;i < runCount;i++)
+    values[i] = runs[i].analysisTime;
+
+  sort(values, runCount);
+  median = values[runCount/2];
+
+  for (i = 0;i < runCount;i++)
+    dev[i] = fabs((values[i] - median) / median) * 100;
+
+  sort(dev, runCount);
+  meddev = dev[runCount/2];
+
+  printf("CPU time (analysis): %g s (+/- %g %%)\n", median, meddev);
+
+  analysisMedian = median;
+  analysisDev = meddev;
+
   // And for CPU core usage encoding
   for (i = 0;i < runCount;i++)
     values[i] = (runs[i].decodeTime + runs[i].encodeTime) / runs[i].realTime;
@@ -502,5 +739,9 @@ int main(int argc, char **argv)
 #endif
   printf("Ratio: %g\n", runs[0].ratio);
 
+  if (strcmp(json, "") != 0)
+    writeJSON(fn, runs, runCount, decodeMedian, decodeDev,
+              encodeMedian, encodeDev, analysisMedian, analysisDev);
+
   return 0;
 }
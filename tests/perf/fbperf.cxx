@@ -61,6 +61,11 @@ protected:
   virtual void changefb();
 };
 
+class ScatteredTestWindow: public TestWindow {
+protected:
+  virtual void changefb();
+};
+
 class OverlayTestWindow: public PartialTestWindow {
 public:
   OverlayTestWindow();
@@ -150,14 +155,16 @@ void TestWindow::flush()
 
 void TestWindow::update()
 {
-  rfb::Rect r;
+  std::vector<rfb::Rect> rects;
+  std::vector<rfb::Rect>::const_iterator i;
 
   startTimeCounter();
 
   changefb();
 
-  r = fb->getDamage();
-  damage(FL_DAMAGE_USER1, r.tl.x, r.tl.y, r.width(), r.height());
+  fb->getDamage().get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i)
+    damage(FL_DAMAGE_USER1, i->tl.x, i->tl.y, i->width(), i->height());
 
 #if !defined(WIN32) && !defined(__APPLE__)
   // Make sure we measure any work we queue up
@@ -202,6 +209,19 @@ void PartialTestWindow::changefb()
   fb->fillRect(r, &pixel);
 }
 
+void ScatteredTestWindow::changefb()
+{
+  rdr::U32 pixel;
+
+  // Small changes in each corner, e.g. a clock and a blinking
+  // cursor, with nothing in between
+  pixel = rand();
+  fb->fillRect(rfb::Rect(0, 0, 64, 64), &pixel);
+  fb->fillRect(rfb::Rect(w() - 64, 0, w(), 64), &pixel);
+  fb->fillRect(rfb::Rect(0, h() - 64, 64, h()), &pixel);
+  fb->fillRect(rfb::Rect(w() - 64, h() - 64, w(), h()), &pixel);
+}
+
 OverlayTestWindow::OverlayTestWindow() :
   overlay(NULL), offscreen(NULL)
 {
@@ -389,6 +409,12 @@ int main(int argc, char** argv)
   delete win;
   fprintf(stderr, "\n");
 
+  fprintf(stderr, "Scattered window update:\n\n");
+  win = new ScatteredTestWindow();
+  dotest(win);
+  delete win;
+  fprintf(stderr, "\n");
+
   fprintf(stderr, "Partial window update with overlay:\n\n");
   win = new OverlayTestWindow();
   dotest(win);
@@ -0,0 +1,469 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program generates the standard corpora used by the benchmark
+ * targets. Each corpus is a synthetic, but deterministic, session of
+ * a typical kind of workload, written in the format encperf reads,
+ * i.e. a server side dump of FramebufferUpdate messages after the
+ * ServerInit. Only the changed parts of the screen are sent in each
+ * update, using the Raw encoding. The size is 1280x720 and the pixel
+ * format is bgr888.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include <rdr/types.h>
+#include <rfb/Rect.h>
+
+static const int fbwidth = 1280;
+static const int fbheight = 720;
+
+static const int charWidth = 8;
+static const int charHeight = 16;
+
+typedef void (*corpusfn)(FILE* f, int frames);
+
+struct CorpusEntry {
+  const char *name;
+  corpusfn fn;
+  int frames;
+};
+
+static std::vector<rdr::U32> fb;
+static rdr::U32 seed;
+
+static rdr::U32 random32()
+{
+  // Simple LCG so that the output is the same on every platform
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static rdr::U32 rgb(int r, int g, int b)
+{
+  return r | (g << 8) | (b << 16);
+}
+
+static void fillRect(const rfb::Rect& r, rdr::U32 colour)
+{
+  for (int y = r.tl.y; y < r.br.y; y++) {
+    for (int x = r.tl.x; x < r.br.x; x++)
+      fb[y * fbwidth + x] = colour;
+  }
+}
+
+static void drawChar(int x, int y, unsigned c, rdr::U32 fg, rdr::U32 bg)
+{
+  rdr::U32 bits;
+
+  fillRect(rfb::Rect(x, y, x + charWidth, y + charHeight), bg);
+
+  if (c == ' ')
+    return;
+
+  // A pseudo glyph, which is enough to give the encoders the same
+  // kind of work as real text
+  bits = c * 2654435761U;
+  for (int gy = 3; gy < 12; gy++) {
+    for (int gx = 1; gx < 6; gx++) {
+      if (bits & (1 << ((gy * 5 + gx) % 32)))
+        fb[(y + gy) * fbwidth + x + gx] = fg;
+    }
+  }
+}
+
+static void drawText(int x, int y, const char *text,
+                     rdr::U32 fg, rdr::U32 bg)
+{
+  for (; *text != '\0'; text++) {
+    drawChar(x, y, (unsigned char)*text, fg, bg);
+    x += charWidth;
+  }
+}
+
+static void randomText(char *buffer, int len)
+{
+  for (int i = 0; i < len; i++) {
+    if (random32() % 6 == 0)
+      buffer[i] = ' ';
+    else
+      buffer[i] = 'a' + random32() % 26;
+  }
+  buffer[len] = '\0';
+}
+
+static void drawLine(int x0, int y0, int x1, int y1, rdr::U32 colour,
+                     const rfb::Rect& clip)
+{
+  int dx, dy, steps;
+
+  dx = x1 - x0;
+  dy = y1 - y0;
+  steps = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+  if (steps == 0)
+    steps = 1;
+
+  for (int i = 0; i <= steps; i++) {
+    int x, y;
+
+    x = x0 + dx * i / steps;
+    y = y0 + dy * i / steps;
+
+    if (clip.contains(rfb::Point(x, y)))
+      fb[y * fbwidth + x] = colour;
+  }
+}
+
+static void drawDesktop()
+{
+  rdr::U32 background;
+
+  // Desktop background with a subtle gradient
+  for (int y = 0; y < fbheight; y++) {
+    background = rgb(40, 60 + y * 40 / fbheight, 100 + y * 60 / fbheight);
+    for (int x = 0; x < fbwidth; x++)
+      fb[y * fbwidth + x] = background;
+  }
+
+  // Panel
+  fillRect(rfb::Rect(0, fbheight - 32, fbwidth, fbheight),
+           rgb(220, 220, 220));
+  drawText(8, fbheight - 24, "Activities", rgb(0, 0, 0),
+           rgb(220, 220, 220));
+  drawText(fbwidth - 48, fbheight - 24, "12:00", rgb(0, 0, 0),
+           rgb(220, 220, 220));
+}
+
+static void drawWindow(const rfb::Rect& r, const char *title)
+{
+  fillRect(r, rgb(255, 255, 255));
+  fillRect(rfb::Rect(r.tl.x, r.tl.y, r.br.x, r.tl.y + 24),
+           rgb(60, 60, 80));
+  drawText(r.tl.x + 8, r.tl.y + 4, title, rgb(255, 255, 255),
+           rgb(60, 60, 80));
+}
+
+static void writeUpdate(FILE* f, const std::vector<rfb::Rect>& rects)
+{
+  rdr::U8 header[12];
+  std::vector<rdr::U8> row;
+
+  header[0] = 0; // FramebufferUpdate
+  header[1] = 0;
+  header[2] = rects.size() >> 8;
+  header[3] = rects.size();
+  fwrite(header, 4, 1, f);
+
+  for (size_t i = 0; i < rects.size(); i++) {
+    const rfb::Rect& r = rects[i];
+
+    header[0] = r.tl.x >> 8;
+    header[1] = r.tl.x;
+    header[2] = r.tl.y >> 8;
+    header[3] = r.tl.y;
+    header[4] = r.width() >> 8;
+    header[5] = r.width();
+    header[6] = r.height() >> 8;
+    header[7] = r.height();
+    memset(header + 8, 0, 4); // Raw
+    fwrite(header, 12, 1, f);
+
+    row.resize(r.width() * 4);
+    for (int y = r.tl.y; y < r.br.y; y++) {
+      for (int x = r.tl.x; x < r.br.x; x++) {
+        rdr::U32 p = fb[y * fbwidth + x];
+        row[(x - r.tl.x) * 4 + 0] = p;
+        row[(x - r.tl.x) * 4 + 1] = p >> 8;
+        row[(x - r.tl.x) * 4 + 2] = p >> 16;
+        row[(x - r.tl.x) * 4 + 3] = 0;
+      }
+      fwrite(&row[0], row.size(), 1, f);
+    }
+  }
+}
+
+static void writeUpdate(FILE* f, const rfb::Rect& r)
+{
+  writeUpdate(f, std::vector<rfb::Rect>(1, r));
+}
+
+static void genOffice(FILE* f, int frames)
+{
+  rfb::Rect window(160, 40, 1120, 660);
+  char line[112];
+  int row, col;
+
+  // A word processor with a document being typed in to, and the
+  // occasional menu being opened
+  drawDesktop();
+  drawWindow(window, "Document - Writer");
+  fillRect(rfb::Rect(window.tl.x, window.tl.y + 24,
+                     window.br.x, window.tl.y + 56), rgb(235, 235, 235));
+  for (int i = 0; i < 16; i++)
+    fillRect(rfb::Rect(window.tl.x + 8 + i * 28, window.tl.y + 28,
+                       window.tl.x + 32 + i * 28, window.tl.y + 52),
+             rgb(random32() % 256, random32() % 256, random32() % 256));
+
+  for (row = 0; row < 20; row++) {
+    randomText(line, 100);
+    drawText(window.tl.x + 40, window.tl.y + 72 + row * 20, line,
+             rgb(0, 0, 0), rgb(255, 255, 255));
+  }
+
+  writeUpdate(f, rfb::Rect(0, 0, fbwidth, fbheight));
+
+  col = 0;
+  for (int frame = 1; frame < frames; frame++) {
+    std::vector<rfb::Rect> rects;
+    rfb::Rect r;
+
+    if (frame % 25 == 0) {
+      // Pop up a menu
+      r = rfb::Rect(window.tl.x + 8, window.tl.y + 56,
+                    window.tl.x + 208, window.tl.y + 296);
+      fillRect(r, rgb(245, 245, 245));
+      for (int i = 0; i < 12; i++) {
+        randomText(line, 20);
+        drawText(r.tl.x + 8, r.tl.y + 4 + i * 20, line,
+                 rgb(0, 0, 0), rgb(245, 245, 245));
+      }
+      writeUpdate(f, r);
+      continue;
+    }
+
+    // Type a few characters and move the text cursor
+    for (int i = 0; i < 4; i++) {
+      randomText(line, 1);
+      r = rfb::Rect(window.tl.x + 40 + col * charWidth,
+                    window.tl.y + 72 + row * 20,
+                    window.tl.x + 40 + (col + 1) * charWidth,
+                    window.tl.y + 72 + row * 20 + charHeight);
+      drawChar(r.tl.x, r.tl.y, (unsigned char)line[0],
+               rgb(0, 0, 0), rgb(255, 255, 255));
+      rects.push_back(r);
+
+      col++;
+      if (col == 100) {
+        col = 0;
+        row = (row + 1) % 26;
+      }
+    }
+
+    r = rfb::Rect(window.tl.x + 40 + col * charWidth,
+                  window.tl.y + 72 + row * 20,
+                  window.tl.x + 41 + col * charWidth,
+                  window.tl.y + 72 + row * 20 + charHeight);
+    fillRect(r, rgb(0, 0, 0));
+    rects.push_back(r);
+
+    writeUpdate(f, rects);
+  }
+}
+
+static void genVideo(FILE* f, int frames)
+{
+  rfb::Rect window(320, 120, 960, 504);
+  rfb::Rect video(window.tl.x, window.tl.y + 24, window.br.x, window.br.y);
+
+  // A video player with smooth, noisy, moving content
+  drawDesktop();
+  drawWindow(window, "Video Player");
+  writeUpdate(f, rfb::Rect(0, 0, fbwidth, fbheight));
+
+  for (int frame = 0; frame < frames; frame++) {
+    for (int y = video.tl.y; y < video.br.y; y++) {
+      for (int x = video.tl.x; x < video.br.x; x++) {
+        int r, g, b, noise;
+
+        r = 128 + 100 * sin((x + frame * 5) / 40.0);
+        g = 128 + 100 * cos((y - frame * 3) / 30.0);
+        b = 128 + 100 * sin((x + y + frame * 4) / 50.0);
+        noise = random32() % 16;
+
+        fb[y * fbwidth + x] = rgb(r + noise, g + noise, b + noise);
+      }
+    }
+    writeUpdate(f, video);
+  }
+}
+
+static void genTerminal(FILE* f, int frames)
+{
+  rfb::Rect window(240, 60, 240 + 80 * charWidth + 16,
+                   60 + 24 + 25 * charHeight + 8);
+  rfb::Rect text(window.tl.x + 8, window.tl.y + 28,
+                 window.br.x - 8, window.br.y - 4);
+  rdr::U32 fg, bg;
+  char line[81];
+
+  // A terminal with output scrolling by
+  fg = rgb(200, 200, 200);
+  bg = rgb(0, 0, 0);
+
+  drawDesktop();
+  drawWindow(window, "Terminal");
+  fillRect(rfb::Rect(window.tl.x, window.tl.y + 24,
+                     window.br.x, window.br.y), bg);
+  for (int row = 0; row < 25; row++) {
+    randomText(line, 80);
+    drawText(text.tl.x, text.tl.y + row * charHeight, line, fg, bg);
+  }
+  writeUpdate(f, rfb::Rect(0, 0, fbwidth, fbheight));
+
+  for (int frame = 0; frame < frames; frame++) {
+    // Scroll up a few lines at a time
+    for (int i = 0; i < 3; i++) {
+      int len;
+
+      for (int y = text.tl.y; y < text.tl.y + 24 * charHeight; y++)
+        memmove(&fb[y * fbwidth + text.tl.x],
+                &fb[(y + charHeight) * fbwidth + text.tl.x],
+                80 * charWidth * 4);
+
+      len = random32() % 81;
+      randomText(line, len);
+      memset(line + len, ' ', 80 - len);
+      line[80] = '\0';
+      drawText(text.tl.x, text.tl.y + 24 * charHeight, line,
+               (frame % 4) ? fg : rgb(80, 220, 80), bg);
+    }
+    writeUpdate(f, text);
+  }
+}
+
+static void genCAD(FILE* f, int frames)
+{
+  rfb::Rect window(80, 20, 1200, 680);
+  rfb::Rect view(window.tl.x + 200, window.tl.y + 24,
+                 window.br.x, window.br.y);
+  std::vector<double> points;
+  char line[40];
+
+  // A CAD application with a wireframe model being rotated
+  drawDesktop();
+  drawWindow(window, "Model - CAD");
+  fillRect(rfb::Rect(window.tl.x, window.tl.y + 24,
+                     view.tl.x, window.br.y), rgb(230, 230, 230));
+  for (int i = 0; i < 30; i++) {
+    randomText(line, 20);
+    drawText(window.tl.x + 8, window.tl.y + 32 + i * 20, line,
+             rgb(0, 0, 0), rgb(230, 230, 230));
+  }
+
+  for (int i = 0; i < 400 * 3; i++)
+    points.push_back((double)(random32() % 2000) / 1000.0 - 1.0);
+
+  for (int frame = 0; frame < frames; frame++) {
+    double angle;
+    int cx, cy, scale;
+
+    fillRect(view, rgb(30, 30, 40));
+
+    // Grid
+    for (int x = view.tl.x; x < view.br.x; x += 40)
+      drawLine(x, view.tl.y, x, view.br.y - 1, rgb(50, 50, 60), view);
+    for (int y = view.tl.y; y < view.br.y; y += 40)
+      drawLine(view.tl.x, y, view.br.x - 1, y, rgb(50, 50, 60), view);
+
+    angle = frame * 0.05;
+    cx = (view.tl.x + view.br.x) / 2;
+    cy = (view.tl.y + view.br.y) / 2;
+    scale = view.height() / 3;
+
+    // Connect each point with the next one
+    for (size_t i = 0; i + 5 < points.size(); i += 3) {
+      double x0, y0, x1, y1;
+
+      x0 = points[i] * cos(angle) - points[i + 2] * sin(angle);
+      y0 = points[i + 1];
+      x1 = points[i + 3] * cos(angle) - points[i + 5] * sin(angle);
+      y1 = points[i + 4];
+
+      drawLine(cx + x0 * scale, cy + y0 * scale,
+               cx + x1 * scale, cy + y1 * scale,
+               (i / 3) % 5 ? rgb(200, 200, 80) : rgb(80, 200, 250), view);
+    }
+
+    writeUpdate(f, frame == 0 ? rfb::Rect(0, 0, fbwidth, fbheight) : view);
+  }
+}
+
+static struct CorpusEntry corpora[] = {
+  {"office", genOffice, 200},
+  {"video", genVideo, 20},
+  {"terminal", genTerminal, 30},
+  {"cad", genCAD, 15},
+};
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "Syntax: %s <corpus> <output file> [frames]\n", argv0);
+  fprintf(stderr, "Corpora:\n");
+  for (size_t i = 0; i < sizeof(corpora)/sizeof(corpora[0]); i++)
+    fprintf(stderr, "  %s\n", corpora[i].name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const CorpusEntry *corpus;
+  int frames;
+  FILE *f;
+
+  if ((argc < 3) || (argc > 4))
+    usage(argv[0]);
+
+  corpus = NULL;
+  for (size_t i = 0; i < sizeof(corpora)/sizeof(corpora[0]); i++) {
+    if (strcmp(argv[1], corpora[i].name) == 0)
+      corpus = &corpora[i];
+  }
+  if (corpus == NULL)
+    usage(argv[0]);
+
+  frames = corpus->frames;
+  if (argc == 4) {
+    frames = atoi(argv[3]);
+    if (frames <= 0)
+      usage(argv[0]);
+  }
+
+  f = fopen(argv[2], "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Failed to open %s\n", argv[2]);
+    return 1;
+  }
+
+  fb.resize(fbwidth * fbheight);
+  seed = 1;
+
+  corpus->fn(f, frames);
+
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Failed to write %s\n", argv[2]);
+    return 1;
+  }
+
+  return 0;
+}
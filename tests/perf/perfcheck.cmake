@@ -0,0 +1,154 @@
+#
+# Compares the JSON results from encperf and decperf in RESULTS_DIR
+# with the ones in BASELINE_DIR, failing if any of them have regressed
+# by more than TOLERANCE percent. Compression ratios are deterministic
+# so they are only allowed to change by a tiny amount. The p99
+# latencies are too noisy to fail on and only give a warning.
+#
+# If SAVE_BASELINE is set then the results are instead copied to
+# BASELINE_DIR.
+#
+
+cmake_policy(SET CMP0012 NEW)
+
+if(NOT RESULTS_DIR OR NOT BASELINE_DIR)
+  message(FATAL_ERROR "RESULTS_DIR and BASELINE_DIR must be set")
+endif()
+
+file(GLOB RESULTS RELATIVE ${RESULTS_DIR} ${RESULTS_DIR}/*.json)
+if(NOT RESULTS)
+  message(FATAL_ERROR "No benchmark results found in ${RESULTS_DIR}")
+endif()
+
+if(SAVE_BASELINE)
+  foreach(result ${RESULTS})
+    file(COPY ${RESULTS_DIR}/${result} DESTINATION ${BASELINE_DIR})
+  endforeach()
+  message(STATUS "Benchmark baseline saved in ${BASELINE_DIR}")
+  return()
+endif()
+
+if(CMAKE_VERSION VERSION_LESS 3.19)
+  message(FATAL_ERROR "Comparing benchmark results requires CMake 3.19 or newer")
+endif()
+
+if(NOT TOLERANCE)
+  set(TOLERANCE 10)
+endif()
+
+# Encoders with fewer rects than this have too few samples for the
+# timings to mean anything
+set(MIN_RECTS 20)
+
+set(FAILURES 0)
+
+# Converts a non-negative number to an integer in units of 0.001
+function(_to_milli value out)
+  if(NOT value MATCHES "^([0-9]*)\\.?([0-9]*)$")
+    # Exponents are only used for tiny or huge numbers, which are
+    # too noisy to compare anyway
+    set(${out} 0 PARENT_SCOPE)
+    return()
+  endif()
+  string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 frac)
+  # Leading zeros might be taken as octal
+  string(REGEX REPLACE "^0+" "" milli "${CMAKE_MATCH_1}${frac}")
+  if(milli STREQUAL "")
+    set(milli 0)
+  endif()
+  set(${out} ${milli} PARENT_SCOPE)
+endfunction()
+
+# check(<label> <new> <old> <tolerance> <higher is better> <fatal>)
+macro(check label new old tolerance higher fatal)
+  # CMake can't do floating point, so compare in units of 0.001
+  _to_milli(${new} new_milli)
+  _to_milli(${old} old_milli)
+  if(old_milli GREATER 0)
+    math(EXPR change "(${new_milli} - ${old_milli}) * 1000 / ${old_milli}")
+    if(NOT ${higher})
+      math(EXPR change "0 - ${change}")
+    endif()
+    math(EXPR limit "0 - ${tolerance} * 10")
+    if(change LESS limit)
+      math(EXPR pct "0 - ${change} / 10")
+      if(${fatal})
+        message(STATUS "FAIL: ${label}: ${new} vs ${old} (${pct}% worse)")
+        math(EXPR FAILURES "${FAILURES} + 1")
+      else()
+        message(STATUS "WARNING: ${label}: ${new} vs ${old} (${pct}% worse)")
+      endif()
+    endif()
+  endif()
+endmacro()
+
+foreach(result ${RESULTS})
+  if(NOT EXISTS ${BASELINE_DIR}/${result})
+    message(STATUS "WARNING: No baseline for ${result}")
+    continue()
+  endif()
+
+  file(READ ${RESULTS_DIR}/${result} new_json)
+  file(READ ${BASELINE_DIR}/${result} old_json)
+
+  string(JSON tool GET "${new_json}" tool)
+
+  if(tool STREQUAL "encperf")
+    string(JSON new GET "${new_json}" ratio)
+    string(JSON old GET "${old_json}" ratio)
+    check("${result}: ratio" ${new} ${old} 1 TRUE TRUE)
+
+    string(JSON count LENGTH "${old_json}" encoders)
+    math(EXPR last "${count} - 1")
+    foreach(i RANGE ${last})
+      string(JSON name GET "${old_json}" encoders ${i} name)
+      string(JSON rects GET "${old_json}" encoders ${i} rects)
+
+      # Find the same encoder in the new results
+      set(found -1)
+      string(JSON new_count LENGTH "${new_json}" encoders)
+      math(EXPR new_last "${new_count} - 1")
+      foreach(j RANGE ${new_last})
+        string(JSON new_name GET "${new_json}" encoders ${j} name)
+        if(new_name STREQUAL name)
+          set(found ${j})
+        endif()
+      endforeach()
+
+      if(found EQUAL -1)
+        message(STATUS "WARNING: ${result}: ${name} is no longer used")
+        continue()
+      endif()
+
+      string(JSON new GET "${new_json}" encoders ${found} ratio)
+      string(JSON old GET "${old_json}" encoders ${i} ratio)
+      check("${result}: ${name} ratio" ${new} ${old} 1 TRUE TRUE)
+
+      if(rects LESS MIN_RECTS)
+        continue()
+      endif()
+
+      string(JSON new GET "${new_json}" encoders ${found} mpixels_per_s)
+      string(JSON old GET "${old_json}" encoders ${i} mpixels_per_s)
+      check("${result}: ${name} Mpixels/s" ${new} ${old} ${TOLERANCE} TRUE TRUE)
+
+      string(JSON new GET "${new_json}" encoders ${found} p50_us)
+      string(JSON old GET "${old_json}" encoders ${i} p50_us)
+      check("${result}: ${name} p50" ${new} ${old} ${TOLERANCE} FALSE TRUE)
+
+      string(JSON new GET "${new_json}" encoders ${found} p99_us)
+      string(JSON old GET "${old_json}" encoders ${i} p99_us)
+      check("${result}: ${name} p99" ${new} ${old} ${TOLERANCE} FALSE FALSE)
+    endforeach()
+  elseif(tool STREQUAL "decperf")
+    string(JSON new GET "${new_json}" mpixels_per_s)
+    string(JSON old GET "${old_json}" mpixels_per_s)
+    check("${result}: Mpixels/s" ${new} ${old} ${TOLERANCE} TRUE TRUE)
+  endif()
+endforeach()
+
+if(FAILURES GREATER 0)
+  message(FATAL_ERROR "${FAILURES} benchmark result(s) regressed by more than ${TOLERANCE}%")
+endif()
+
+message(STATUS "No benchmark regressions found")
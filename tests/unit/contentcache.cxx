@@ -0,0 +1,185 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <rfb/ContentCache.h>
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+
+static const int tile = 64;
+static const int tileCount = rfb::contentCacheMaxPixels / (tile * tile);
+
+static void printResult(bool ok)
+{
+    if (ok)
+        printf("OK");
+    else
+        printf("FAILED");
+    printf("\n");
+    fflush(stdout);
+}
+
+static void testEviction()
+{
+    rfb::ServerContentCache server;
+    rfb::ContentCache client;
+    rdr::U32 id;
+    bool lossy;
+    bool ok;
+
+    printf("Eviction: ");
+
+    // Fill the cache and then some, touching the first entry so it
+    // should survive
+    ok = true;
+    for (int i = 0;i < tileCount + 10;i++) {
+        id = server.add(i, tile, tile, false);
+        client.insert(id, tile, tile);
+
+        if (i == tileCount / 2) {
+            if (!server.lookup(0, tile, tile, &id, &lossy))
+                ok = false;
+            server.touch(id);
+            client.touch(id);
+        }
+    }
+
+    if (!server.lookup(0, tile, tile, &id, &lossy) || !client.has(id))
+        ok = false;
+
+    for (int i = 1;i < tileCount + 10;i++) {
+        bool found;
+
+        found = server.lookup(i, tile, tile, &id, &lossy);
+
+        // The oldest entries should have been evicted
+        if (found != (i > 10))
+            ok = false;
+        if (found && !client.has(id))
+            ok = false;
+    }
+
+    if (server.pixels() != client.pixels())
+        ok = false;
+
+    printResult(ok);
+}
+
+static void testReplace()
+{
+    rfb::ServerContentCache server;
+    rdr::U32 first, second, id;
+    bool lossy;
+    bool ok;
+
+    printf("Replace: ");
+
+    ok = true;
+
+    first = server.add(1234, tile, tile, true);
+    second = server.add(1234, tile, tile, false);
+    if (first == second)
+        ok = false;
+
+    if (!server.lookup(1234, tile, tile, &id, &lossy))
+        ok = false;
+    else if ((id != second) || lossy)
+        ok = false;
+
+    // Different size is different content
+    if (server.lookup(1234, tile, tile/2, &id, &lossy))
+        ok = false;
+
+    // Evicting the old id must not forget the new one
+    for (int i = 0;i < tileCount - 1;i++)
+        server.add(i, tile, tile, false);
+
+    if (!server.lookup(1234, tile, tile, &id, &lossy) || (id != second))
+        ok = false;
+
+    printResult(ok);
+}
+
+static void testStoreDraw()
+{
+    rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+    rfb::ManagedPixelBuffer pb(pf, 256, 256);
+    rfb::ClientContentCache client;
+    rdr::U32* buffer;
+    int stride;
+    bool ok;
+
+    printf("Store and draw: ");
+
+    buffer = (rdr::U32*)pb.getBufferRW(pb.getRect(), &stride);
+    for (int y = 0;y < pb.height();y++) {
+        for (int x = 0;x < pb.width();x++)
+            buffer[y * stride + x] = x * 1000 + y;
+    }
+    pb.commitBufferRW(pb.getRect());
+
+    client.store(17, &pb, rfb::Rect(64, 0, 128, 64));
+    client.draw(17, &pb, rfb::Rect(128, 128, 192, 192));
+
+    ok = true;
+
+    buffer = (rdr::U32*)pb.getBufferRW(pb.getRect(), &stride);
+    for (int y = 0;y < 64;y++) {
+        for (int x = 0;x < 64;x++) {
+            rdr::U32 expected;
+
+            expected = (x + 64) * 1000 + y;
+            if (buffer[(y + 128) * stride + x + 128] != expected)
+                ok = false;
+        }
+    }
+    pb.commitBufferRW(pb.getRect());
+
+    try {
+        client.draw(17, &pb, rfb::Rect(0, 0, 32, 32));
+        ok = false;
+    } catch (rfb::Exception& e) {
+    }
+
+    try {
+        client.draw(18, &pb, rfb::Rect(0, 0, 64, 64));
+        ok = false;
+    } catch (rfb::Exception& e) {
+    }
+
+    client.clear();
+
+    try {
+        client.draw(17, &pb, rfb::Rect(0, 0, 64, 64));
+        ok = false;
+    } catch (rfb::Exception& e) {
+    }
+
+    printResult(ok);
+}
+
+int main(int argc, char** argv)
+{
+    testEviction();
+    testReplace();
+    testStoreDraw();
+
+    return 0;
+}
@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 static const rdr::U8 pixelRed = 0xf1;
 static const rdr::U8 pixelGreen = 0xc3;
@@ -256,11 +257,106 @@ static bool testPixelRGB(const rfb::PixelFormat &dstpf,
   return true;
 }
 
+static bool testSIMD(const rfb::PixelFormat &dstpf,
+                     const rfb::PixelFormat &srcpf)
+{
+  static const rfb::SIMDLevel levels[] = { rfb::simdSSSE3, rfb::simdAVX2,
+                                           rfb::simdNEON };
+
+  rfb::SIMDLevel best;
+  int i;
+  size_t l;
+  rdr::U8 bufIn[fbMalloc], bufExpected[fbMalloc], bufOut[fbMalloc];
+  bool ok;
+
+  // Every possible value for each component, and random padding
+  for (i = 0;i < fbMalloc;i++)
+    bufIn[i] = rand();
+
+  best = rfb::getSIMDLevel();
+
+  // An odd width so that the generic code has to do some of each row
+  rfb::setSIMDLevel(rfb::simdNone);
+  memset(bufExpected, 0, sizeof(bufExpected));
+  dstpf.bufferFromBuffer(bufExpected, srcpf, bufIn,
+                         fbWidth - 3, fbHeight, fbWidth, fbWidth);
+
+  ok = true;
+  for (l = 0;l < sizeof(levels)/sizeof(levels[0]);l++) {
+    if (!rfb::setSIMDLevel(levels[l]))
+      continue;
+
+    memset(bufOut, 0, sizeof(bufOut));
+    dstpf.bufferFromBuffer(bufOut, srcpf, bufIn,
+                           fbWidth - 3, fbHeight, fbWidth, fbWidth);
+
+    if (memcmp(bufOut, bufExpected, sizeof(bufOut)) != 0)
+      ok = false;
+  }
+
+  rfb::setSIMDLevel(best);
+
+  return ok;
+}
+
+static bool testRunLength(const rfb::PixelFormat &dstpf,
+                          const rfb::PixelFormat &srcpf)
+{
+  static const rfb::SIMDLevel levels[] = { rfb::simdSSSE3, rfb::simdAVX2,
+                                           rfb::simdNEON };
+
+  rfb::SIMDLevel best;
+  rdr::U32 colour;
+  int bytes, p, b, i, run;
+  size_t l;
+  rdr::U8 buffer[fbWidth * 4];
+  bool ok;
+
+  bytes = srcpf.bpp / 8;
+  colour = 0x78563412 & (0xffffffff >> (32 - srcpf.bpp));
+
+  best = rfb::getSIMDLevel();
+
+  ok = true;
+  for (l = 0;l < sizeof(levels)/sizeof(levels[0]);l++) {
+    if (!rfb::setSIMDLevel(levels[l]))
+      continue;
+
+    // A difference in any byte of any pixel should end the run, but
+    // the scan may stop early when there isn't a full vector left
+    for (p = 0;p <= fbWidth;p++) {
+      for (b = 0;b < bytes;b++) {
+        for (i = 0;i < fbWidth;i++) {
+          if (bytes == 4)
+            ((rdr::U32*)buffer)[i] = colour;
+          else if (bytes == 2)
+            ((rdr::U16*)buffer)[i] = colour;
+          else
+            buffer[i] = colour;
+        }
+
+        if (p < fbWidth)
+          buffer[p * bytes + b] ^= 0x01;
+
+        run = rfb::simdRunLength(buffer, srcpf.bpp, fbWidth, colour);
+        if ((run > p) || ((run < p) && ((fbWidth - run) * bytes >= 32)))
+          ok = false;
+      }
+    }
+  }
+
+  rfb::setSIMDLevel(best);
+
+  return ok;
+}
+
 struct TestEntry tests[] = {
   {"Pixel from pixel", testPixel},
   {"Buffer from buffer", testBuffer},
   {"Buffer to/from RGB", testRGB},
   {"Pixel to/from RGB", testPixelRGB},
+  {"Vectorised buffer from buffer", testSIMD},
+  {"Vectorised run length", testRunLength},
 };
 
 static void doTests(const rfb::PixelFormat &dstpf,
@@ -0,0 +1,393 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <rdr/Exception.h>
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rfb/SharedFramebuffer.h>
+
+static const size_t dataSize = 4 * 1024 * 1024;
+
+static rdr::U8 pattern(size_t pos)
+{
+    return (pos * 7 + pos / 251) & 0xff;
+}
+
+static void writePattern(rdr::FdOutStream* os, size_t length)
+{
+    // Odd sized writes so we straddle buffer boundaries
+    for (size_t i = 0; i < length; i += 1000) {
+        rdr::U8 data[1000];
+        size_t n;
+
+        n = length - i;
+        if (n > sizeof(data))
+            n = sizeof(data);
+
+        for (size_t j = 0; j < n; j++)
+            data[j] = pattern(i + j);
+
+        os->writeBytes(data, n);
+    }
+}
+
+static void testQueue()
+{
+    int fds[2];
+    rdr::FdOutStream* os;
+    size_t received;
+    bool ok;
+
+    printf("%s: ", __func__);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        printf("FAILED: socketpair() failed\n");
+        return;
+    }
+
+    os = new rdr::FdOutStream(fds[0], false, 100);
+    os->setQueueLimit(dataSize * 2);
+
+    // Nobody is reading, so this would time out if we blocked
+    try {
+        writePattern(os, dataSize);
+        os->flush();
+    } catch (rdr::Exception& e) {
+        printf("FAILED: %s\n", e.str());
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    if (os->bufferUsage() == 0) {
+        printf("FAILED: nothing queued\n");
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    if (os->length() != dataSize) {
+        printf("FAILED: length %d, expected %d\n",
+               (int)os->length(), (int)dataSize);
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    received = 0;
+    ok = true;
+    while (received < dataSize) {
+        rdr::U8 data[65536];
+        ssize_t n;
+
+        os->flush();
+
+        n = recv(fds[1], data, sizeof(data), MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN)
+                continue;
+            break;
+        }
+
+        for (ssize_t i = 0; i < n; i++) {
+            if (data[i] != pattern(received + i))
+                ok = false;
+        }
+
+        received += n;
+    }
+
+    if (received != dataSize)
+        printf("FAILED: got %d bytes, expected %d\n",
+               (int)received, (int)dataSize);
+    else if (!ok)
+        printf("FAILED: data corrupted\n");
+    else if (os->bufferUsage() != 0)
+        printf("FAILED: data left in queue\n");
+    else
+        printf("OK\n");
+
+    delete os;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void testLimit()
+{
+    int fds[2];
+    rdr::FdOutStream* os;
+
+    printf("%s: ", __func__);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        printf("FAILED: socketpair() failed\n");
+        return;
+    }
+
+    os = new rdr::FdOutStream(fds[0], false, 100);
+    os->setQueueLimit(65536);
+
+    // Once the queue is full we should have to wait
+    try {
+        writePattern(os, dataSize);
+        printf("FAILED: no timeout\n");
+    } catch (rdr::TimedOut& e) {
+        if (os->bufferUsage() > 65536 + 16384)
+            printf("FAILED: %d bytes queued\n", os->bufferUsage());
+        else
+            printf("OK\n");
+    }
+
+    close(fds[1]);
+    close(fds[0]);
+
+    try {
+        delete os;
+    } catch (rdr::Exception& e) {
+    }
+}
+
+static void testSendFd()
+{
+    static const rfb::PixelFormat pf(32, 24, false, true,
+                                     255, 255, 255, 16, 8, 0);
+
+    int fds[2];
+    rdr::FdOutStream* os;
+    rdr::FdInStream* is;
+    rfb::SharedFramebuffer server, client;
+
+    printf("%s: ", __func__);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        printf("FAILED: socketpair() failed\n");
+        return;
+    }
+
+    os = new rdr::FdOutStream(fds[0]);
+    is = new rdr::FdInStream(fds[1]);
+    is->setReceiveFds(true);
+
+    try {
+        rfb::Rect r(10, 20, 11, 21);
+        rdr::U32 pixel;
+        const rdr::U8* data;
+        int stride, fd;
+
+        server.create(pf, 64, 32);
+
+        // The descriptor should arrive no later than the data written
+        // after it
+        os->writeU32(1);
+        os->sendFd(server.getFd());
+        os->writeU32(2);
+        os->flush();
+
+        // The memory is shared, so later changes are seen as well
+        pixel = 0x123456;
+        server.imageRect(r, &pixel);
+
+        if ((is->readU32() != 1) || (is->readU32() != 2)) {
+            printf("FAILED: data corrupted\n");
+        } else if ((fd = is->receiveFd()) == -1) {
+            printf("FAILED: no file descriptor received\n");
+        } else if (is->receiveFd() != -1) {
+            printf("FAILED: too many file descriptors received\n");
+        } else {
+            client.attach(fd, pf, 64, 32, server.getStride());
+
+            data = client.getBuffer(r, &stride);
+            if (*(const rdr::U32*)data != pixel)
+                printf("FAILED: pixel not shared\n");
+            else
+                printf("OK\n");
+        }
+    } catch (rdr::Exception& e) {
+        printf("FAILED: %s\n", e.str());
+    }
+
+    delete is;
+    delete os;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void testUnsealed()
+{
+    static const rfb::PixelFormat pf(32, 24, false, true,
+                                     255, 255, 255, 16, 8, 0);
+
+    FILE* f;
+    int fd;
+    rfb::SharedFramebuffer client;
+
+    printf("%s: ", __func__);
+
+    // An ordinary file could be truncated whilst we are using it
+    f = tmpfile();
+    if (f == NULL) {
+        printf("FAILED: tmpfile() failed\n");
+        return;
+    }
+
+    fd = dup(fileno(f));
+    fclose(f);
+
+    if (ftruncate(fd, 64 * 32 * 4) < 0) {
+        printf("FAILED: ftruncate() failed\n");
+        close(fd);
+        return;
+    }
+
+    try {
+        client.attach(fd, pf, 64, 32, 64);
+        printf("FAILED: unsealed file accepted\n");
+    } catch (rdr::Exception& e) {
+        printf("OK\n");
+    }
+}
+
+static void testIgnoreFds()
+{
+    int fds[2], pipefds[2];
+    rdr::FdOutStream* os;
+    rdr::FdInStream* is;
+
+    printf("%s: ", __func__);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        printf("FAILED: socketpair() failed\n");
+        return;
+    }
+
+    if (pipe(pipefds) < 0) {
+        printf("FAILED: pipe() failed\n");
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    os = new rdr::FdOutStream(fds[0]);
+    is = new rdr::FdInStream(fds[1]);
+
+    try {
+        os->sendFd(pipefds[0]);
+        os->writeU32(1);
+        os->flush();
+        close(pipefds[0]);
+
+        // The copy we were sent should be the only reader left, so
+        // once it is closed there should be nothing to write to
+        if (is->readU32() != 1)
+            printf("FAILED: data corrupted\n");
+        else if (is->receiveFd() != -1)
+            printf("FAILED: file descriptor kept\n");
+        else if ((write(pipefds[1], "x", 1) != -1) || (errno != EPIPE))
+            printf("FAILED: file descriptor not closed\n");
+        else
+            printf("OK\n");
+    } catch (rdr::Exception& e) {
+        printf("FAILED: %s\n", e.str());
+    }
+
+    delete is;
+    delete os;
+    close(pipefds[1]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void testTooManyFds()
+{
+    int fds[2], sent[8];
+    rdr::FdInStream* is;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+    char data, control[CMSG_SPACE(sizeof(sent))];
+
+    printf("%s: ", __func__);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        printf("FAILED: socketpair() failed\n");
+        return;
+    }
+
+    for (int i = 0; i < 8; i++)
+        sent[i] = fds[0];
+
+    data = 1;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(sent));
+    memcpy(CMSG_DATA(cmsg), sent, sizeof(sent));
+
+    if (sendmsg(fds[0], &msg, 0) != 1) {
+        printf("FAILED: sendmsg() failed\n");
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    is = new rdr::FdInStream(fds[1]);
+    is->setReceiveFds(true);
+
+    // More than we can handle shouldn't be silently dropped
+    try {
+        is->readU8();
+        printf("FAILED: no error\n");
+    } catch (rdr::Exception& e) {
+        printf("OK\n");
+    }
+
+    delete is;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main(int argc, char** argv)
+{
+    // For testIgnoreFds()
+    signal(SIGPIPE, SIG_IGN);
+
+    testQueue();
+    testLimit();
+    testSendFd();
+    testUnsealed();
+    testIgnoreFds();
+    testTooManyFds();
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rfb/LogWriter.h>
+#include <rfb/Logger_file.h>
+
+static char dir[] = "/tmp/fileloggerXXXXXX";
+
+// Counts the messages in a log file, and checks that they are in the
+// order they were logged in
+static int countMessages(const char* filename, int* last)
+{
+    FILE* f;
+    char line[256];
+    int count;
+
+    f = fopen(filename, "r");
+    if (f == NULL)
+        return -1;
+
+    count = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        int n;
+
+        if (sscanf(line, " Test: message %d", &n) != 1)
+            continue;
+
+        if (n <= *last) {
+            fclose(f);
+            return -1;
+        }
+
+        *last = n;
+        count++;
+    }
+
+    fclose(f);
+
+    return count;
+}
+
+static void testAll()
+{
+    char filename[64];
+    int last, count;
+
+    printf("%s: ", __func__);
+
+    snprintf(filename, sizeof(filename), "%s/all.log", dir);
+
+    {
+        rfb::Logger_File logger("test");
+
+        logger.setFilename(filename);
+        logger.maxSize = 0;
+
+        for (int i = 0;i < 100000;i++) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "message %d", i);
+            logger.write(rfb::LogWriter::LEVEL_INFO, "Test", msg);
+        }
+
+        logger.flush();
+
+        last = -1;
+        count = countMessages(filename, &last);
+        if (count < 0) {
+            printf("FAILED: messages missing or out of order\n");
+            return;
+        }
+
+        if (count + logger.getDropped() != 100000) {
+            printf("FAILED: %d written and %u dropped\n",
+                   count, logger.getDropped());
+            return;
+        }
+    }
+
+    remove(filename);
+
+    printf("OK\n");
+}
+
+static void testError()
+{
+    char filename[64];
+    int last;
+
+    printf("%s: ", __func__);
+
+    snprintf(filename, sizeof(filename), "%s/error.log", dir);
+
+    {
+        rfb::Logger_File logger("test");
+
+        logger.setFilename(filename);
+
+        // Errors should be on disk without any explicit flush
+        logger.write(rfb::LogWriter::LEVEL_ERROR, "Test", "message 1");
+
+        last = -1;
+        if (countMessages(filename, &last) != 1) {
+            printf("FAILED: error not written\n");
+            return;
+        }
+    }
+
+    remove(filename);
+
+    printf("OK\n");
+}
+
+static void testRotation()
+{
+    char filename[64], old[80];
+    int last, count, total;
+
+    printf("%s: ", __func__);
+
+    snprintf(filename, sizeof(filename), "%s/rotate.log", dir);
+
+    {
+        rfb::Logger_File logger("test");
+
+        logger.setFilename(filename);
+        logger.maxSize = 4096;
+        logger.maxFiles = 3;
+
+        for (int i = 0;i < 2000;i++) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "message %d", i);
+            logger.write(rfb::LogWriter::LEVEL_INFO, "Test", msg);
+            if (i % 10 == 0)
+                logger.flush();
+        }
+
+        logger.flush();
+    }
+
+    // Oldest first, so the numbers keep increasing
+    last = -1;
+    total = 0;
+    for (int i = 3;i >= 0;i--) {
+        if (i == 0)
+            snprintf(old, sizeof(old), "%s", filename);
+        else
+            snprintf(old, sizeof(old), "%s.%d", filename, i);
+
+        count = countMessages(old, &last);
+        if (count < 0) {
+            printf("FAILED: %s missing or out of order\n", old);
+            return;
+        }
+
+        total += count;
+        remove(old);
+    }
+
+    snprintf(old, sizeof(old), "%s.4", filename);
+    if (access(old, F_OK) == 0) {
+        printf("FAILED: too many old files kept\n");
+        remove(old);
+        return;
+    }
+
+    if ((total >= 2000) || (last != 1999)) {
+        printf("FAILED: unexpected messages kept\n");
+        return;
+    }
+
+    printf("OK\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    testAll();
+    testError();
+    testRotation();
+
+    rmdir(dir);
+
+    return 0;
+}
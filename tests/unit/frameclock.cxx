@@ -0,0 +1,146 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+
+#include <rfb/SDesktop.h>
+#include <rfb/ServerCore.h>
+#include <rfb/VNCServerST.h>
+
+class TestDesktop : public rfb::SStaticDesktop {
+public:
+    TestDesktop() : rfb::SStaticDesktop(rfb::Point(64, 64)) {}
+
+    virtual void terminate() {}
+};
+
+class TestServer : public rfb::VNCServerST {
+public:
+    TestServer(rfb::SDesktop* desktop)
+      : rfb::VNCServerST("test", desktop), now(1000000) {}
+
+    void start() { startDesktop(); }
+
+    void damage()
+    {
+        add_changed(rfb::Region(rfb::Rect(0, 0, 16, 16)));
+    }
+
+    bool isRunning() { return frameTimer.isStarted(); }
+    int getDelay() { return frameTimer.getTimeoutMs(); }
+    void stop() { frameTimer.stop(); }
+
+    void setLastFrame(rdr::U64 when) { lastFrame = when; }
+
+    rdr::U64 now;
+
+protected:
+    virtual rdr::U64 getTimeMs() { return now; }
+};
+
+static bool checkDelay(TestServer* server, int minDelay, int maxDelay)
+{
+    int delay;
+
+    if (!server->isRunning()) {
+        printf("FAILED: frame clock not started\n");
+        return false;
+    }
+
+    delay = server->getDelay();
+    if ((delay < minDelay) || (delay > maxDelay)) {
+        printf("FAILED: delay %d ms, expected %d-%d ms\n",
+               delay, minDelay, maxDelay);
+        return false;
+    }
+
+    return true;
+}
+
+static void testFirstFrame()
+{
+    TestDesktop desktop;
+    TestServer server(&desktop);
+    int interval;
+
+    printf("%s: ", __func__);
+
+    interval = 1000/rfb::Server::frameRate;
+
+    server.start();
+
+    // No frame has been sent yet, so nothing to wait for apart from
+    // the application settling, whatever the clock says
+    server.now = 1000000;
+    server.damage();
+    if (!checkDelay(&server, 1, interval))
+        return;
+    server.stop();
+
+    server.now = 0x80000000ULL + 1000000;
+    server.damage();
+    if (!checkDelay(&server, 1, interval))
+        return;
+    server.stop();
+
+    printf("OK\n");
+}
+
+static void testRecentFrame()
+{
+    TestDesktop desktop;
+    TestServer server(&desktop);
+    int interval;
+
+    printf("%s: ", __func__);
+
+    interval = 1000/rfb::Server::frameRate;
+
+    server.start();
+
+    // Frame just sent, so wait out most of the interval
+    server.setLastFrame(server.now - 1);
+    server.damage();
+    if (!checkDelay(&server, interval - 1, interval))
+        return;
+    server.stop();
+
+    // Frame sent long ago
+    server.setLastFrame(server.now - 100000);
+    server.damage();
+    if (!checkDelay(&server, 1, interval))
+        return;
+    server.stop();
+
+    // Frame "sent" in the future should never hold things up
+    server.setLastFrame(server.now + 100000);
+    server.damage();
+    if (!checkDelay(&server, 1, interval))
+        return;
+    server.stop();
+
+    printf("OK\n");
+}
+
+int main(int argc, char** argv)
+{
+    testFirstFrame();
+    testRecentFrame();
+
+    return 0;
+}
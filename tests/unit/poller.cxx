@@ -0,0 +1,125 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <network/Poller.h>
+#include <rdr/Exception.h>
+
+static bool checkEvents(network::Poller* poller, int timeoutms,
+                        int expectFd, bool expectRead, bool expectWrite)
+{
+    int n, fd;
+    bool read, write;
+
+    n = poller->wait(timeoutms);
+
+    if (expectFd == -1) {
+        if (n != 0) {
+            printf("FAILED: got %d events, expected none\n", n);
+            return false;
+        }
+        return true;
+    }
+
+    if (n != 1) {
+        printf("FAILED: got %d events, expected 1\n", n);
+        return false;
+    }
+
+    poller->getEvent(0, &fd, &read, &write);
+    if ((fd != expectFd) || (read != expectRead) || (write != expectWrite)) {
+        printf("FAILED: got fd %d (%s%s), expected fd %d (%s%s)\n",
+               fd, read ? "r" : "", write ? "w" : "",
+               expectFd, expectRead ? "r" : "", expectWrite ? "w" : "");
+        return false;
+    }
+
+    return true;
+}
+
+static void testEvents()
+{
+    int fds[2];
+    network::Poller poller;
+
+    printf("%s: ", __func__);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        printf("FAILED: socketpair() failed\n");
+        return;
+    }
+
+    try {
+        poller.setFd(fds[0], true, false);
+        poller.setFd(fds[1], true, false);
+
+        // Nothing to read yet
+        if (!checkEvents(&poller, 0, -1, false, false))
+            goto out;
+
+        if (write(fds[1], "x", 1) != 1) {
+            printf("FAILED: write() failed\n");
+            goto out;
+        }
+
+        if (!checkEvents(&poller, 1000, fds[0], true, false))
+            goto out;
+
+        // Registering again with the same events shouldn't change
+        // anything
+        poller.setFd(fds[0], true, false);
+        if (!checkEvents(&poller, 1000, fds[0], true, false))
+            goto out;
+
+        // Once removed we shouldn't hear about it
+        poller.removeFd(fds[0]);
+        if (!checkEvents(&poller, 0, -1, false, false))
+            goto out;
+
+        // But changing what we wait for should work
+        poller.setFd(fds[0], false, true);
+        if (!checkEvents(&poller, 1000, fds[0], false, true))
+            goto out;
+
+        // Hang ups are reported as readable
+        poller.removeFd(fds[0]);
+        close(fds[0]);
+        fds[0] = -1;
+        if (!checkEvents(&poller, 1000, fds[1], true, false))
+            goto out;
+
+        printf("OK\n");
+    } catch (rdr::Exception& e) {
+        printf("FAILED: %s\n", e.str());
+    }
+
+out:
+    if (fds[0] != -1)
+        close(fds[0]);
+    close(fds[1]);
+}
+
+int main(int argc, char** argv)
+{
+    testEvents();
+
+    return 0;
+}
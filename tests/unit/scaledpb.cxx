@@ -0,0 +1,183 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <rfb/ScaledPixelBuffer.h>
+
+static const rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 0, 8, 16);
+
+static void printResult(bool ok)
+{
+    if (ok)
+        printf("OK");
+    else
+        printf("FAILED");
+    printf("\n");
+    fflush(stdout);
+}
+
+static void fill(rfb::ManagedPixelBuffer* pb, const rfb::Rect& r,
+                 rdr::U32 colour)
+{
+    rdr::U32* buffer;
+    int stride;
+
+    buffer = (rdr::U32*)pb->getBufferRW(r, &stride);
+    for (int y = 0;y < r.height();y++) {
+        for (int x = 0;x < r.width();x++)
+            buffer[y * stride + x] = colour;
+    }
+    pb->commitBufferRW(r);
+}
+
+static bool isSolid(const rfb::PixelBuffer* pb, const rfb::Rect& r,
+                    rdr::U32 colour)
+{
+    const rdr::U32* buffer;
+    int stride;
+
+    buffer = (const rdr::U32*)pb->getBuffer(r, &stride);
+    for (int y = 0;y < r.height();y++) {
+        for (int x = 0;x < r.width();x++) {
+            if (buffer[y * stride + x] != colour)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static void testSolid(unsigned int filter)
+{
+    rfb::ManagedPixelBuffer src(pf, 203, 101);
+    rfb::ScaledPixelBuffer scaled;
+    bool ok;
+
+    printf("Solid (filter %u): ", filter);
+
+    fill(&src, src.getRect(), 0x123456);
+
+    scaled.setSource(&src, 3, filter);
+    scaled.update(scaled.getRect());
+
+    ok = true;
+    if ((scaled.width() != 68) || (scaled.height() != 34))
+        ok = false;
+    if (!isSolid(&scaled, scaled.getRect(), 0x123456))
+        ok = false;
+
+    printResult(ok);
+}
+
+static void testUpdate(unsigned int filter)
+{
+    rfb::ManagedPixelBuffer src(pf, 256, 256);
+    rfb::ScaledPixelBuffer scaled;
+    rfb::Region changed;
+    rfb::Rect inside;
+    bool ok;
+
+    printf("Update (filter %u): ", filter);
+
+    fill(&src, src.getRect(), 0x000000);
+
+    scaled.setSource(&src, 4, filter);
+    scaled.update(scaled.getRect());
+
+    // Only the scaled area for the change should be needed to get
+    // the same result as scaling everything
+    fill(&src, rfb::Rect(100, 60, 140, 90), 0xffffff);
+
+    changed = scaled.scaleRegion(rfb::Rect(100, 60, 140, 90));
+    scaled.update(changed);
+
+    ok = true;
+
+    inside = rfb::Rect(28, 18, 32, 20);
+    if (!isSolid(&scaled, inside, 0xffffff))
+        ok = false;
+
+    if (!isSolid(&scaled, rfb::Rect(0, 0, 64, 10), 0x000000))
+        ok = false;
+
+    {
+        rfb::ManagedPixelBuffer full(pf, scaled.width(), scaled.height());
+        rfb::ScaledPixelBuffer reference;
+        const rdr::U8 *a, *b;
+        int strideA, strideB;
+
+        reference.setSource(&src, 4, filter);
+        reference.update(reference.getRect());
+
+        a = scaled.getBuffer(scaled.getRect(), &strideA);
+        b = reference.getBuffer(reference.getRect(), &strideB);
+        for (int y = 0;y < scaled.height();y++) {
+            if (memcmp(a + y * strideA * 4, b + y * strideB * 4,
+                       scaled.width() * 4) != 0)
+                ok = false;
+        }
+    }
+
+    printResult(ok);
+}
+
+static void testCoordinates()
+{
+    rfb::ManagedPixelBuffer src(pf, 1000, 500);
+    rfb::ScaledPixelBuffer scaled;
+    rfb::Region region;
+    bool ok;
+
+    printf("Coordinates: ");
+
+    scaled.setSource(&src, 3);
+
+    ok = true;
+
+    if (!scaled.unscalePoint(rfb::Point(10, 20)).equals(rfb::Point(31, 61)))
+        ok = false;
+    if (!scaled.unscalePoint(rfb::Point(333, 166)).equals(rfb::Point(999, 499)))
+        ok = false;
+
+    region = scaled.unscaleRegion(rfb::Rect(300, 100, 334, 167));
+    if (!region.get_bounding_rect().equals(rfb::Rect(900, 300, 1000, 500)))
+        ok = false;
+
+    // Must cover the change, and no more than the filter can reach
+    region = scaled.scaleRegion(rfb::Rect(31, 31, 32, 32));
+    if (!region.get_bounding_rect().enclosed_by(rfb::Rect(5, 5, 16, 16)))
+        ok = false;
+    if (!rfb::Rect(10, 10, 11, 11).enclosed_by(region.get_bounding_rect()))
+        ok = false;
+
+    printResult(ok);
+}
+
+int main(int argc, char** argv)
+{
+    for (unsigned int filter = 0;filter <= rfb::scaleFilterMaxNumber;filter++) {
+        testSolid(filter);
+        testUpdate(filter);
+    }
+
+    testCoordinates();
+
+    return 0;
+}
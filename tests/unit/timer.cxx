@@ -0,0 +1,202 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <rfb/Timer.h>
+
+class Recorder : public rfb::Timer::Callback {
+public:
+    Recorder() : repeats(0), repeat(NULL), restart(NULL) {}
+
+    virtual bool handleTimeout(rfb::Timer* t)
+    {
+        fired.push_back(t);
+
+        if (t == restart) {
+            restart = NULL;
+            t->start(5);
+            return false;
+        }
+
+        if ((t == repeat) && (repeats > 0)) {
+            repeats--;
+            return true;
+        }
+
+        return false;
+    }
+
+    std::vector<rfb::Timer*> fired;
+    int repeats;
+    rfb::Timer* repeat;
+    rfb::Timer* restart;
+
+    int count(rfb::Timer* t)
+    {
+        int n;
+
+        n = 0;
+        for (size_t i = 0;i < fired.size();i++) {
+            if (fired[i] == t)
+                n++;
+        }
+
+        return n;
+    }
+};
+
+static void runTimers()
+{
+    int timeout;
+
+    while (true) {
+        timeout = rfb::Timer::checkTimeouts();
+        if (timeout == 0)
+            break;
+        usleep(timeout * 1000);
+    }
+}
+
+static void testOrder()
+{
+    Recorder rec;
+    rfb::Timer a(&rec), b(&rec), c(&rec), d(&rec);
+
+    printf("%s: ", __func__);
+
+    a.start(30);
+    b.start(10);
+    c.start(20);
+    d.start(10);
+
+    // Stopping should take it out of the queue at once
+    c.stop();
+    if (c.isStarted()) {
+        printf("FAILED: timer still started after stop()\n");
+        return;
+    }
+
+    runTimers();
+
+    if ((rec.fired.size() != 3) || (rec.fired[0] != &b) ||
+        (rec.fired[1] != &d) || (rec.fired[2] != &a)) {
+        printf("FAILED: timers fired in the wrong order\n");
+        return;
+    }
+
+    printf("OK\n");
+}
+
+static void testRepeat()
+{
+    Recorder rec;
+    rfb::Timer a(&rec), b(&rec);
+
+    printf("%s: ", __func__);
+
+    rec.repeats = 2;
+    rec.repeat = &a;
+    rec.restart = &b;
+
+    a.start(10);
+    b.start(1);
+
+    runTimers();
+
+    // b restarts itself once, a repeats twice. How the later timeouts
+    // interleave depends on how promptly we got to run them, but b is
+    // due first so it must always go first.
+    if ((rec.fired.size() != 5) || (rec.count(&a) != 3) ||
+        (rec.count(&b) != 2) || (rec.fired[0] != &b)) {
+        printf("FAILED: unexpected timeouts\n");
+        return;
+    }
+
+    if (a.isStarted() || b.isStarted()) {
+        printf("FAILED: timers still running\n");
+        return;
+    }
+
+    printf("OK\n");
+}
+
+static void testMany()
+{
+    Recorder rec;
+    std::vector<rfb::Timer*> timers;
+    std::vector<int> timeouts;
+    rdr::U64 start;
+    int slack;
+
+    printf("%s: ", __func__);
+
+    srand(1);
+
+    start = rfb::Timer::getTimeMs();
+
+    for (int i = 0;i < 1000;i++) {
+        timers.push_back(new rfb::Timer(&rec));
+        timeouts.push_back(1 + rand() % 50);
+        timers[i]->start(timeouts[i]);
+    }
+
+    // Allow for the clock ticking over whilst starting them
+    slack = rfb::Timer::getTimeMs() - start + 1;
+
+    for (int i = 0;i < 1000;i += 3)
+        timers[i]->stop();
+
+    runTimers();
+
+    if (rec.fired.size() != 666) {
+        printf("FAILED: %d timeouts, expected 666\n", (int)rec.fired.size());
+        goto out;
+    }
+
+    for (size_t i = 1;i < rec.fired.size();i++) {
+        int prev, cur;
+
+        prev = rec.fired[i-1]->getTimeoutMs();
+        cur = rec.fired[i]->getTimeoutMs();
+        if (prev > cur + slack) {
+            printf("FAILED: %d ms timer fired after %d ms timer\n",
+                   prev, cur);
+            goto out;
+        }
+    }
+
+    printf("OK\n");
+
+out:
+    for (size_t i = 0;i < timers.size();i++)
+        delete timers[i];
+}
+
+int main(int argc, char** argv)
+{
+    testOrder();
+    testRepeat();
+    testMany();
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/* Copyright 2026 TigerVNC Team
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include <stdio.h>
+
+#include <rfb/VideoDetector.h>
+
+class TestDetector : public rfb::VideoDetector {
+public:
+    TestDetector() : now(1000000) {}
+
+    rdr::U64 now;
+
+protected:
+    virtual rdr::U64 getTimeMs() { return now; }
+};
+
+static void testDetection()
+{
+    TestDetector detector;
+    rfb::Rect video(100, 100, 300, 200), other(500, 300, 520, 310);
+    rfb::Region region;
+
+    printf("%s: ", __func__);
+
+    detector.setSize(800, 600);
+
+    // A video playing at 25 fps for a bit more than a second, and
+    // something else changing once
+    detector.add(rfb::Region(other));
+    for (int i = 0;i < 30;i++) {
+        detector.add(rfb::Region(video));
+        detector.now += 40;
+    }
+
+    region = detector.getVideoRegion();
+
+    if (!region.intersect(rfb::Region(video)).equals(rfb::Region(video))) {
+        printf("FAILED: video not detected\n");
+        return;
+    }
+
+    if (!region.intersect(rfb::Region(other)).is_empty()) {
+        printf("FAILED: single change detected as video\n");
+        return;
+    }
+
+    // Should stay video across short pauses
+    detector.now += 200;
+    if (detector.getVideoRegion().is_empty()) {
+        printf("FAILED: video lost too quickly\n");
+        return;
+    }
+
+    // But not once it has stopped for good
+    detector.now += 1000;
+    if (!detector.getVideoRegion().is_empty()) {
+        printf("FAILED: video still detected after it stopped\n");
+        return;
+    }
+
+    printf("OK\n");
+}
+
+int main(int argc, char** argv)
+{
+    testDetection();
+
+    return 0;
+}
@@ -331,6 +331,19 @@ void ShmImage::get(Window wnd, int x, int y, int w, int h,
   }
 }
 
+void ShmImage::getRows(Window wnd, int x, int y, int h, int dst_y)
+{
+  XImage rows;
+
+  // A shorter image that is further in to the same segment has the
+  // same layout, as only the height differs
+  rows = *xim;
+  rows.height = h;
+  rows.data = xim->data + dst_y * xim->bytes_per_line;
+
+  XShmGetImage(dpy, wnd, &rows, x, y, AllPlanes);
+}
+
 //
 // ImageFactory class implementation
 //
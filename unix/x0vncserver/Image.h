@@ -109,6 +109,11 @@ public:
   virtual void get(Window wnd, int x, int y, int w, int h,
                    int dst_x = 0, int dst_y = 0);
 
+  // Fetch h full rows of the image, starting at dst_y. This is a
+  // single XShmGetImage() straight in to the image, so it is much
+  // cheaper than get() for anything but tiny areas.
+  void getRows(Window wnd, int x, int y, int h, int dst_y);
+
 protected:
 
   void Init(int width, int height, const XVisualInfo *vinfo = NULL);
@@ -235,7 +235,7 @@ void XDesktop::start(VNCServer* vs) {
   ImageFactory factory((bool)useShm);
 
   // Create pixel buffer and provide it to the server object.
-  pb = new XPixelBuffer(dpy, factory, geometry->getRect());
+  pb = new XPixelBuffer(dpy, factory, geometry->getRect(), !haveDamage);
   vlog.info("Allocated %s", pb->getImage()->classDesc());
 
   server = vs;
@@ -717,7 +717,7 @@ bool XDesktop::handleGlobalEvent(XEvent* ev) {
       // Recreate pixel buffer
       ImageFactory factory((bool)useShm);
       delete pb;
-      pb = new XPixelBuffer(dpy, factory, geometry->getRect());
+      pb = new XPixelBuffer(dpy, factory, geometry->getRect(), !haveDamage);
       server->setPixelBuffer(pb, computeScreenLayout());
 
       // Mark entire screen as changed
@@ -28,8 +28,12 @@
 
 using namespace rfb;
 
+// Damaged rows this close together are fetched in one go, as another
+// round trip to the X server costs more than the extra rows
+static const int bandMergeRows = 64;
+
 XPixelBuffer::XPixelBuffer(Display *dpy, ImageFactory &factory,
-                           const Rect &rect)
+                           const Rect &rect, bool usePolling)
   : FullFramePixelBuffer(),
     m_poller(0),
     m_dpy(dpy),
@@ -37,6 +41,8 @@ XPixelBuffer::XPixelBuffer(Display *dpy, ImageFactory &factory,
     m_offsetLeft(rect.tl.x),
     m_offsetTop(rect.tl.y)
 {
+  m_shmImage = dynamic_cast<ShmImage*>(m_image);
+
   // Fill in the PixelFormat structure of the parent class.
   format = PixelFormat(m_image->xim->bits_per_pixel,
                        m_image->xim->depth,
@@ -57,8 +63,9 @@ XPixelBuffer::XPixelBuffer(Display *dpy, ImageFactory &factory,
   m_image->get(DefaultRootWindow(m_dpy), m_offsetLeft, m_offsetTop);
 
   // PollingManager will detect changed pixels.
-  m_poller = new PollingManager(dpy, getImage(), factory,
-                                m_offsetLeft, m_offsetTop);
+  if (usePolling)
+    m_poller = new PollingManager(dpy, getImage(), factory,
+                                  m_offsetLeft, m_offsetTop);
 }
 
 XPixelBuffer::~XPixelBuffer()
@@ -73,8 +80,43 @@ XPixelBuffer::grabRegion(const rfb::Region& region)
   std::vector<Rect> rects;
   std::vector<Rect>::const_iterator i;
   region.get_rects(&rects);
+
+  if (m_shmImage == NULL) {
+    for (i = rects.begin(); i != rects.end(); i++) {
+      grabRect(*i);
+    }
+    return;
+  }
+
+  // With shared memory it is far cheaper to fetch whole rows than to
+  // go through the X connection, so we merge the rects in to as few
+  // bands of rows as possible. The rects come sorted from the top.
+  int top, bottom;
+
+  top = bottom = -1;
   for (i = rects.begin(); i != rects.end(); i++) {
-    grabRect(*i);
+    if ((bottom != -1) && (i->tl.y <= bottom + bandMergeRows)) {
+      if (i->br.y > bottom)
+        bottom = i->br.y;
+      continue;
+    }
+
+    if (bottom != -1)
+      grabRows(top, bottom);
+
+    top = i->tl.y;
+    bottom = i->br.y;
   }
+
+  if (bottom != -1)
+    grabRows(top, bottom);
+}
+
+void
+XPixelBuffer::grabRows(int top, int bottom)
+{
+  m_shmImage->getRows(DefaultRootWindow(m_dpy),
+                      m_offsetLeft, m_offsetTop + top,
+                      bottom - top, top);
 }
 
@@ -35,14 +35,17 @@
 class XPixelBuffer : public rfb::FullFramePixelBuffer
 {
 public:
-  XPixelBuffer(Display *dpy, ImageFactory &factory, const rfb::Rect &rect);
+  // The screen is only scanned for changes if usePolling is set.
+  // Otherwise something else has to tell the server what changed.
+  XPixelBuffer(Display *dpy, ImageFactory &factory, const rfb::Rect &rect,
+               bool usePolling);
   virtual ~XPixelBuffer();
 
   // Provide access to the underlying Image object.
   const Image *getImage() const { return m_image; }
 
   // Detect changed pixels, notify the server.
-  inline void poll(rfb::VNCServer *server) { m_poller->poll(server); }
+  inline void poll(rfb::VNCServer *server) { if (m_poller) m_poller->poll(server); }
 
   // Override PixelBuffer::grabRegion().
   virtual void grabRegion(const rfb::Region& region);
@@ -52,6 +55,7 @@ protected:
 
   Display *m_dpy;
   Image* m_image;
+  ShmImage* m_shmImage;
   int m_offsetLeft;
   int m_offsetTop;
 
@@ -62,6 +66,9 @@ protected:
 		 m_offsetLeft + r.tl.x, m_offsetTop + r.tl.y,
 		 r.width(), r.height(), r.tl.x, r.tl.y);
   }
+
+  // Copy whole rows, only possible with shared memory
+  void grabRows(int top, int bottom);
 };
 
 #endif // __XPIXELBUFFER_H__
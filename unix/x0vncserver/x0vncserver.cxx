@@ -30,6 +30,7 @@
 #include <rfb/VNCServerST.h>
 #include <rfb/Configuration.h>
 #include <rfb/Timer.h>
+#include <network/Poller.h>
 #include <network/TcpSocket.h>
 #include <network/UnixSocket.h>
 
@@ -280,35 +281,37 @@ int main(int argc, char** argv)
 
     PollingScheduler sched((int)pollingCycle, (int)maxProcessorUsage);
 
+    // Everything except the client sockets stays the same, so only
+    // needs to be registered once
+    Poller poller;
+
+    poller.setFd(ConnectionNumber(dpy), true, false);
+    for (std::list<SocketListener*>::iterator i = listeners.begin();
+         i != listeners.end();
+         i++)
+      poller.setFd((*i)->getFd(), true, false);
+
+    if (server.getWakeupFd() != -1)
+      poller.setFd(server.getWakeupFd(), true, false);
+
     while (!caughtSignal) {
-      int wait_ms;
-      struct timeval tv;
-      fd_set rfds, wfds;
+      int wait_ms, n;
       std::list<Socket*> sockets;
       std::list<Socket*>::iterator i;
 
       // Process any incoming X events
       TXWindow::handleXEvents(dpy);
 
-      FD_ZERO(&rfds);
-      FD_ZERO(&wfds);
-
-      FD_SET(ConnectionNumber(dpy), &rfds);
-      for (std::list<SocketListener*>::iterator i = listeners.begin();
-           i != listeners.end();
-           i++)
-        FD_SET((*i)->getFd(), &rfds);
-
       server.getSockets(&sockets);
       int clients_connected = 0;
       for (i = sockets.begin(); i != sockets.end(); i++) {
         if ((*i)->isShutdown()) {
+          poller.removeFd((*i)->getFd());
           server.removeSocket(*i);
           delete (*i);
         } else {
-          FD_SET((*i)->getFd(), &rfds);
-          if ((*i)->outStream().bufferUsage() > 0)
-            FD_SET((*i)->getFd(), &wfds);
+          poller.setFd((*i)->getFd(), true,
+                       (*i)->outStream().bufferUsage() > 0);
           clients_connected++;
         }
       }
@@ -327,56 +330,77 @@ int main(int argc, char** argv)
 
       soonestTimeout(&wait_ms, Timer::checkTimeouts());
 
-      tv.tv_sec = wait_ms / 1000;
-      tv.tv_usec = (wait_ms % 1000) * 1000;
+      // Xlib might already have read damage events off the connection
+      // whilst we were doing something else. The X fd won't wake us up
+      // for those, so we must not sleep until they have been handled.
+      if (XQLength(dpy) > 0)
+        wait_ms = 0;
+      else if (wait_ms == 0)
+        wait_ms = -1;
 
       // Do the wait...
       sched.sleepStarted();
-      int n = select(FD_SETSIZE, &rfds, &wfds, 0,
-                     wait_ms ? &tv : NULL);
+      n = poller.wait(wait_ms);
       sched.sleepFinished();
 
-      if (n < 0) {
-        if (errno == EINTR) {
-          vlog.debug("Interrupted select() system call");
+      for (int e = 0; e < n; e++) {
+        int fd;
+        bool read, write;
+        bool found;
+
+        poller.getEvent(e, &fd, &read, &write);
+
+        // X events are handled at the top of the loop
+        if (fd == ConnectionNumber(dpy))
+          continue;
+
+        // Send any updates the client threads have finished
+        if (fd == server.getWakeupFd()) {
+          server.processWakeup();
           continue;
-        } else {
-          throw rdr::SystemException("select", errno);
         }
-      }
 
-      // Accept new VNC connections
-      for (std::list<SocketListener*>::iterator i = listeners.begin();
-           i != listeners.end();
-           i++) {
-        if (FD_ISSET((*i)->getFd(), &rfds)) {
-          Socket* sock = (*i)->accept();
+        // Accept new VNC connections
+        found = false;
+        for (std::list<SocketListener*>::iterator l = listeners.begin();
+             l != listeners.end();
+             l++) {
+          if ((*l)->getFd() != fd)
+            continue;
+
+          found = true;
+
+          Socket* sock = (*l)->accept();
           if (sock) {
             sock->outStream().setBlocking(false);
             server.addSocket(sock);
+            poller.setFd(sock->getFd(), true, false);
           } else {
             vlog.status("Client connection rejected");
           }
         }
+        if (found)
+          continue;
+
+        // Process events on existing VNC connections
+        for (i = sockets.begin(); i != sockets.end(); i++) {
+          if ((*i)->getFd() != fd)
+            continue;
+
+          if (read)
+            server.processSocketReadEvent(*i);
+          if (write)
+            server.processSocketWriteEvent(*i);
+        }
       }
 
       Timer::checkTimeouts();
 
-      // Client list could have been changed.
-      server.getSockets(&sockets);
-
       // Nothing more to do if there are no client connections.
+      server.getSockets(&sockets);
       if (sockets.empty())
         continue;
 
-      // Process events on existing VNC connections
-      for (i = sockets.begin(); i != sockets.end(); i++) {
-        if (FD_ISSET((*i)->getFd(), &rfds))
-          server.processSocketReadEvent(*i);
-        if (FD_ISSET((*i)->getFd(), &wfds))
-          server.processSocketWriteEvent(*i);
-      }
-
       if (desktop.isRunning() && sched.goodTimeToPoll()) {
         sched.newPass();
         desktop.poll();
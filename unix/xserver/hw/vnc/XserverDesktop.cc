@@ -67,6 +67,10 @@ IntParameter queryConnectTimeout("QueryConnectTimeout",
                                  "rejecting the connection",
                                  10);
 
+// Rects on the same rows that are closer than this many pixels are
+// grabbed as one, since every call has a fair bit of overhead
+static const int grabMergeGap = 64;
+
 
 XserverDesktop::XserverDesktop(int screenIndex_,
                                std::list<network::SocketListener*> listeners_,
@@ -88,10 +92,15 @@ XserverDesktop::XserverDesktop(int screenIndex_,
        i++) {
     vncSetNotifyFd((*i)->getFd(), screenIndex, true, false);
   }
+
+  if (server->getWakeupFd() != -1)
+    vncSetNotifyFd(server->getWakeupFd(), screenIndex, true, false);
 }
 
 XserverDesktop::~XserverDesktop()
 {
+  if (server->getWakeupFd() != -1)
+    vncRemoveNotifyFd(server->getWakeupFd());
   while (!listeners.empty()) {
     vncRemoveNotifyFd(listeners.back()->getFd());
     delete listeners.back();
@@ -283,6 +292,11 @@ void XserverDesktop::handleSocketEvent(int fd, bool read, bool write)
 {
   try {
     if (read) {
+      if (fd == server->getWakeupFd()) {
+        server->processWakeup();
+        return;
+      }
+
       if (handleListenerEvent(fd, &listeners, server))
         return;
     }
@@ -491,10 +505,53 @@ void XserverDesktop::grabRegion(const rfb::Region& region)
   if (shadowFramebuffer == NULL)
     return;
 
-  std::vector<rfb::Rect> rects;
-  std::vector<rfb::Rect>::iterator i;
+  std::vector<rfb::Rect> rects, grabs;
+  std::vector<rfb::Rect>::const_iterator i;
+
+  // The rects come sorted in bands of rows, so first combine the ones
+  // on the same rows
   region.get_rects(&rects);
-  for (i = rects.begin(); i != rects.end(); i++) {
+  for (i = rects.begin(); i != rects.end(); ++i) {
+    if (!grabs.empty()) {
+      rfb::Rect* last = &grabs.back();
+
+      if ((last->tl.y == i->tl.y) && (last->br.y == i->br.y) &&
+          (i->tl.x - last->br.x <= grabMergeGap)) {
+        last->br.x = i->br.x;
+        continue;
+      }
+    }
+
+    grabs.push_back(*i);
+  }
+
+  rects.clear();
+
+  // Full rows can be read in one go (see vncGetScreenImage()), so
+  // widen bands that cover most of the screen and then join those
+  // that are next to each other
+  for (i = grabs.begin(); i != grabs.end(); ++i) {
+    rfb::Rect r = *i;
+
+    if (r.width() > width() / 2) {
+      r.tl.x = 0;
+      r.br.x = width();
+    }
+
+    if (!rects.empty()) {
+      rfb::Rect* last = &rects.back();
+
+      if ((last->tl.x == r.tl.x) && (last->br.x == r.br.x) &&
+          (last->br.y == r.tl.y)) {
+        last->br.y = r.br.y;
+        continue;
+      }
+    }
+
+    rects.push_back(r);
+  }
+
+  for (i = rects.begin(); i != rects.end(); ++i) {
     rdr::U8 *buffer;
     int stride;
 
@@ -116,7 +116,7 @@ protected:
 private:
 
   int screenIndex;
-  rfb::VNCServer* server;
+  rfb::VNCServerST* server;
   std::list<network::SocketListener*> listeners;
   rdr::U8* shadowFramebuffer;
 
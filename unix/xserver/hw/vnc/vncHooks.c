@@ -29,6 +29,7 @@
 #include "xorg-version.h"
 
 #include "scrnintstr.h"
+#include "servermd.h"
 #include "windowstr.h"
 #include "cursorstr.h"
 #include "gcstruct.h"
@@ -355,24 +356,31 @@ void vncGetScreenImage(int scrIdx, int x, int y, int width, int height,
 {
   ScreenPtr pScreen = screenInfo.screens[scrIdx];
   vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+  DrawablePtr pDrawable;
 
   int i;
 
-  vncHooksScreen->ignoreHooks++;
-
-  // We do one line at a time since GetImage() cannot handle stride
-  for (i = y; i < y + height; i++) {
-    DrawablePtr pDrawable;
 #if XORG < 19
-    pDrawable = (DrawablePtr) WindowTable[scrIdx];
+  pDrawable = (DrawablePtr) WindowTable[scrIdx];
 #else
-    pDrawable = (DrawablePtr) pScreen->root;
+  pDrawable = (DrawablePtr) pScreen->root;
 #endif
 
-    (*pScreen->GetImage) (pDrawable, x, i, width, 1,
+  vncHooksScreen->ignoreHooks++;
+
+  // GetImage() cannot handle a stride, so we can only read everything
+  // at once if the rows are packed the way it would pack them, which
+  // is normally the case for full rows
+  if (strideBytes == PixmapBytePad(width, pScreen->rootDepth)) {
+    (*pScreen->GetImage) (pDrawable, x, y, width, height,
                           ZPixmap, (unsigned long)~0L, buffer);
+  } else {
+    for (i = y; i < y + height; i++) {
+      (*pScreen->GetImage) (pDrawable, x, i, width, 1,
+                            ZPixmap, (unsigned long)~0L, buffer);
 
-    buffer += strideBytes;
+      buffer += strideBytes;
+    }
   }
 
   vncHooksScreen->ignoreHooks--;
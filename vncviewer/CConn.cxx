@@ -32,6 +32,7 @@
 #include <rfb/Hostname.h>
 #include <rfb/LogWriter.h>
 #include <rfb/Security.h>
+#include <rfb/SharedFramebuffer.h>
 #include <rfb/util.h>
 #include <rfb/screenTypes.h>
 #include <rfb/fenceTypes.h>
@@ -83,6 +84,9 @@ CConn::CConn(const char* vncServerName, network::Socket* socket=NULL)
   supportsLocalCursor = true;
   supportsDesktopResize = true;
   supportsLEDState = false;
+  supportsContentCache = ::contentCache;
+
+  setServerScale(::serverScale);
 
   if (customCompressLevel)
     setCompressLevel(::compressLevel);
@@ -114,6 +118,11 @@ CConn::CConn(const char* vncServerName, network::Socket* socket=NULL)
     }
   }
 
+  // The server can only pass us its framebuffer over a local socket
+  supportsSharedFramebuffer = ::sharedFramebuffer && sock->canPassFds() &&
+                              rfb::SharedFramebuffer::canAttach();
+  sock->inStream().setReceiveFds(supportsSharedFramebuffer);
+
   Fl::add_fd(sock->getFd(), FL_READ | FL_EXCEPT, socketEvent, this);
 
   // See callback below
@@ -391,6 +400,18 @@ void CConn::dataRect(const Rect& r, int encoding)
   pixelCount += r.area();
 }
 
+void CConn::sharedFramebufferUpdate(const Rect& r)
+{
+  CConnection::sharedFramebufferUpdate(r);
+
+  pixelCount += r.area();
+}
+
+int CConn::receiveFd()
+{
+  return sock->inStream().receiveFd();
+}
+
 void CConn::setCursor(int width, int height, const Point& hotspot,
                       const rdr::U8* data)
 {
@@ -64,6 +64,7 @@ public:
   void framebufferUpdateStart();
   void framebufferUpdateEnd();
   void dataRect(const rfb::Rect& r, int encoding);
+  void sharedFramebufferUpdate(const rfb::Rect& r);
 
   void setCursor(int width, int height, const rfb::Point& hotspot,
                  const rdr::U8* data);
@@ -72,6 +73,8 @@ public:
 
   void setLEDState(unsigned int state);
 
+  int receiveFd();
+
   virtual void handleClipboardRequest();
   virtual void handleClipboardAnnounce(bool available);
   virtual void handleClipboardData(const char* data);
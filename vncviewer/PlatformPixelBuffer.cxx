@@ -18,6 +18,8 @@
 
 #include <assert.h>
 
+#include <vector>
+
 #if !defined(WIN32) && !defined(__APPLE__)
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -93,34 +95,77 @@ void PlatformPixelBuffer::commitBufferRW(const rfb::Rect& r)
   mutex.unlock();
 }
 
-rfb::Rect PlatformPixelBuffer::getDamage(void)
+#if !defined(WIN32) && !defined(__APPLE__)
+
+// Every separate upload has a fixed cost, which we estimate to be
+// about the same as uploading this many pixels
+static const int uploadOverhead = 64 * 64;
+
+// mergeDamage() returns the bounding rect of the damage if uploading
+// that is cheaper than uploading each rect on its own, e.g. when there
+// are many small rects close together
+static rfb::Region mergeDamage(const rfb::Region& damage)
+{
+  std::vector<rfb::Rect> rects;
+  std::vector<rfb::Rect>::const_iterator i;
+  rfb::Rect bounds;
+  long long area;
+
+  damage.get_rects(&rects);
+  if (rects.size() <= 1)
+    return damage;
+
+  area = 0;
+  for (i = rects.begin(); i != rects.end(); ++i)
+    area += i->area() + uploadOverhead;
+
+  bounds = damage.get_bounding_rect();
+  if (area < (long long)bounds.area() + uploadOverhead)
+    return damage;
+
+  return rfb::Region(bounds);
+}
+
+#endif
+
+rfb::Region PlatformPixelBuffer::getDamage(void)
 {
-  rfb::Rect r;
+  rfb::Region r;
 
   mutex.lock();
-  r = damage.get_bounding_rect();
+  r = damage;
   damage.clear();
   mutex.unlock();
 
 #if !defined(WIN32) && !defined(__APPLE__)
-  if (r.width() == 0 || r.height() == 0)
+  if (r.is_empty())
     return r;
 
+  std::vector<rfb::Rect> rects;
+  std::vector<rfb::Rect>::const_iterator i;
   GC gc;
 
+  r = mergeDamage(r);
+  r.get_rects(&rects);
+
   gc = XCreateGC(fl_display, pixmap, 0, NULL);
-  if (shminfo) {
-    XShmPutImage(fl_display, pixmap, gc, xim,
-                 r.tl.x, r.tl.y, r.tl.x, r.tl.y,
-                 r.width(), r.height(), False);
-    // Need to make sure the X server has finished reading the
-    // shared memory before we return
-    XSync(fl_display, False);
-  } else {
-    XPutImage(fl_display, pixmap, gc, xim,
-              r.tl.x, r.tl.y, r.tl.x, r.tl.y, r.width(), r.height());
+  for (i = rects.begin(); i != rects.end(); ++i) {
+    if (shminfo) {
+      XShmPutImage(fl_display, pixmap, gc, xim,
+                   i->tl.x, i->tl.y, i->tl.x, i->tl.y,
+                   i->width(), i->height(), False);
+    } else {
+      XPutImage(fl_display, pixmap, gc, xim,
+                i->tl.x, i->tl.y, i->tl.x, i->tl.y,
+                i->width(), i->height());
+    }
   }
   XFreeGC(fl_display, gc);
+
+  // Need to make sure the X server has finished reading the
+  // shared memory before we return
+  if (shminfo)
+    XSync(fl_display, False);
 #endif
 
   return r;
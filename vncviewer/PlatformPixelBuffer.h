@@ -42,7 +42,9 @@ public:
 
   virtual void commitBufferRW(const rfb::Rect& r);
 
-  rfb::Rect getDamage(void);
+  // getDamage() uploads everything that has changed since the last
+  // call and returns the area that was uploaded
+  rfb::Region getDamage(void);
 
   using rfb::FullFramePixelBuffer::width;
   using rfb::FullFramePixelBuffer::height;
@@ -227,10 +227,14 @@ const rfb::PixelFormat &Viewport::getPreferredPF()
 
 void Viewport::updateWindow()
 {
-  Rect r;
+  std::vector<Rect> rects;
+  std::vector<Rect>::const_iterator i;
 
-  r = frameBuffer->getDamage();
-  damage(FL_DAMAGE_USER1, r.tl.x + x(), r.tl.y + y(), r.width(), r.height());
+  frameBuffer->getDamage().get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); ++i) {
+    damage(FL_DAMAGE_USER1, i->tl.x + x(), i->tl.y + y(),
+           i->width(), i->height());
+  }
 }
 
 static const char * dotcursor_xpm[] = {
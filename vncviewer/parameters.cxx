@@ -97,6 +97,17 @@ BoolParameter noJpeg("NoJPEG",
 IntParameter qualityLevel("QualityLevel",
                           "JPEG quality level. 0 = Low, 9 = High",
                           8);
+BoolParameter contentCache("ContentCache",
+                           "Remember recently seen parts of the screen so "
+                           "the server can ask for them to be redrawn "
+                           "rather than sending them again", false);
+BoolParameter sharedFramebuffer("SharedFramebuffer",
+                                "Share the framebuffer memory with the "
+                                "server when connected over a local "
+                                "UNIX socket", true);
+IntParameter serverScale("ServerScale",
+                         "Ask the server to scale down the screen by this "
+                         "factor before sending it", 1, 1, 255);
 
 BoolParameter maximize("Maximize", "Maximize viewer window", false);
 BoolParameter fullScreen("FullScreen", "Full screen mode", false);
@@ -172,6 +183,9 @@ static VoidParameter* parameterArray[] = {
   &compressLevel,
   &noJpeg,
   &qualityLevel,
+  &contentCache,
+  &sharedFramebuffer,
+  &serverScale,
   &fullScreen,
   &fullScreenAllMonitors,
   &desktopSize,
@@ -38,6 +38,9 @@ extern rfb::BoolParameter customCompressLevel;
 extern rfb::IntParameter compressLevel;
 extern rfb::BoolParameter noJpeg;
 extern rfb::IntParameter qualityLevel;
+extern rfb::BoolParameter contentCache;
+extern rfb::BoolParameter sharedFramebuffer;
+extern rfb::IntParameter serverScale;
 
 extern rfb::BoolParameter maximize;
 extern rfb::BoolParameter fullScreen;